@@ -0,0 +1,499 @@
+#include "audio_bench.h"
+#include "../config.h"
+#include "../debug.h"
+#include "audio_engine.h"
+#include "interpolation.h"
+#include "limiter.h"
+#include "perf_stats.h"
+#include "../storage/sample_loader.h"
+#include <math.h>
+
+// Bench tone: 8 kHz sine, so pitching up to 3x crosses Nyquist
+#define BENCH_TONE_HZ        8000.0f
+#define BENCH_TONE_AMPLITUDE 16000.0f
+#define BENCH_TONE_FRAMES    32768
+#define BENCH_RENDER_FRAMES  4096
+#define BENCH_START_FRAME    16
+
+static const float benchSpeeds[] = { 0.5f, 1.0f, 1.5f, 2.0f, 3.0f };
+
+static bool createBenchTone(Sample& sample, float freq, uint8_t channels = 2) {
+    size_t allocFrames = BENCH_TONE_FRAMES + 2 * SAMPLE_PAD_FRAMES;
+    int16_t* allocation = (int16_t*)ps_calloc(allocFrames * channels, sizeof(int16_t));
+    if (!allocation) {
+        DEBUG("Failed to allocate bench tone");
+        return false;
+    }
+
+    sample.data = allocation + SAMPLE_PAD_FRAMES * channels;
+    sample.length = BENCH_TONE_FRAMES;
+    sample.midiNote = 60;
+    sample.isLoaded = true;
+    sample.sampleRate = SAMPLE_RATE;
+    sample.channels = channels;
+    sample.filename = "bench tone";
+    sample.mipData[0] = sample.data;
+    sample.mipLength[0] = BENCH_TONE_FRAMES;
+    sample.numMipLevels = 1;
+    sample.looped = false;
+    sample.streamed = false;
+    sample.headLength = BENCH_TONE_FRAMES;
+
+    for (uint32_t i = 0; i < BENCH_TONE_FRAMES; i++) {
+        int16_t value = (int16_t)(BENCH_TONE_AMPLITUDE * sinf(2.0f * PI * freq * i / SAMPLE_RATE));
+        for (int c = 0; c < channels; c++) {
+            sample.data[i * channels + c] = value;
+        }
+    }
+    return true;
+}
+
+static void freeBenchTone(Sample& sample) {
+    for (int level = 0; level < sample.numMipLevels; level++) {
+        free(sample.mipData[level] - SAMPLE_PAD_FRAMES * sample.channels);
+        sample.mipData[level] = nullptr;
+    }
+    sample.data = nullptr;
+}
+
+static void prepareBenchVoice(Voice& voice, Sample* sample, float pitchRatio, InterpMode mode, bool useMips) {
+    voice.sample = sample;
+    voice.positionFloat = BENCH_START_FRAME;
+    voice.amplitude = 1.0f;
+    if (useMips) {
+        voice.mipLevel = selectMipLevel(sample, pitchRatio, voice.speed);
+    } else {
+        voice.mipLevel = 0;
+        voice.speed = pitchRatio;
+    }
+    voice.interp = mode;
+    voice.noteOff = false;
+    voice.restart = false;
+    voice.startDelay = 0;
+    voice.shedding = false;
+
+    // Hold the envelope at full level so only the interpolator is measured
+    voice.env.stage = Envelope::SUSTAIN;
+    voice.env.value = 1.0f;
+}
+
+// Least-squares fit of a sine at the expected output frequency; everything
+// else in the left channel counts as interpolation error, images or aliasing
+static float measureSNR(const int32_t* mix, int frames, float cyclesPerFrame) {
+    double ss = 0, cc = 0, sc = 0, xs = 0, xc = 0;
+    for (int i = 0; i < frames; i++) {
+        double phase = 2.0 * PI * cyclesPerFrame * i;
+        double s = sin(phase), c = cos(phase), x = mix[i * 2];
+        ss += s * s; cc += c * c; sc += s * c;
+        xs += x * s; xc += x * c;
+    }
+
+    double det = ss * cc - sc * sc;
+    double a = (xs * cc - xc * sc) / det;
+    double b = (xc * ss - xs * sc) / det;
+
+    double signal = 0, residual = 0;
+    for (int i = 0; i < frames; i++) {
+        double phase = 2.0 * PI * cyclesPerFrame * i;
+        double fit = a * sin(phase) + b * cos(phase);
+        double err = mix[i * 2] - fit;
+        signal += fit * fit;
+        residual += err * err;
+    }
+    return (float)(10.0 * log10((signal + 1e-9) / (residual + 1e-9)));
+}
+
+// Output energy relative to the source tone, for cases where the ideal output is silence
+static float measureLeakage(const int32_t* mix, int frames) {
+    double energy = 0;
+    for (int i = 0; i < frames; i++) {
+        energy += (double)mix[i * 2] * mix[i * 2];
+    }
+    double reference = frames * BENCH_TONE_AMPLITUDE * BENCH_TONE_AMPLITUDE / 2.0;
+    return (float)(10.0 * log10((energy + 1e-9) / reference));
+}
+
+// Render one voice through the engine and print cost and quality
+static void runBenchCase(Sample& tone, InterpMode mode, float pitchRatio, bool useMips, int32_t* mix) {
+    uint32_t cpuHz = renderCpuMhz() * 1000000;
+    Voice voice;
+    prepareBenchVoice(voice, &tone, pitchRatio, mode, useMips);
+    memset(mix, 0, BENCH_RENDER_FRAMES * 2 * sizeof(int32_t));
+
+    uint32_t start = ESP.getCycleCount();
+    for (int offset = 0; offset < BENCH_RENDER_FRAMES; offset += ENV_BLOCK_SIZE) {
+        renderVoice(voice, mix + offset * 2, ENV_BLOCK_SIZE);
+    }
+    uint32_t cycles = ESP.getCycleCount() - start;
+
+    float cyclesPerFrame = (float)cycles / BENCH_RENDER_FRAMES;
+    float voicesPerCore = cpuHz / (cyclesPerFrame * SAMPLE_RATE);
+    float outputHz = BENCH_TONE_HZ * pitchRatio;
+
+    if (outputHz < SAMPLE_RATE / 2.0f) {
+        float snr = measureSNR(mix, BENCH_RENDER_FRAMES, outputHz / SAMPLE_RATE);
+        DEBUGF("%-8s %5.2f  mip %d  %12.1f  %12.1f  SNR %.1f dB\n",
+               interpModeName(mode), pitchRatio, voice.mipLevel, cyclesPerFrame, voicesPerCore, snr);
+    } else {
+        float leakage = measureLeakage(mix, BENCH_RENDER_FRAMES);
+        DEBUGF("%-8s %5.2f  mip %d  %12.1f  %12.1f  alias %.1f dB\n",
+               interpModeName(mode), pitchRatio, voice.mipLevel, cyclesPerFrame, voicesPerCore, leakage);
+    }
+}
+
+void benchInterpolation() {
+    DEBUG("=== Interpolation Benchmark ===");
+
+    Sample tone;
+    if (!createBenchTone(tone, BENCH_TONE_HZ)) return;
+
+    int32_t* mix = (int32_t*)malloc(BENCH_RENDER_FRAMES * 2 * sizeof(int32_t));
+    if (!mix) {
+        DEBUG("Failed to allocate bench mix buffer");
+        freeBenchTone(tone);
+        return;
+    }
+
+    DEBUGF("Tone %.0f Hz, %d frames per run, CPU %lu MHz\n",
+           BENCH_TONE_HZ, BENCH_RENDER_FRAMES, (unsigned long)renderCpuMhz());
+    DEBUG("mode     speed  level  cycles/frame  voices@44.1k  quality");
+
+    for (int m = 0; m < INTERP_MODE_COUNT; m++) {
+        for (size_t s = 0; s < sizeof(benchSpeeds) / sizeof(benchSpeeds[0]); s++) {
+            runBenchCase(tone, (InterpMode)m, benchSpeeds[s], false, mix);
+        }
+    }
+
+    free(mix);
+    freeBenchTone(tone);
+    DEBUG("=== Benchmark Complete ===");
+}
+
+void benchMipmaps() {
+    DEBUG("=== Mipmap Aliasing Benchmark ===");
+
+    Sample tone;
+    if (!createBenchTone(tone, BENCH_TONE_HZ)) return;
+
+    int32_t* mix = (int32_t*)malloc(BENCH_RENDER_FRAMES * 2 * sizeof(int32_t));
+    if (!mix || !buildSampleMipmaps(&tone, SAMPLE_MIP_LEVELS)) {
+        DEBUG("Failed to prepare mipmap bench");
+        if (mix) free(mix);
+        freeBenchTone(tone);
+        return;
+    }
+
+    DEBUGF("Tone %.0f Hz, %d mip levels, each speed without then with mipmaps\n",
+           BENCH_TONE_HZ, tone.numMipLevels - 1);
+    DEBUG("mode     speed  level  cycles/frame  voices@44.1k  quality");
+
+    static const float mipSpeeds[] = { 1.5f, 2.0f, 3.0f, 4.0f, 6.0f };
+    for (size_t s = 0; s < sizeof(mipSpeeds) / sizeof(mipSpeeds[0]); s++) {
+        runBenchCase(tone, INTERP_HERMITE, mipSpeeds[s], false, mix);
+        runBenchCase(tone, INTERP_HERMITE, mipSpeeds[s], true, mix);
+    }
+
+    free(mix);
+    freeBenchTone(tone);
+    DEBUG("=== Benchmark Complete ===");
+}
+
+// Loop bench: 441 Hz is exactly 100 frames a cycle, so a loop of whole cycles is
+// seamless and any error at the wrap shows up against the unlooped tone
+#define LOOP_TONE_HZ        441.0f
+#define LOOP_START          400
+#define LOOP_END            800
+#define LOOP_RENDER_FRAMES  8192
+
+// Render one voice for LOOP_RENDER_FRAMES and return its SNR against a sine at the output pitch
+static float runLoopCase(Sample& tone, InterpMode mode, float pitchRatio, bool useMips, int32_t* mix, int& mipLevel) {
+    Voice voice;
+    prepareBenchVoice(voice, &tone, pitchRatio, mode, useMips);
+    memset(mix, 0, LOOP_RENDER_FRAMES * 2 * sizeof(int32_t));
+    for (int offset = 0; offset < LOOP_RENDER_FRAMES; offset += ENV_BLOCK_SIZE) {
+        renderVoice(voice, mix + offset * 2, ENV_BLOCK_SIZE);
+    }
+    mipLevel = voice.mipLevel;
+    return measureSNR(mix, LOOP_RENDER_FRAMES, LOOP_TONE_HZ * pitchRatio / SAMPLE_RATE);
+}
+
+void benchLoops() {
+    DEBUG("=== Sample Loop Benchmark ===");
+
+    // Same tone twice: one plays straight through, the other keeps only up to the loop end
+    Sample straight, looped;
+    if (!createBenchTone(straight, LOOP_TONE_HZ)) return;
+    if (!createBenchTone(looped, LOOP_TONE_HZ)) {
+        freeBenchTone(straight);
+        return;
+    }
+    // The frames after the loop end are already the loop start again
+    looped.looped = true;
+    looped.loopStart = LOOP_START;
+    looped.loopEnd = LOOP_END;
+    looped.length = LOOP_END;
+    looped.mipLength[0] = LOOP_END;
+    looped.headLength = LOOP_END;
+
+    int32_t* mix = (int32_t*)malloc(LOOP_RENDER_FRAMES * 2 * sizeof(int32_t));
+    if (!mix || !buildSampleMipmaps(&straight, 1) || !buildSampleMipmaps(&looped, 1) || looped.numMipLevels < 2) {
+        DEBUG("Failed to prepare loop bench");
+        if (mix) free(mix);
+        freeBenchTone(straight);
+        freeBenchTone(looped);
+        return;
+    }
+
+    DEBUGF("Tone %.0f Hz, loop %d-%d, %d frames per run\n", LOOP_TONE_HZ, LOOP_START, LOOP_END, LOOP_RENDER_FRAMES);
+    DEBUG("mode     speed  level  wraps  looped SNR  straight SNR");
+
+    static const float loopSpeeds[] = { 0.75f, 1.0f, 1.5f, 2.0f };
+    for (int m = 0; m < INTERP_MODE_COUNT; m++) {
+        for (size_t s = 0; s < sizeof(loopSpeeds) / sizeof(loopSpeeds[0]); s++) {
+            // 2x reads mip level 1, where the loop is half as long
+            bool useMips = loopSpeeds[s] >= 2.0f;
+            int level = 0;
+            float loopedSnr = runLoopCase(looped, (InterpMode)m, loopSpeeds[s], useMips, mix, level);
+            float straightSnr = runLoopCase(straight, (InterpMode)m, loopSpeeds[s], useMips, mix, level);
+            int wraps = (int)(LOOP_RENDER_FRAMES * loopSpeeds[s]) / (LOOP_END - LOOP_START);
+            DEBUGF("%-8s %5.2f  mip %d  %5d  %7.1f dB  %9.1f dB\n", interpModeName((InterpMode)m), loopSpeeds[s],
+                   level, wraps, loopedSnr, straightSnr);
+        }
+    }
+
+    free(mix);
+    freeBenchTone(straight);
+    freeBenchTone(looped);
+    DEBUG("=== Benchmark Complete ===");
+}
+
+// Feed the limiter a buffer, return the peak it let through and add up its cycles
+static int32_t runLimiterPass(Limiter& limiter, const int32_t* in, int16_t* out, uint32_t& cycles) {
+    uint32_t start = ESP.getCycleCount();
+    limiterProcess(limiter, in, out, DMA_BUF_LEN);
+    cycles += ESP.getCycleCount() - start;
+
+    int32_t peak = 0;
+    for (int i = 0; i < DMA_BUF_LEN * 2; i++) {
+        peak = max(peak, (int32_t)abs(out[i]));
+    }
+    return peak;
+}
+
+void benchLimiter() {
+    DEBUG("=== Limiter Benchmark ===");
+
+    const int buffers = 400;   // ~2.3 s of audio
+    int32_t* in = (int32_t*)malloc(DMA_BUF_LEN * 2 * sizeof(int32_t));
+    int16_t* out = (int16_t*)malloc(DMA_BUF_LEN * 2 * sizeof(int16_t));
+    Limiter* limiter = (Limiter*)malloc(sizeof(Limiter));
+    if (!in || !out || !limiter) {
+        DEBUG("Failed to allocate limiter bench buffers");
+        if (in) free(in);
+        if (out) free(out);
+        if (limiter) free(limiter);
+        return;
+    }
+
+    // Quiet passage first (must pass untouched), then eight full-scale voices with
+    // sudden bursts that hit up to 8x the ceiling, left and right out of phase
+    limiterInit(*limiter, LIMITER_CEILING, LIMITER_RELEASE_MS);
+    uint32_t cycles = 0;
+    int32_t quietPeak = 0, loudPeak = 0;
+    bool transparent = true;
+    uint32_t frame = 0;
+
+    for (int b = 0; b < buffers; b++) {
+        bool loud = b >= buffers / 4;
+        for (int i = 0; i < DMA_BUF_LEN; i++, frame++) {
+            float t = (float)frame / SAMPLE_RATE;
+            float burst = (loud && (frame / 2048) % 3 == 0) ? 8.0f : (loud ? 2.5f : 0.4f);
+            float value = 32767.0f * burst * (0.6f * sinf(2.0f * PI * 110.0f * t) + 0.4f * sinf(2.0f * PI * 1870.0f * t));
+            in[i * 2] = (int32_t)value;
+            in[i * 2 + 1] = (int32_t)(-0.8f * value);
+        }
+
+        int32_t peak = runLimiterPass(*limiter, in, out, cycles);
+        if (loud) {
+            loudPeak = max(loudPeak, peak);
+        } else {
+            quietPeak = max(quietPeak, peak);
+            // Quiet audio leaves the lookahead delay untouched
+            if (b > 0 && limiter->gain != LIMITER_UNITY) transparent = false;
+        }
+    }
+
+    float cyclesPerBuffer = (float)cycles / buffers;
+    float blockCycles = (float)renderCpuMhz() * 1000000.0f * DMA_BUF_LEN / SAMPLE_RATE;
+    DEBUGF("Ceiling: %d, quiet peak: %ld, loud peak: %ld\n",
+           LIMITER_CEILING, (long)quietPeak, (long)loudPeak);
+    DEBUGF("Max gain reduction: %.1f dB\n", -20.0f * log10f((float)limiter->minGain / LIMITER_UNITY));
+    DEBUGF("Cost: %.0f cycles per %d-frame buffer (%.2f%% of one core)\n",
+           cyclesPerBuffer, DMA_BUF_LEN, 100.0f * cyclesPerBuffer / blockCycles);
+    DEBUGF("Ceiling held: %s\n", loudPeak <= LIMITER_CEILING ? "PASS" : "FAIL");
+    DEBUGF("Transparent below ceiling: %s\n", transparent ? "PASS" : "FAIL");
+
+    free(in);
+    free(out);
+    free(limiter);
+    DEBUG("=== Benchmark Complete ===");
+}
+
+// The pool as it was before the hot/cold split: note bookkeeping interleaved
+// with render state and an active flag tested for every voice
+struct LegacyVoice {
+    Voice voice;
+    VoiceInfo info;
+    bool isActive;
+};
+
+void benchVoices() {
+    DEBUG("=== Voice Pool Benchmark ===");
+
+    Sample tone;
+    if (!createBenchTone(tone, BENCH_TONE_HZ)) return;
+
+    int32_t* mix = (int32_t*)malloc(ENV_BLOCK_SIZE * 2 * sizeof(int32_t));
+    Voice* pool = (Voice*)malloc(MAX_POLYPHONY * sizeof(Voice));
+    LegacyVoice* legacy = (LegacyVoice*)malloc(MAX_POLYPHONY * sizeof(LegacyVoice));
+    if (!mix || !pool || !legacy) {
+        DEBUG("Failed to allocate voice bench buffers");
+        if (mix) free(mix);
+        if (pool) free(pool);
+        if (legacy) free(legacy);
+        freeBenchTone(tone);
+        return;
+    }
+
+    const int blocks = BENCH_RENDER_FRAMES / ENV_BLOCK_SIZE;
+    DEBUGF("Linear interpolation, %d blocks of %d frames, %d voice pool\n", blocks, ENV_BLOCK_SIZE, MAX_POLYPHONY);
+    DEBUG("voices  scan cycles/block  mask cycles/block  saved");
+
+    for (int active = 0; active <= MAX_POLYPHONY; active++) {
+        uint32_t mask = active == 32 ? 0xFFFFFFFFu : (1u << active) - 1;
+        for (int v = 0; v < MAX_POLYPHONY; v++) {
+            prepareBenchVoice(pool[v], &tone, 1.0f + 0.07f * v, INTERP_LINEAR, false);
+            legacy[v].voice = pool[v];
+            legacy[v].isActive = (mask >> v) & 1;
+        }
+
+        uint32_t start = ESP.getCycleCount();
+        for (int b = 0; b < blocks; b++) {
+            memset(mix, 0, ENV_BLOCK_SIZE * 2 * sizeof(int32_t));
+            for (int v = 0; v < MAX_POLYPHONY; v++) {
+                if (legacy[v].isActive) renderVoice(legacy[v].voice, mix, ENV_BLOCK_SIZE);
+            }
+        }
+        uint32_t scanCycles = ESP.getCycleCount() - start;
+
+        start = ESP.getCycleCount();
+        for (int b = 0; b < blocks; b++) {
+            memset(mix, 0, ENV_BLOCK_SIZE * 2 * sizeof(int32_t));
+            mixVoiceBlock(pool, mask, mix, ENV_BLOCK_SIZE);
+        }
+        uint32_t maskCycles = ESP.getCycleCount() - start;
+
+        DEBUGF("%6d  %17.0f  %17.0f  %5.1f%%\n", active, (float)scanCycles / blocks, (float)maskCycles / blocks,
+               100.0f * ((float)scanCycles - maskCycles) / max(scanCycles, 1u));
+    }
+
+    free(mix);
+    free(pool);
+    free(legacy);
+    freeBenchTone(tone);
+    DEBUG("=== Benchmark Complete ===");
+}
+
+// The kernel as it was before specialisation: channel count and interpolation
+// mode decided again for every frame
+static float mixGeneric(const int16_t* data, uint8_t channels, InterpMode mode, float position, float speed,
+                        float gain, float gainStep, int32_t* mix, int count) {
+    for (int i = 0; i < count; i++) {
+        uint32_t pos = (uint32_t)position;
+        float frac = position - pos;
+        for (int c = 0; c < 2; c++) {
+            const int16_t* frame = data + pos * channels + (channels == 1 ? 0 : c);
+            float value;
+            if (mode == INTERP_NONE) {
+                value = frame[0];
+            } else if (mode == INTERP_HERMITE) {
+                const float* h = hermiteTable[(int)(frac * INTERP_PHASES)];
+                value = h[0] * frame[-channels] + h[1] * frame[0] + h[2] * frame[channels] + h[3] * frame[2 * channels];
+            } else if (mode == INTERP_SINC) {
+                const float* k = sincTable[(int)(frac * INTERP_PHASES)];
+                value = 0.0f;
+                for (int t = 0; t < SINC_TAPS; t++) value += k[t] * frame[(t - 3) * channels];
+            } else {
+                value = frame[0] + frac * (frame[channels] - frame[0]);
+            }
+            mix[i * 2 + c] += (int32_t)(value * gain);
+        }
+        gain += gainStep;
+        position += speed;
+    }
+    return position;
+}
+
+void benchKernels() {
+    DEBUG("=== Voice Kernel Benchmark ===");
+
+    Sample tones[2];
+    if (!createBenchTone(tones[0], BENCH_TONE_HZ, 1)) return;
+    if (!createBenchTone(tones[1], BENCH_TONE_HZ, 2)) {
+        freeBenchTone(tones[0]);
+        return;
+    }
+
+    int32_t* expected = (int32_t*)malloc(BENCH_RENDER_FRAMES * 2 * sizeof(int32_t));
+    int32_t* mix = (int32_t*)malloc(BENCH_RENDER_FRAMES * 2 * sizeof(int32_t));
+    if (!expected || !mix) {
+        DEBUG("Failed to allocate kernel bench buffers");
+        if (expected) free(expected);
+        if (mix) free(mix);
+        freeBenchTone(tones[0]);
+        freeBenchTone(tones[1]);
+        return;
+    }
+
+    DEBUGF("%d frames per run, generic per-frame branching vs the kernel picked per block\n", BENCH_RENDER_FRAMES);
+    DEBUG("source  mode     speed  generic c/f  special c/f  speedup  max diff");
+
+    static const float kernelSpeeds[] = { 1.0f, 1.5f };
+    for (int t = 0; t < 2; t++) {
+        const Sample& tone = tones[t];
+        for (int m = 0; m < INTERP_MODE_COUNT; m++) {
+            for (size_t s = 0; s < sizeof(kernelSpeeds) / sizeof(kernelSpeeds[0]); s++) {
+                float speed = kernelSpeeds[s];
+                float gain = 0.5f, gainStep = 0.5f / BENCH_RENDER_FRAMES;
+                // Unity runs read the whole render from the tone, pitched ones stay inside it too
+                int frames = min(BENCH_RENDER_FRAMES, (int)((BENCH_TONE_FRAMES - BENCH_START_FRAME - 8) / speed));
+
+                memset(expected, 0, BENCH_RENDER_FRAMES * 2 * sizeof(int32_t));
+                uint32_t start = ESP.getCycleCount();
+                mixGeneric(tone.data, tone.channels, (InterpMode)m, BENCH_START_FRAME, speed, gain, gainStep,
+                           expected, frames);
+                uint32_t genericCycles = ESP.getCycleCount() - start;
+
+                memset(mix, 0, BENCH_RENDER_FRAMES * 2 * sizeof(int32_t));
+                start = ESP.getCycleCount();
+                MixKernel kernel = selectMixKernel(tone.channels, (InterpMode)m, speed, BENCH_START_FRAME);
+                kernel(tone.data, BENCH_START_FRAME, speed, gain, gainStep, mix, frames);
+                uint32_t specialCycles = ESP.getCycleCount() - start;
+
+                int32_t maxDiff = 0;
+                for (int i = 0; i < frames * 2; i++) {
+                    maxDiff = max(maxDiff, (int32_t)abs(mix[i] - expected[i]));
+                }
+                DEBUGF("%-6s  %-8s %5.2f  %11.1f  %11.1f  %6.2fx  %ld\n", tone.channels == 1 ? "mono" : "stereo",
+                       interpModeName((InterpMode)m), speed, (float)genericCycles / frames,
+                       (float)specialCycles / frames, (float)genericCycles / max(specialCycles, 1u), (long)maxDiff);
+            }
+        }
+    }
+
+    free(expected);
+    free(mix);
+    freeBenchTone(tones[0]);
+    freeBenchTone(tones[1]);
+    DEBUG("=== Benchmark Complete ===");
+}
\ No newline at end of file
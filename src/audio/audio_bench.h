@@ -0,0 +1,8 @@
+#pragma once
+
+void benchInterpolation();
+void benchMipmaps();
+void benchLoops();
+void benchLimiter();
+void benchVoices();
+void benchKernels();
\ No newline at end of file
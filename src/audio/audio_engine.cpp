@@ -5,44 +5,158 @@
 #include "../storage/instrument_manager.h"
 #include "i2s_manager.h"
 #include "mp3_streamer.h"
+#include "sample_streamer.h"
+#include "limiter.h"
+#include "perf_stats.h"
+#include "voice_governor.h"
+#include "controllers.h"
+#include "../utils/trace.h"
+#include "../midi/sequencer.h"
 
 Voice voices[MAX_POLYPHONY];
+VoiceInfo voiceInfo[MAX_POLYPHONY];
+uint32_t activeVoiceMask = 0;
 TaskHandle_t audioTask;
+Limiter masterLimiter;
+uint32_t voiceSteals = 0;
+volatile bool idleThrottle = IDLE_CPU_MHZ > 0;
+VoiceUsageStats voiceUsage;
+static uint32_t voiceCounter = 0;
+
+static_assert((NOTE_QUEUE & (NOTE_QUEUE - 1)) == 0, "NOTE_QUEUE must be a power of two");
+
+// Live notes and pedals from the other tasks. Producers claim a slot with a
+// compare-and-swap like the deferred log; the audio task plays them at its next
+// envelope block, so it never waits on the control side.
+enum NoteMessageType : uint8_t { NOTE_MESSAGE_ON, NOTE_MESSAGE_OFF, NOTE_MESSAGE_SUSTAIN };
+
+struct NoteMessage {
+    uint32_t seq;           // Queue position it is free for, + 1 once published
+    uint8_t type;
+    uint8_t channel;
+    uint8_t note;
+    uint8_t value;          // Velocity, or pedal down
+};
+
+static NoteMessage noteQueue[NOTE_QUEUE];
+static uint32_t noteQueueHead = 0;     // Next position to claim
+static uint32_t noteQueueTail = 0;     // Next position to play (audio task)
+static uint32_t noteQueueDrops = 0;   // Posts lost to a full queue
 
 void initVoices() {
+    initInterpolation();
+    limiterInit(masterLimiter, LIMITER_CEILING, LIMITER_RELEASE_MS);
+    governorInit();
+    initControllers();
+    resetPerfStats();
+    for (uint32_t i = 0; i < NOTE_QUEUE; i++) noteQueue[i].seq = i;
+    noteQueueHead = 0;
+    noteQueueTail = 0;
+    
+    activeVoiceMask = 0;
     for (int i = 0; i < MAX_POLYPHONY; i++) {
-        voices[i].isActive = false;
-        voices[i].envState = Voice::IDLE;
+        voices[i].sample = nullptr;
+        voices[i].env.stage = Envelope::IDLE;
+        voices[i].env.value = 0.0f;
         voices[i].noteOff = false;
+        voices[i].restart = false;
+        voices[i].startDelay = 0;
+        voices[i].shedding = false;
+        voiceInfo[i].channel = 0;
+        voiceInfo[i].startOrder = 0;
+        voiceInfo[i].sustained = false;
     }
 }
 
-Voice* getFreeVoice() {
-    for (int i = 0; i < MAX_POLYPHONY; i++) {
-        if (!voices[i].isActive) {
-            return &voices[i];
+// A free voice if the governor's budget allows one. Otherwise the channel holding
+// the most voices gives one up (the caller's own channel on a tie), so a busy part
+// can't starve the others: its oldest released note, or failing that its oldest note.
+int allocateVoice(uint8_t channel) {
+    uint32_t active = getActiveVoices();
+    uint32_t idle = ~active & ((MAX_POLYPHONY == 32) ? 0xFFFFFFFFu : ((1u << MAX_POLYPHONY) - 1));
+    if (idle && (!active || __builtin_popcount(active) < voiceGovernor.budget)) return __builtin_ctz(idle);
+    
+    uint8_t counts[MIDI_CHANNELS] = { 0 };
+    for (uint32_t walk = active; walk; walk &= walk - 1) {
+        counts[voiceInfo[__builtin_ctz(walk)].channel]++;
+    }
+    
+    uint8_t victim = channel;
+    for (int c = 0; c < MIDI_CHANNELS; c++) {
+        if (counts[c] > counts[victim]) victim = c;
+    }
+    
+    int best = -1;
+    bool bestReleased = false;
+    for (uint32_t walk = active; walk; walk &= walk - 1) {
+        int i = __builtin_ctz(walk);
+        if (voiceInfo[i].channel != victim) continue;
+        bool released = voices[i].noteOff || voiceInfo[i].sustained || voices[i].env.stage == Envelope::RELEASE;
+        if (best < 0 || (released && !bestReleased) ||
+            (released == bestReleased && voiceInfo[i].startOrder < voiceInfo[best].startOrder)) {
+            best = i;
+            bestReleased = released;
         }
     }
-    return nullptr; // No free voices
+    return best;
+}
+
+uint8_t selectMipLevel(const Sample* sample, float pitchRatio, float& stride) {
+    // Each level halves the stride; switch half an octave early so reads stay near unity
+    uint8_t level = 0;
+    stride = pitchRatio;
+    while (level + 1 < sample->numMipLevels && stride >= MIP_SWITCH_RATIO) {
+        stride *= 0.5f;
+        level++;
+    }
+    return level;
+}
+
+// Peaks taken whenever a note starts or the pedal takes one over
+static void updateVoiceUsage() {
+    uint32_t active = getActiveVoices();
+    int pedalVoices = 0;
+    int sustained = 0;
+    for (uint32_t walk = active; walk; walk &= walk - 1) {
+        int i = __builtin_ctz(walk);
+        if (channelControls[voiceInfo[i].channel].sustain) pedalVoices++;
+        if (voiceInfo[i].sustained) sustained++;
+    }
+    voiceUsage.peakVoices = max(voiceUsage.peakVoices, (uint8_t)__builtin_popcount(active));
+    voiceUsage.peakPedalVoices = max(voiceUsage.peakPedalVoices, (uint8_t)pedalVoices);
+    voiceUsage.peakSustained = max(voiceUsage.peakSustained, (uint8_t)sustained);
+}
+
+// Reset a voice for a new note (control side for a free voice, audio task for a stolen one)
+static void startNote(Voice& voice, const NoteStart& start) {
+    voice.sample = start.sample;
+    voice.positionFloat = 0.0f;
+    voice.amplitude = start.amplitude;
+    voice.baseSpeed = start.speed;  // Speed based on pitch, relative to the chosen mip level
+    voice.speed = start.speed * channelControls[voiceInfo[&voice - voices].channel].pitch;
+    voice.mipLevel = start.mipLevel;
+    voice.interp = start.interp;
+    voice.startDelay = start.delay;
+    voice.shedding = false;
+    if (start.sample->streamed) {
+        // The head covers the first SAMPLE_HEAD_MS while the reader catches up
+        startVoiceStream(&voice - voices, start.sample, start.speed);
+    }
+    envelopeNoteOn(voice.env, start.envelope);
 }
 
-void noteOn(uint8_t midiNote, uint8_t velocity) {
-    Instrument* instrument = getCurrentInstrument();
+static void startVoiceForNote(uint8_t channel, uint8_t midiNote, uint8_t velocity, uint8_t startOffset) {
+    // Channel -> instrument -> key sample are all table lookups
+    Instrument* instrument = getChannelInstrument(channel);
     if (!instrument) {
-        DEBUG("No instrument selected");
+        DEBUGQF("No instrument on channel %d\n", channel + 1);
         return;
     }
     
-    // Find the best key sample for this MIDI note
-    KeySample* keySample = findBestKeySample(instrument, midiNote);
+    KeySample* keySample = findBestKeySample(instrument, midiNote, velocity);
+    prefetchZones(instrument, midiNote, velocity);
     if (!keySample || !keySample->sample) {
-        DEBUGF("No suitable sample found for MIDI note %d\n", midiNote);
-        return;
-    }
-
-    Voice* voice = getFreeVoice();
-    if (!voice) {
-        DEBUG("No free voices available");
+        DEBUGQF("No suitable sample found for MIDI note %d\n", midiNote);
         return;
     }
 
@@ -50,135 +164,587 @@ void noteOn(uint8_t midiNote, uint8_t velocity) {
     int semitoneOffset = (int)midiNote - (int)keySample->rootNote;
     float pitchRatio = calculatePitchRatio(semitoneOffset);
     
-    // Initialize voice
-    voice->sample = keySample->sample;
-    voice->position = 0;
-    voice->positionFloat = 0.0f;
-    voice->isActive = true;
-    voice->midiNote = midiNote;
-    voice->velocity = velocity;
-    voice->amplitude = velocity / 127.0f;
-    voice->speed = pitchRatio;  // This is the key change - speed based on pitch
-    voice->envState = Voice::ATTACK;
-    voice->envValue = 0.0f;
-    voice->envTarget = 1.0f;
-    voice->envRate = 0.01f; // Fast attack
-    voice->noteOff = false;
-
-    DEBUGF("Note ON: %d, using sample at note %d (ratio: %.3f)\n", midiNote, keySample->rootNote, pitchRatio);
-}
-
-void noteOff(uint8_t midiNote) {
-    for (int i = 0; i < MAX_POLYPHONY; i++) {
-        if (voices[i].isActive && voices[i].midiNote == midiNote) {
-            voices[i].noteOff = true;
-            voices[i].envState = Voice::RELEASE;
-            voices[i].envTarget = 0.0f;
-            voices[i].envRate = 0.002f; // Slow release
-            DEBUGF("Note OFF: %d\n", midiNote);
+    // Pick a band-limited copy so the read stride stays near unity
+    NoteStart start;
+    start.sample = keySample->sample;
+    start.mipLevel = selectMipLevel(keySample->sample, pitchRatio, start.speed);
+    start.amplitude = velocity / 127.0f;
+    start.interp = (interpOverride < INTERP_MODE_COUNT) ? (InterpMode)interpOverride : instrument->interpMode;
+    start.envelope = instrument->envelope;
+    start.delay = min(startOffset, (uint8_t)(ENV_BLOCK_SIZE - 1));
+
+    int index = allocateVoice(channel);
+    if (index < 0) {
+        DEBUGQ("No free voices available");
+        return;
+    }
+    Voice& voice = voices[index];
+    VoiceInfo& info = voiceInfo[index];
+    uint32_t bit = 1u << index;
+    
+    info.midiNote = midiNote;
+    info.velocity = velocity;
+    info.channel = channel;
+    info.startOrder = ++voiceCounter;
+    info.sustained = false;
+    voice.noteOff = false;
+    if (getActiveVoices() & bit) {
+        // Still playing: hand the note over, renderVoice restarts it
+        info.pending = start;
+        __atomic_store_n(&voice.restart, true, __ATOMIC_RELEASE);  // After `pending`
+        voiceSteals++;
+        trace(TRACE_VOICE_STEAL, channel << 8 | midiNote, index);
+        for (int c = 0; c < MIDI_CHANNELS; c++) {
+            if (channelControls[c].sustain) {
+                voiceUsage.pedalSteals++;
+                break;
+            }
+        }
+        if (getActiveVoices() & bit) {
+            DEBUGQF("Note ON: %d ch %d, stole a voice\n", midiNote, channel + 1);
+            return;
         }
+        // The old note ended meanwhile: whichever side takes the flag back starts the note
+        if (!__atomic_exchange_n(&voice.restart, false, __ATOMIC_ACQ_REL)) return;
     }
+    startNote(voice, start);
+    // Set last so the audio task never sees a half-initialised voice
+    __atomic_fetch_or(&activeVoiceMask, bit, __ATOMIC_RELEASE);
+    trace(TRACE_NOTE_ON, channel << 8 | midiNote, index << 8 | velocity);
+    updateVoiceUsage();
+
+    DEBUGQF("Note ON: %d ch %d, using sample at note %d (ratio: %.3f)\n", midiNote, channel + 1,
+           keySample->rootNote, pitchRatio);
 }
 
-void processVoice(Voice& voice, int16_t& leftOut, int16_t& rightOut) {
-    if (!voice.isActive || !voice.sample) {
-        return;
+static void releaseVoicesForNote(uint8_t channel, uint8_t midiNote) {
+    bool pedal = channel < MIDI_CHANNELS && channelControls[channel].sustain;
+    uint32_t active = getActiveVoices();
+    while (active) {
+        int i = __builtin_ctz(active);
+        active &= active - 1;
+        if (voiceInfo[i].channel == channel && voiceInfo[i].midiNote == midiNote && !voices[i].noteOff) {
+            if (pedal) {
+                // Rings on until the pedal lifts
+                voiceInfo[i].sustained = true;
+            } else {
+                // The audio task moves the envelope into release at its next block
+                voices[i].noteOff = true;
+            }
+            trace(TRACE_NOTE_OFF, channel << 8 | midiNote, pedal);
+            DEBUGQF("Note OFF: %d ch %d%s\n", midiNote, channel + 1, pedal ? " (sustained)" : "");
+        }
     }
+    if (pedal) updateVoiceUsage();
+}
 
-    // Update envelope
-    switch (voice.envState) {
-        case Voice::ATTACK:
-            voice.envValue += voice.envRate;
-            if (voice.envValue >= voice.envTarget) {
-                voice.envValue = voice.envTarget;
-                voice.envState = Voice::SUSTAIN;
+static void applySustain(uint8_t channel, bool down) {
+    if (channel >= MIDI_CHANNELS) return;
+    channelControls[channel].sustain = down;
+    if (down) {
+        updateVoiceUsage();
+    } else {
+        uint32_t active = getActiveVoices();
+        while (active) {
+            int i = __builtin_ctz(active);
+            active &= active - 1;
+            if (voiceInfo[i].channel == channel && voiceInfo[i].sustained) {
+                voiceInfo[i].sustained = false;
+                voices[i].noteOff = true;
             }
-            break;
-        case Voice::SUSTAIN:
-            if (voice.noteOff) {
-                voice.envState = Voice::RELEASE;
-                voice.envTarget = 0.0f;
-                voice.envRate = 0.002f;
+        }
+    }
+}
+
+static bool postNoteMessage(uint8_t type, uint8_t channel, uint8_t note, uint8_t value) {
+    uint32_t pos = __atomic_load_n(&noteQueueHead, __ATOMIC_RELAXED);
+    for (;;) {
+        NoteMessage& message = noteQueue[pos & (NOTE_QUEUE - 1)];
+        int32_t ahead = (int32_t)(__atomic_load_n(&message.seq, __ATOMIC_ACQUIRE) - pos);
+        if (ahead == 0) {
+            if (__atomic_compare_exchange_n(&noteQueueHead, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                message.type = type;
+                message.channel = channel;
+                message.note = note;
+                message.value = value;
+                __atomic_store_n(&message.seq, pos + 1, __ATOMIC_RELEASE);
+                return true;
             }
-            break;
-        case Voice::RELEASE:
-            voice.envValue -= voice.envRate;
-            if (voice.envValue <= 0.0f) {
-                voice.envValue = 0.0f;
-                voice.isActive = false;
-                voice.envState = Voice::IDLE;
-                return;
+        } else if (ahead < 0) {
+            // A lap behind: the audio task isn't taking notes
+            __atomic_fetch_add(&noteQueueDrops, 1, __ATOMIC_RELAXED);
+            return false;
+        } else {
+            pos = __atomic_load_n(&noteQueueHead, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static bool noteMessagesPending() {
+    const NoteMessage& message = noteQueue[noteQueueTail & (NOTE_QUEUE - 1)];
+    return __atomic_load_n(&message.seq, __ATOMIC_ACQUIRE) == noteQueueTail + 1;
+}
+
+// Plays (or with `play` false, discards) everything posted so far. Audio task,
+// or the render test's task while the audio task is held.
+static void takeNoteMessages(bool play) {
+    while (noteMessagesPending()) {
+        NoteMessage& message = noteQueue[noteQueueTail & (NOTE_QUEUE - 1)];
+        if (play) {
+            switch (message.type) {
+                case NOTE_MESSAGE_ON:
+                    startVoiceForNote(message.channel, message.note, message.value, 0);
+                    break;
+                case NOTE_MESSAGE_OFF:
+                    releaseVoicesForNote(message.channel, message.note);
+                    break;
+                case NOTE_MESSAGE_SUSTAIN:
+                    applySustain(message.channel, message.value);
+                    break;
             }
-            break;
-        default:
-            break;
+        }
+        __atomic_store_n(&message.seq, noteQueueTail + NOTE_QUEUE, __ATOMIC_RELEASE);
+        noteQueueTail++;
     }
+}
 
-    // Get sample data with bounds checking
-    uint32_t pos = (uint32_t)voice.positionFloat;
-    if (pos >= voice.sample->length - 1) {
-        voice.isActive = false;
-        return;
+// The sequencer plays straight from the audio task; everything else goes through the queue
+static inline bool onAudioTask() {
+    return audioTask && xTaskGetCurrentTaskHandle() == audioTask;
+}
+
+void noteOn(uint8_t channel, uint8_t midiNote, uint8_t velocity, uint8_t startOffset) {
+    if (onAudioTask()) {
+        startVoiceForNote(channel, midiNote, velocity, startOffset);
+    } else {
+        postNoteMessage(NOTE_MESSAGE_ON, channel, midiNote, velocity);
     }
+}
 
-    // Linear interpolation for smooth pitch shifting
-    float frac = voice.positionFloat - pos;
-    int16_t sample1L = voice.sample->data[pos * 2];
-    int16_t sample1R = voice.sample->data[pos * 2 + 1];
-    int16_t sample2L = voice.sample->data[(pos + 1) * 2];
-    int16_t sample2R = voice.sample->data[(pos + 1) * 2 + 1];
-    
-    float interpL = sample1L + frac * (sample2L - sample1L);
-    float interpR = sample1R + frac * (sample2R - sample1R);
+void noteOff(uint8_t channel, uint8_t midiNote) {
+    if (onAudioTask()) {
+        releaseVoicesForNote(channel, midiNote);
+    } else {
+        postNoteMessage(NOTE_MESSAGE_OFF, channel, midiNote, 0);
+    }
+}
+
+void setSustain(uint8_t channel, bool down) {
+    if (onAudioTask()) {
+        applySustain(channel, down);
+    } else {
+        postNoteMessage(NOTE_MESSAGE_SUSTAIN, channel, 0, down);
+    }
+}
+
+void printVoiceUsage() {
+    DEBUGF("Voice usage: peak %d of %d, %d with a pedal down, %d held by the pedal alone, %lu steals under sustain\n",
+           voiceUsage.peakVoices, MAX_POLYPHONY, voiceUsage.peakPedalVoices, voiceUsage.peakSustained,
+           (unsigned long)voiceUsage.pedalSteals);
+    if (noteQueueDrops) DEBUGF("  %lu notes dropped with the note queue full\n", (unsigned long)noteQueueDrops);
+}
+
+// Interpolated value of one channel at `frame` (which points at that channel of
+// the integer frame) for a fractional offset. `c` is the phase's coefficient row.
+template <int CH, InterpMode MODE>
+static inline float interpolate(const int16_t* frame, float frac, const float* c) {
+    if (MODE == INTERP_NONE) {
+        return frame[0];
+    } else if (MODE == INTERP_LINEAR) {
+        return frame[0] + frac * (frame[CH] - frame[0]);
+    } else if (MODE == INTERP_HERMITE) {
+        return c[0] * frame[-CH] + c[1] * frame[0] + c[2] * frame[CH] + c[3] * frame[2 * CH];
+    } else {
+        float value = 0.0f;
+        for (int k = 0; k < SINC_TAPS; k++) {
+            value += c[k] * frame[(k - 3) * CH];
+        }
+        return value;
+    }
+}
+
+// Interpolation kernels: mix `count` frames of a sample with CH interleaved
+// channels into the stereo bus with a linear gain ramp and return the advanced
+// position. Mono is interpolated once and added to both sides. Callers
+// guarantee every tap lies inside the sample or its guard frames.
+template <int CH, InterpMode MODE>
+static float mixPitched(const int16_t* data, float position, float speed, float gain, float gainStep,
+                        int32_t* mix, int count) {
+    for (int i = 0; i < count; i++) {
+        uint32_t pos = (uint32_t)position;
+        float frac = position - pos;
+        const float* c = nullptr;
+        if (MODE == INTERP_HERMITE) c = hermiteTable[(int)(frac * INTERP_PHASES)];
+        if (MODE == INTERP_SINC) c = sincTable[(int)(frac * INTERP_PHASES)];
+        const int16_t* frame = data + pos * CH;
+
+        float left = interpolate<CH, MODE>(frame, frac, c);
+        if (CH == 1) {
+            int32_t value = (int32_t)(left * gain);
+            mix[i * 2] += value;
+            mix[i * 2 + 1] += value;
+        } else {
+            float right = interpolate<CH, MODE>(frame + 1, frac, c);
+            mix[i * 2] += (int32_t)(left * gain);
+            mix[i * 2 + 1] += (int32_t)(right * gain);
+        }
+        gain += gainStep;
+        position += speed;
+    }
+    return position;
+}
 
-    // Apply envelope and velocity
-    float gain = voice.envValue * voice.amplitude * sampleVolume;
+// Unity speed from a whole frame needs no interpolation: the stored frames are
+// added straight in, as drum hits at their root note usually are
+template <int CH>
+static float mixUnity(const int16_t* data, float position, float speed, float gain, float gainStep,
+                      int32_t* mix, int count) {
+    const int16_t* frame = data + (uint32_t)position * CH;
+    for (int i = 0; i < count; i++) {
+        if (CH == 1) {
+            int32_t value = (int32_t)(frame[i] * gain);
+            mix[i * 2] += value;
+            mix[i * 2 + 1] += value;
+        } else {
+            mix[i * 2] += (int32_t)(frame[i * 2] * gain);
+            mix[i * 2 + 1] += (int32_t)(frame[i * 2 + 1] * gain);
+        }
+        gain += gainStep;
+    }
+    return position + count;
+}
+
+// Indexed by [channels - 1][interpolation mode]
+static const MixKernel pitchedKernels[2][INTERP_MODE_COUNT] = {
+    { mixPitched<1, INTERP_NONE>, mixPitched<1, INTERP_LINEAR>, mixPitched<1, INTERP_HERMITE>, mixPitched<1, INTERP_SINC> },
+    { mixPitched<2, INTERP_NONE>, mixPitched<2, INTERP_LINEAR>, mixPitched<2, INTERP_HERMITE>, mixPitched<2, INTERP_SINC> },
+};
+static const MixKernel unityKernels[2] = { mixUnity<1>, mixUnity<2> };
+
+MixKernel selectMixKernel(uint8_t channels, InterpMode mode, float speed, float position) {
+    int layout = channels == 1 ? 0 : 1;
+    // Whole-frame steps keep a unity voice on whole frames for the rest of its note
+    if (speed == 1.0f && position == (float)(uint32_t)position) {
+        return unityKernels[layout];
+    }
+    return pitchedKernels[layout][mode < INTERP_MODE_COUNT ? mode : INTERP_LINEAR];
+}
+
+// Streamed samples play the resident head, then the voice's ring. Frames the
+// reader hasn't delivered yet are left silent and the voice holds its position,
+// so a late read costs a gap rather than garbage. Returns the frames mixed.
+static int mixStreamed(Voice& voice, MixKernel kernel, float gain, float gainStep, int32_t* mix, int count) {
+    const Sample* sample = voice.sample;
+    int index = &voice - voices;
+    float position = voice.positionFloat;
     
-    // Add anti-aliasing filter for high pitch ratios (simple)
-    if (voice.speed > 2.0f) {
-        gain *= 0.7f; // Reduce gain for very high pitches to reduce aliasing
+    // One ring window can't span more than the mirrored guard
+    int maxChunk = max(1, (int)((STREAM_GUARD_FRAMES - 16) / voice.speed));
+    int done = 0;
+    while (done < count) {
+        int n = min(count - done, maxChunk);
+        float chunkGain = gain + gainStep * done;
+        uint32_t lastTap = (uint32_t)(position + (n - 1) * voice.speed) + 5;
+        if (lastTap < sample->headLength) {
+            position = kernel(sample->data, position, voice.speed, chunkGain, gainStep, mix + done * 2, n);
+        } else {
+            uint32_t base = (uint32_t)position - 4;
+            const int16_t* window = getStreamWindow(index, base, lastTap - base + 1);
+            if (!window) {
+                sampleStreamStats.underruns++;
+                trace(TRACE_UNDERRUN, TRACE_SRC_SAMPLE_STREAM, index);
+                break;
+            }
+            position = base + kernel(window, position - base, voice.speed, chunkGain, gainStep, mix + done * 2, n);
+        }
+        done += n;
     }
+    voice.positionFloat = position;
+    return done;
+}
+
+// Looped samples mix up to the loop end, wrap, and carry on until the envelope
+// ends the voice. Taps past the end read the guard copy of the loop start.
+static void mixLooped(Voice& voice, MixKernel kernel, float gain, float gainStep, int32_t* mix, int count) {
+    const Sample* sample = voice.sample;
+    const int16_t* data = sample->mipData[voice.mipLevel];
+    float loopEnd = (float)sample->mipLength[voice.mipLevel];
+    float loopLength = loopEnd - (float)(sample->loopStart >> voice.mipLevel);
+    float position = voice.positionFloat;
     
-    leftOut += (int16_t)(interpL * gain);
-    rightOut += (int16_t)(interpR * gain);
+    int done = 0;
+    while (done < count) {
+        // Every frame of a piece starts before the loop end (with room for the kernel's rounding)
+        int n = min(count - done, max(1, (int)ceilf((loopEnd - position - 0.01f) / voice.speed)));
+        position = kernel(data, position, voice.speed, gain + gainStep * done, gainStep, mix + done * 2, n);
+        done += n;
+        while (position >= loopEnd) position -= loopLength;
+    }
+    voice.positionFloat = position;
+}
+
+bool renderVoice(Voice& voice, int32_t* mix, int frames) {
+    if (!voice.sample) {
+        return false;
+    }
+    if (voice.restart && __atomic_exchange_n(&voice.restart, false, __ATOMIC_ACQUIRE)) {
+        startNote(voice, voiceInfo[&voice - voices].pending);
+    }
+
+    if (voice.startDelay) {
+        // Sequenced note on partway through the block: silent until its frame
+        mix += voice.startDelay * 2;
+        frames -= voice.startDelay;
+        voice.startDelay = 0;
+    }
 
-    // Advance position by speed (pitch shift)
-    voice.positionFloat += voice.speed;
+    // Envelope runs at block rate: one stage update per block, then a linear gain ramp
+    if (voice.noteOff) {
+        envelopeNoteOff(voice.env);
+    }
+    float startLevel = voice.env.value;
+    float endLevel = envelopeNextBlock(voice.env);
+    if (voice.shedding) endLevel = 0.0f;    // Faded out rather than cut, so it doesn't click
+
+    float velocityGain = voice.amplitude * sampleVolume;
+    float gain = startLevel * velocityGain;
+    float gainStep = (endLevel - startLevel) * velocityGain / frames;
+
+    // Work out up front how many frames remain so the inner loop needs no bounds check
+    const Sample* sample = voice.sample;
+    uint32_t length = sample->streamed ? sample->length : sample->mipLength[voice.mipLevel];
+    float remaining = (float)length - 2.0f - voice.positionFloat;
+    int available = remaining < 0.0f ? 0 : (int)(remaining / voice.speed) + 1;
+    int count = sample->looped ? frames : min(frames, available);
+
+    // Channel layout, interpolation and unity speed are settled once per block, not per frame
+    MixKernel kernel = selectMixKernel(sample->channels, voice.interp, voice.speed, voice.positionFloat);
+    if (sample->looped) {
+        mixLooped(voice, kernel, gain, gainStep, mix, count);
+    } else if (sample->streamed) {
+        mixStreamed(voice, kernel, gain, gainStep, mix, count);
+    } else {
+        voice.positionFloat = kernel(sample->mipData[voice.mipLevel], voice.positionFloat, voice.speed,
+                                     gain, gainStep, mix, count);
+    }
+
+    if ((count < frames || voice.env.stage == Envelope::IDLE || voice.shedding) && !voice.restart) {
+        // The caller clears the voice's bit after this, so a new note on can't race the stream stop
+        if (sample->streamed) stopVoiceStream(&voice - voices);
+        return false;
+    }
+    return true;
 }
 
-void audioTaskCode(void* parameter) {
+uint32_t mixVoiceBlock(Voice* pool, uint32_t mask, int32_t* mix, int frames) {
+    // Only playing voices are visited, lowest bit first
+    uint32_t finished = 0;
+    while (mask) {
+        int v = __builtin_ctz(mask);
+        mask &= mask - 1;
+        if (!renderVoice(pool[v], mix, frames)) finished |= 1u << v;
+    }
+    return finished;
+}
+
+// Frees finished voices. A note on that stole one of them after its last
+// block, but saw the bit still set, is started here instead of being lost.
+static void freeVoices(uint32_t finished) {
+    __atomic_fetch_and(&activeVoiceMask, ~finished, __ATOMIC_RELEASE);
+    for (; finished; finished &= finished - 1) {
+        int i = __builtin_ctz(finished);
+        if (voices[i].restart && __atomic_exchange_n(&voices[i].restart, false, __ATOMIC_ACQUIRE)) {
+            startNote(voices[i], voiceInfo[i].pending);
+            __atomic_fetch_or(&activeVoiceMask, 1u << i, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+// Cut up to `count` playing voices, quietest first; released voices go before
+// held ones, and held ones only when `releasedOnly` is false. Each fades out over
+// the coming envelope block. Returns the number cut.
+static int shedVoices(int count, bool releasedOnly) {
+    int cut = 0;
+    while (cut < count) {
+        int quietest = -1;
+        bool quietestReleased = false;
+        float quietestLevel = 0.0f;
+        for (uint32_t walk = getActiveVoices(); walk; walk &= walk - 1) {
+            int i = __builtin_ctz(walk);
+            const Voice& voice = voices[i];
+            if (voice.restart || voice.shedding) continue;   // About to start its next note, or already going
+            bool released = voice.noteOff || voiceInfo[i].sustained || voice.env.stage == Envelope::RELEASE;
+            if (releasedOnly && !released) continue;
+            float level = voice.env.value * voice.amplitude;
+            if (quietest < 0 || (released && !quietestReleased) ||
+                (released == quietestReleased && level < quietestLevel)) {
+                quietest = i;
+                quietestReleased = released;
+                quietestLevel = level;
+            }
+        }
+        if (quietest < 0) break;
+
+        // Rendered once more, fading to silence, and freed like a voice that finished
+        voices[quietest].shedding = true;
+        trace(TRACE_VOICE_SHED, quietest, !releasedOnly);
+        cut++;
+    }
+    voiceGovernor.shed += cut;
+    return cut;
+}
+
+// Bends and vibrato reach playing voices as a new stride once per block, only
+// for the channels whose pitch moved
+static void applyChannelPitch(uint16_t channels) {
+    for (uint32_t walk = getActiveVoices(); walk; walk &= walk - 1) {
+        int i = __builtin_ctz(walk);
+        uint8_t channel = voiceInfo[i].channel;
+        if (channels & (1u << channel)) {
+            voices[i].speed = voices[i].baseSpeed * channelControls[channel].pitch;
+        }
+    }
+}
+
+// Render buffers live outside the task stack
+static int32_t mixBuffer[DMA_BUF_LEN * 2];   // 32-bit mix bus, stereo interleaved
+static int16_t audioBuffer[DMA_BUF_LEN * 2]; // Stereo output for I2S
+static int16_t silentBuffer[DMA_BUF_LEN * 2]; // Written while nothing plays
+
+static_assert(DMA_BUF_LEN % ENV_BLOCK_SIZE == 0, "DMA_BUF_LEN must be a multiple of ENV_BLOCK_SIZE");
+static_assert(LIMITER_LOOKAHEAD_BLOCKS * LIMITER_BLOCK <= DMA_BUF_LEN, "One silent buffer must drain the limiter");
+
+// Offline renders park the audio task on silence so they own the voices
+static volatile bool holdRequested = false;
+static volatile bool audioHeld = false;
+
+struct BufferRender {
+    uint32_t voiceCycles;
+    uint32_t voiceBlocks;        // Voices mixed, summed over the envelope blocks
+    uint32_t limiterCycles;
+    int mp3Frames;
+    bool limited;
+};
+
+// One DMA buffer: song events, controllers, voices, stems, then the limiter into `out`.
+// With `live` the sequencer plays and voices are shed against the deadline counted
+// from `renderStart`. Offline renders do neither: their output never depends on
+// timing, and the sequencer's state stays with the audio task.
+static void renderBuffer(int16_t* out, uint32_t renderStart, bool live, BufferRender& result) {
     const int bufferSize = DMA_BUF_LEN;
-    int16_t audioBuffer[bufferSize * 2]; // Stereo
+
+    // Clear mix bus
+    memset(mixBuffer, 0, sizeof(mixBuffer));
+
+    // Mix polyphonic voices (samples/instruments) one envelope block at a time
+    result.voiceCycles = 0;
+    result.voiceBlocks = 0;
+    if (live) sequencerBeginBuffer();
+    for (int offset = 0; offset < bufferSize; offset += ENV_BLOCK_SIZE) {
+        // Live notes posted since the last block, then song events due in
+        // this block with note ons at their exact frame
+        takeNoteMessages(true);
+        if (live) sequencerRenderBlock(ENV_BLOCK_SIZE);
+
+        uint16_t pitchChanged = updateControllers();
+        if (pitchChanged) applyChannelPitch(pitchChanged);
+
+        // Released voices over a lowered budget go first, then anything that
+        // would push this buffer past its deadline
+        if (live) {
+            int playing = countActiveVoices();
+            if (playing > voiceGovernor.budget) {
+                playing -= shedVoices(playing - voiceGovernor.budget, true);
+            }
+            int overload = governorOverload(ESP.getCycleCount() - renderStart,
+                                            (bufferSize - offset) / ENV_BLOCK_SIZE, playing);
+            if (overload > 0) shedVoices(overload, false);
+        }
+
+        uint32_t mixStart = ESP.getCycleCount();
+        uint32_t mask = getActiveVoices();
+        uint32_t finished = mixVoiceBlock(voices, mask, mixBuffer + offset * 2, ENV_BLOCK_SIZE);
+        if (finished) freeVoices(finished);
+        result.voiceCycles += ESP.getCycleCount() - mixStart;
+        result.voiceBlocks += __builtin_popcount(mask);
+    }
+
+    // Mix MP3 backing track
+    result.mp3Frames = mixMP3Samples(mixBuffer, bufferSize);
+
+    // Lookahead limiter brings the 32-bit bus down to 16-bit output without clipping
+    uint32_t limiterStart = ESP.getCycleCount();
+    int32_t gainBefore = masterLimiter.gain;
+    limiterProcess(masterLimiter, mixBuffer, out, bufferSize);
+    result.limiterCycles = ESP.getCycleCount() - limiterStart;
+    result.limited = gainBefore < LIMITER_UNITY || masterLimiter.gain < LIMITER_UNITY;
+}
+
+void audioTaskCode(void* parameter) {
     size_t bytesWritten;
+    const uint32_t cpuMhz = ESP.getCpuFreqMHz();   // Restored before anything is rendered
+    perfStats.cpuMhz = cpuMhz;
+    bool drained = false;        // Last buffer mixed nothing, so the limiter's lookahead is silent too
+    bool throttled = false;
+    uint32_t lastSoundMs = millis();
 
     while (true) {
-        // Clear buffer
-        memset(audioBuffer, 0, sizeof(audioBuffer));
-
-        // Mix all active voices
-        for (int i = 0; i < bufferSize; i++) {
-            int16_t leftMix = 0, rightMix = 0;
-            
-            // Mix polyphonic voices (samples/instruments)
-            for (int v = 0; v < MAX_POLYPHONY; v++) {
-                if (voices[v].isActive) {
-                    processVoice(voices[v], leftMix, rightMix);
-                }
-            }
-            
-            // Mix MP3 backing track
-            int16_t mp3Left = 0, mp3Right = 0;
-            if (readMP3Samples(&mp3Left, &mp3Right)) {
-                leftMix += mp3Left;
-                rightMix += mp3Right;
+        if (holdRequested) {
+            audioHeld = true;
+            i2s_write(i2s_num, silentBuffer, sizeof(silentBuffer), &bytesWritten, portMAX_DELAY);
+            vTaskDelay(1);
+            continue;
+        }
+        audioHeld = false;
+
+        uint32_t renderStart = ESP.getCycleCount();
+
+        // Idle is checked once per buffer: with no voice, no stem, no song and
+        // nothing left in the limiter, silence goes out without touching a frame
+        if (drained && !getActiveVoices() && !mp3Streaming && !isSequencerPlaying() && !noteMessagesPending()) {
+            settleControllers();
+            if (!throttled && idleThrottle && IDLE_CPU_MHZ > 0 && IDLE_CPU_MHZ < cpuMhz &&
+                millis() - lastSoundMs >= IDLE_THROTTLE_MS) {
+                setCpuFrequencyMhz(IDLE_CPU_MHZ);
+                throttled = true;
+                trace(TRACE_CPU_CLOCK, 0, IDLE_CPU_MHZ);
             }
-            
-            // Prevent clipping with soft limiting
-            leftMix = constrain(leftMix, -32767, 32767);
-            rightMix = constrain(rightMix, -32767, 32767);
-            
-            audioBuffer[i * 2] = leftMix;
-            audioBuffer[i * 2 + 1] = rightMix;
+            perfStats.idleBlocks++;
+            if (throttled) perfStats.throttledBlocks++;
+            perfStats.busyNs += (uint64_t)(ESP.getCycleCount() - renderStart) * 1000 / ESP.getCpuFreqMHz();
+
+            i2s_write(i2s_num, silentBuffer, sizeof(silentBuffer), &bytesWritten, portMAX_DELAY);
+            vTaskDelay(1);
+            continue;
+        }
+        if (throttled) {
+            // A note or a stem has started: full clock before the first frame is mixed
+            setCpuFrequencyMhz(cpuMhz);
+            throttled = false;
+            trace(TRACE_CPU_CLOCK, 0, cpuMhz);
+            renderStart = ESP.getCycleCount();
+        }
+        trace(TRACE_BLOCK_START, 0, getActiveVoices());
+
+        BufferRender render;
+        renderBuffer(audioBuffer, renderStart, true, render);
+        uint32_t renderCycles = ESP.getCycleCount() - renderStart;
+
+        perfStats.blocks++;
+        perfStats.renderCyclesTotal += renderCycles;
+        perfStats.limiterCyclesTotal += render.limiterCycles;
+        if (renderCycles > perfStats.renderCyclesMax) perfStats.renderCyclesMax = renderCycles;
+        if (render.limiterCycles > perfStats.limiterCyclesMax) perfStats.limiterCyclesMax = render.limiterCycles;
+        if (render.limited) perfStats.limitedBlocks++;
+        perfStats.busyNs += (uint64_t)renderCycles * 1000 / cpuMhz;
+        governorUpdate(render.voiceCycles, render.voiceBlocks, renderCycles - render.voiceCycles);
+        trace(TRACE_BLOCK_END, render.voiceBlocks, renderCycles);
+
+        drained = render.voiceBlocks == 0 && render.mp3Frames == 0;
+        if (drained) {
+            limiterSettle(masterLimiter);
+        } else {
+            lastSoundMs = millis();
         }
 
         // Output to I2S
@@ -187,6 +753,54 @@ void audioTaskCode(void* parameter) {
     }
 }
 
+bool holdAudioTask(uint32_t timeoutMs) {
+    holdRequested = true;
+    if (!audioTask) return true;    // Nothing else renders
+    uint32_t started = millis();
+    while (!audioHeld) {
+        if (millis() - started > timeoutMs) {
+            holdRequested = false;
+            return false;
+        }
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+void releaseAudioTask() {
+    holdRequested = false;
+}
+
+void resetAudioState() {
+    takeNoteMessages(false);
+    uint32_t active = getActiveVoices();
+    while (active) {
+        int i = __builtin_ctz(active);
+        active &= active - 1;
+        if (voices[i].sample && voices[i].sample->streamed) stopVoiceStream(i);
+    }
+    activeVoiceMask = 0;
+    for (int i = 0; i < MAX_POLYPHONY; i++) {
+        voices[i].noteOff = false;
+        voices[i].restart = false;
+        voices[i].startDelay = 0;
+        voices[i].shedding = false;
+        voices[i].env.stage = Envelope::IDLE;
+        voices[i].env.value = 0.0f;
+        voiceInfo[i].sustained = false;
+        voiceInfo[i].startOrder = 0;
+    }
+    voiceCounter = 0;
+    limiterInit(masterLimiter, LIMITER_CEILING, LIMITER_RELEASE_MS);
+    initControllers();
+}
+
+uint32_t renderOffline(int16_t* out) {
+    BufferRender render;
+    renderBuffer(out, ESP.getCycleCount(), false, render);
+    return render.voiceBlocks;
+}
+
 void setSampleVolume(float volume) {
     sampleVolume = constrain(volume, 0.0f, 2.0f); // Allow boost up to 2x
     DEBUGF("Sample volume: %.1f\n", sampleVolume);
@@ -1,17 +1,61 @@
 #pragma once
 
 #include <Arduino.h>
+#include "../config.h"
 #include "../audio/voice.h"
 #include "../storage/sample.h"
+#include "limiter.h"
 
+// Voice pool split by access pattern: `voices` is what the renderer touches,
+// `voiceInfo` the note bookkeeping. Same index in both.
 extern Voice voices[];
+extern VoiceInfo voiceInfo[];
+extern uint32_t activeVoiceMask;   // Bit per playing voice, only changed with __atomic builtins
 extern TaskHandle_t audioTask;
+extern Limiter masterLimiter;
+extern uint32_t voiceSteals;
+extern volatile bool idleThrottle;  // Lower the CPU clock to IDLE_CPU_MHZ during long silences
+
+// Voice usage, for sizing polyphony (control side)
+struct VoiceUsageStats {
+    uint8_t peakVoices;             // Most voices playing at once
+    uint8_t peakPedalVoices;        // Most voices playing on channels with the pedal down
+    uint8_t peakSustained;          // Most voices kept only by the pedal (key already up)
+    uint32_t pedalSteals;           // Notes that had to steal a voice while a pedal was down
+};
+extern VoiceUsageStats voiceUsage;
+
+static_assert(MAX_POLYPHONY <= 32, "activeVoiceMask holds one bit per voice");
+
+inline uint32_t getActiveVoices() { return __atomic_load_n(&activeVoiceMask, __ATOMIC_ACQUIRE); }
+inline int countActiveVoices() { return __builtin_popcount(getActiveVoices()); }
+
+// Mixes `count` frames of a voice's sample into the stereo bus with a linear gain
+// ramp and returns the advanced position
+typedef float (*MixKernel)(const int16_t* data, float position, float speed, float gain, float gainStep,
+                           int32_t* mix, int count);
 
 void initVoices();
-Voice* getFreeVoice();
+int allocateVoice(uint8_t channel);     // A free voice, or one stolen fairly across channels (-1 if none)
 Sample* getSampleForNote(uint8_t midiNote);
-void noteOn(uint8_t midiNote, uint8_t velocity);
-void noteOff(uint8_t midiNote);
-void processVoice(Voice& voice, int16_t& leftOut, int16_t& rightOut);
+uint8_t selectMipLevel(const Sample* sample, float pitchRatio, float& stride);
+// Channels are 0-15. Callable from any task: other tasks' calls are queued,
+// lock-free, and take effect at the audio task's next envelope block. On the
+// audio task (the sequencer) they apply at once, and `startOffset` starts the
+// note that many frames into the block for sample-accurate timing.
+void noteOn(uint8_t channel, uint8_t midiNote, uint8_t velocity, uint8_t startOffset = 0);
+void noteOff(uint8_t channel, uint8_t midiNote);       // Held by the channel's sustain pedal if it is down
+void setSustain(uint8_t channel, bool down);           // CC64, lifting it releases the held notes
+void printVoiceUsage();
+MixKernel selectMixKernel(uint8_t channels, InterpMode mode, float speed, float position); // Specialised kernel for a block
+bool renderVoice(Voice& voice, int32_t* mix, int frames); // Adds one envelope block into the mix bus, false once finished
+uint32_t mixVoiceBlock(Voice* pool, uint32_t mask, int32_t* mix, int frames); // Renders the voices in `mask`, returns those that finished
 void audioTaskCode(void* parameter);
+
+// Offline rendering (render tests). Holding parks the audio task on silence so
+// the caller owns the voices; the stems and the sequencer must be stopped first.
+bool holdAudioTask(uint32_t timeoutMs);
+void releaseAudioTask();
+void resetAudioState();                 // Every voice off, limiter and controllers back to rest
+uint32_t renderOffline(int16_t* out);   // One DMA_BUF_LEN buffer like the audio task, without shedding or the sequencer; returns voices mixed
 void setSampleVolume(float volume);
\ No newline at end of file
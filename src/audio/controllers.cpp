@@ -0,0 +1,85 @@
+#include "controllers.h"
+#include <math.h>
+
+ChannelControls channelControls[MIDI_CHANNELS];
+
+static float smoothingCoef = 0.0f;
+static float vibratoStep = 0.0f;     // LFO phase advance per block
+static float vibratoPhase = 0.0f;
+
+void initControllers() {
+    float blockMs = 1000.0f * ENV_BLOCK_SIZE / SAMPLE_RATE;
+    smoothingCoef = 1.0f - expf(-blockMs / CONTROL_SMOOTHING_MS);
+    vibratoStep = 2.0f * PI * MOD_VIBRATO_HZ * ENV_BLOCK_SIZE / SAMPLE_RATE;
+    vibratoPhase = 0.0f;
+    for (int c = 0; c < MIDI_CHANNELS; c++) {
+        resetControllers(c);
+        channelControls[c].bend = 1.0f;
+        channelControls[c].mod = 0.0f;
+        channelControls[c].pitch = 1.0f;
+    }
+}
+
+void resetControllers(uint8_t channel) {
+    if (channel >= MIDI_CHANNELS) return;
+    channelControls[channel].sustain = false;
+    channelControls[channel].bendTarget = 1.0f;
+    channelControls[channel].modTarget = 0.0f;
+}
+
+void setPitchBend(uint8_t channel, int value) {
+    if (channel >= MIDI_CHANNELS) return;
+    value = constrain(value, -8192, 8191);
+    channelControls[channel].bendTarget = exp2f(PITCH_BEND_SEMITONES * value / (8192.0f * 12.0f));
+}
+
+void setModWheel(uint8_t channel, uint8_t value) {
+    if (channel >= MIDI_CHANNELS) return;
+    channelControls[channel].modTarget = min(value, (uint8_t)127) / 127.0f;
+}
+
+// One-pole step that lands exactly on the target, so a centred bend gives back unity speed
+static float smoothTowards(float value, float target) {
+    value += (target - value) * smoothingCoef;
+    return fabsf(target - value) < 1e-5f ? target : value;
+}
+
+uint16_t updateControllers() {
+    vibratoPhase += vibratoStep;
+    if (vibratoPhase >= 2.0f * PI) vibratoPhase -= 2.0f * PI;
+    float lfo = 0.0f;
+    bool lfoReady = false;
+
+    uint16_t changed = 0;
+    for (int c = 0; c < MIDI_CHANNELS; c++) {
+        ChannelControls& controls = channelControls[c];
+        float bendTarget = controls.bendTarget;
+        float modTarget = controls.modTarget;
+        if (controls.bend == bendTarget && controls.mod == 0.0f && modTarget == 0.0f) continue;
+
+        controls.bend = smoothTowards(controls.bend, bendTarget);
+        controls.mod = smoothTowards(controls.mod, modTarget);
+        float pitch = controls.bend;
+        if (controls.mod > 0.0f) {
+            if (!lfoReady) {
+                lfo = sinf(vibratoPhase);
+                lfoReady = true;
+            }
+            pitch *= exp2f(controls.mod * lfo * MOD_VIBRATO_CENTS / 1200.0f);
+        }
+        if (pitch != controls.pitch) {
+            controls.pitch = pitch;
+            changed |= 1u << c;
+        }
+    }
+    return changed;
+}
+
+void settleControllers() {
+    for (int c = 0; c < MIDI_CHANNELS; c++) {
+        ChannelControls& controls = channelControls[c];
+        controls.bend = controls.bendTarget;
+        controls.mod = controls.modTarget;
+        controls.pitch = controls.bend;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../config.h"
+
+static_assert(MIDI_CHANNELS <= 16, "updateControllers() reports channels in 16 bits");
+
+// Controller state per MIDI channel. The control side only posts the latest
+// value of each controller, so a flood of bend messages costs the audio task
+// nothing extra; the audio task ramps towards it once per envelope block.
+struct ChannelControls {
+    volatile bool sustain;          // CC64 down
+    volatile float bendTarget;      // Pitch ratio from the last bend message
+    volatile float modTarget;       // Mod wheel, 0-1
+    float bend;                     // Smoothed values, audio task only
+    float mod;
+    float pitch;                    // Ratio the channel's voices play at (bend and vibrato)
+};
+
+extern ChannelControls channelControls[MIDI_CHANNELS];
+
+void initControllers();
+void resetControllers(uint8_t channel);             // CC121: pedal up, bend centred, mod wheel off
+void setPitchBend(uint8_t channel, int value);      // -8192 to 8191
+void setModWheel(uint8_t channel, uint8_t value);   // CC1
+
+// Audio task, once per envelope block: advance every ramp and the vibrato, and
+// return a bit for each channel whose pitch changed
+uint16_t updateControllers();
+
+// Audio task while idle: jump every ramp to its target
+void settleControllers();
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "envelope.h"
+#include "../config.h"
+#include <math.h>
+
+// Exponential segments are considered finished once within -60 dB of their target
+#define ENV_EXP_FLOOR 0.001f
+
+uint32_t envelopeMsToBlocks(float ms) {
+    float blocks = ms * 0.001f * SAMPLE_RATE / ENV_BLOCK_SIZE;
+    // Always at least one block so a zero time still ramps instead of clicking
+    return blocks < 1.0f ? 1 : (uint32_t)(blocks + 0.5f);
+}
+
+static void enterStage(Envelope& env, Envelope::Stage stage, float target, uint32_t blocks) {
+    env.stage = stage;
+    env.target = target;
+    env.blocksLeft = blocks;
+
+    if (env.curve == ENV_CURVE_EXPONENTIAL) {
+        env.step = powf(ENV_EXP_FLOOR, 1.0f / blocks);
+    } else {
+        env.step = (target - env.value) / blocks;
+    }
+}
+
+void envelopeNoteOn(Envelope& env, const EnvelopeSettings& settings) {
+    env.curve = settings.curve;
+    env.value = 0.0f;
+    env.sustainLevel = constrain(settings.sustainLevel, 0.0f, 1.0f);
+    env.decayBlocks = envelopeMsToBlocks(settings.decayMs);
+    env.releaseBlocks = envelopeMsToBlocks(settings.releaseMs);
+    enterStage(env, Envelope::ATTACK, 1.0f, envelopeMsToBlocks(settings.attackMs));
+}
+
+void envelopeNoteOff(Envelope& env) {
+    if (env.stage >= Envelope::RELEASE) return;
+    enterStage(env, Envelope::RELEASE, 0.0f, env.releaseBlocks);
+}
+
+float envelopeNextBlock(Envelope& env) {
+    switch (env.stage) {
+        case Envelope::ATTACK:
+        case Envelope::DECAY:
+        case Envelope::RELEASE:
+            if (env.blocksLeft > 1) {
+                env.blocksLeft--;
+                if (env.curve == ENV_CURVE_EXPONENTIAL) {
+                    env.value = env.target + (env.value - env.target) * env.step;
+                } else {
+                    env.value += env.step;
+                }
+                break;
+            }
+
+            // Last block of the segment lands exactly on the target
+            env.value = env.target;
+            if (env.stage == Envelope::ATTACK) {
+                enterStage(env, Envelope::DECAY, env.sustainLevel, env.decayBlocks);
+            } else if (env.stage == Envelope::DECAY) {
+                env.stage = Envelope::SUSTAIN;
+            } else {
+                env.stage = Envelope::IDLE;
+            }
+            break;
+        case Envelope::SUSTAIN:
+            break;
+        case Envelope::IDLE:
+            env.value = 0.0f;
+            break;
+    }
+    return env.value;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Segment shape used by attack, decay and release
+enum EnvCurve : uint8_t {
+    ENV_CURVE_LINEAR,
+    ENV_CURVE_EXPONENTIAL
+};
+
+// Per-instrument envelope settings (times in milliseconds, independent of sample rate)
+struct EnvelopeSettings {
+    float attackMs;
+    float decayMs;
+    float sustainLevel;     // 0.0 - 1.0
+    float releaseMs;
+    EnvCurve curve;
+};
+
+// Envelope state, advanced once per ENV_BLOCK_SIZE frames
+struct Envelope {
+    enum Stage : uint8_t { ATTACK, DECAY, SUSTAIN, RELEASE, IDLE };
+    Stage stage;
+    EnvCurve curve;
+    float value;            // Level at the end of the last block
+    float target;           // Level the current stage is heading to
+    float step;             // Linear: increment per block, exponential: coefficient per block
+    uint32_t blocksLeft;    // Blocks remaining in the current stage
+    float sustainLevel;
+    uint32_t decayBlocks;
+    uint32_t releaseBlocks;
+};
+
+uint32_t envelopeMsToBlocks(float ms);
+void envelopeNoteOn(Envelope& env, const EnvelopeSettings& settings);
+void envelopeNoteOff(Envelope& env);
+float envelopeNextBlock(Envelope& env); // Returns the level at the end of the next block
\ No newline at end of file
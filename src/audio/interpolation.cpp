@@ -0,0 +1,65 @@
+#include "interpolation.h"
+#include "../debug.h"
+#include <math.h>
+
+float hermiteTable[INTERP_PHASES][HERMITE_TAPS];
+float sincTable[INTERP_PHASES][SINC_TAPS];
+
+volatile InterpMode interpOverride = INTERP_MODE_COUNT;
+
+// Sinc passband edge as a fraction of Nyquist - leaves room for the short window's transition band
+#define SINC_CUTOFF 0.9f
+
+static const char* interpNames[INTERP_MODE_COUNT] = { "none", "linear", "hermite", "sinc" };
+
+static float windowedSinc(float x) {
+    // Blackman window spanning the full SINC_TAPS width
+    const float halfWidth = SINC_TAPS / 2.0f;
+    if (fabsf(x) >= halfWidth) return 0.0f;
+
+    float w = 0.42f + 0.5f * cosf(PI * x / halfWidth) + 0.08f * cosf(2.0f * PI * x / halfWidth);
+    float arg = PI * SINC_CUTOFF * x;
+    float sinc = (fabsf(arg) < 1e-6f) ? 1.0f : sinf(arg) / arg;
+    return SINC_CUTOFF * sinc * w;
+}
+
+void initInterpolation() {
+    for (int p = 0; p < INTERP_PHASES; p++) {
+        float t = (float)p / INTERP_PHASES;
+        float t2 = t * t;
+        float t3 = t2 * t;
+
+        // Catmull-Rom weights for samples at -1, 0, +1, +2
+        hermiteTable[p][0] = -0.5f * t3 + t2 - 0.5f * t;
+        hermiteTable[p][1] = 1.5f * t3 - 2.5f * t2 + 1.0f;
+        hermiteTable[p][2] = -1.5f * t3 + 2.0f * t2 + 0.5f * t;
+        hermiteTable[p][3] = 0.5f * t3 - 0.5f * t2;
+
+        // Sinc weights for samples at -3 .. +4, normalised for unity DC gain
+        float sum = 0.0f;
+        for (int k = 0; k < SINC_TAPS; k++) {
+            sincTable[p][k] = windowedSinc((float)(k - 3) - t);
+            sum += sincTable[p][k];
+        }
+        for (int k = 0; k < SINC_TAPS; k++) {
+            sincTable[p][k] /= sum;
+        }
+    }
+
+    DEBUGF("Interpolation tables ready (%d phases, %d bytes)\n",
+           INTERP_PHASES, (int)(sizeof(hermiteTable) + sizeof(sincTable)));
+}
+
+const char* interpModeName(InterpMode mode) {
+    return mode < INTERP_MODE_COUNT ? interpNames[mode] : "instrument";
+}
+
+bool parseInterpMode(const char* name, InterpMode& mode) {
+    for (int i = 0; i < INTERP_MODE_COUNT; i++) {
+        if (strcmp(name, interpNames[i]) == 0) {
+            mode = (InterpMode)i;
+            return true;
+        }
+    }
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Sample interpolation quality, selectable per instrument or engine-wide
+enum InterpMode : uint8_t {
+    INTERP_NONE,        // Nearest sample - exact only at unity speed
+    INTERP_LINEAR,      // 2-point linear
+    INTERP_HERMITE,     // 4-point Hermite (Catmull-Rom), taps -1..+2
+    INTERP_SINC,        // 8-tap windowed sinc, taps -3..+4
+    INTERP_MODE_COUNT
+};
+
+#define INTERP_PHASES   256     // Fractional positions per coefficient table
+#define HERMITE_TAPS    4
+#define SINC_TAPS       8
+
+// Precomputed kernels, indexed by fractional phase
+extern float hermiteTable[INTERP_PHASES][HERMITE_TAPS];
+extern float sincTable[INTERP_PHASES][SINC_TAPS];
+
+// Engine-wide override, INTERP_MODE_COUNT means "use each instrument's own mode"
+extern volatile InterpMode interpOverride;
+
+void initInterpolation();
+const char* interpModeName(InterpMode mode);
+bool parseInterpMode(const char* name, InterpMode& mode);
\ No newline at end of file
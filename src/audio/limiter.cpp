@@ -0,0 +1,79 @@
+#include "limiter.h"
+#include <math.h>
+
+void limiterInit(Limiter& limiter, int32_t ceiling, float releaseMs) {
+    memset(limiter.delay, 0, sizeof(limiter.delay));
+    for (int i = 0; i < LIMITER_LOOKAHEAD_BLOCKS; i++) {
+        limiter.targetGain[i] = LIMITER_UNITY;
+    }
+    limiter.head = 0;
+    limiter.gain = LIMITER_UNITY;
+    limiter.ceiling = ceiling;
+    limiter.minGain = LIMITER_UNITY;
+
+    float blockMs = 1000.0f * LIMITER_BLOCK / SAMPLE_RATE;
+    limiter.releaseCoef = (int32_t)(LIMITER_UNITY * (1.0f - expf(-blockMs / releaseMs)));
+    if (limiter.releaseCoef < 1) limiter.releaseCoef = 1;
+}
+
+// Process one LIMITER_BLOCK: queue `in`, emit the block that entered LOOKAHEAD blocks ago
+static void limiterProcessBlock(Limiter& limiter, const int32_t* in, int16_t* out) {
+    // Stereo-linked peak of the incoming block and the gain it will need
+    int32_t peak = 0;
+    for (int i = 0; i < LIMITER_BLOCK * 2; i++) {
+        int32_t magnitude = in[i] < 0 ? -in[i] : in[i];
+        if (magnitude > peak) peak = magnitude;
+    }
+    int32_t needed = LIMITER_UNITY;
+    if (peak > limiter.ceiling) {
+        needed = (int32_t)(((int64_t)limiter.ceiling << 15) / peak);
+    }
+
+    // Slot `head` holds the oldest block: it is output now and then reused for `in`.
+    // The gain must already suit every block from it up to the one just arriving.
+    int32_t* slot = limiter.delay + limiter.head * LIMITER_BLOCK * 2;
+    int32_t windowMin = needed;
+    for (int i = 0; i < LIMITER_LOOKAHEAD_BLOCKS; i++) {
+        if (limiter.targetGain[i] < windowMin) windowMin = limiter.targetGain[i];
+    }
+
+    // Gain at the end of this block: never above what any queued block needs,
+    // otherwise recover exponentially towards unity
+    int32_t endGain = limiter.gain + (int32_t)(((int64_t)(LIMITER_UNITY - limiter.gain) * limiter.releaseCoef) >> 15);
+    if (endGain > windowMin) endGain = windowMin;
+
+    // Ramp between two gains that are both low enough for this block, so every frame is too
+    int32_t gain = limiter.gain;
+    int32_t step = (endGain - gain) / LIMITER_BLOCK;
+    for (int i = 0; i < LIMITER_BLOCK; i++) {
+        int32_t left = (int32_t)(((int64_t)slot[i * 2] * gain) >> 15);
+        int32_t right = (int32_t)(((int64_t)slot[i * 2 + 1] * gain) >> 15);
+        out[i * 2] = (int16_t)constrain(left, -32767, 32767);
+        out[i * 2 + 1] = (int16_t)constrain(right, -32767, 32767);
+        gain += step;
+    }
+    limiter.gain = endGain;
+    if (endGain < limiter.minGain) limiter.minGain = endGain;
+
+    memcpy(slot, in, LIMITER_BLOCK * 2 * sizeof(int32_t));
+
+    // Queued gains are kept oldest first, in the same order as the delay slots
+    for (int i = 0; i < LIMITER_LOOKAHEAD_BLOCKS - 1; i++) {
+        limiter.targetGain[i] = limiter.targetGain[i + 1];
+    }
+    limiter.targetGain[LIMITER_LOOKAHEAD_BLOCKS - 1] = needed;
+    limiter.head = (limiter.head + 1) % LIMITER_LOOKAHEAD_BLOCKS;
+}
+
+void limiterProcess(Limiter& limiter, const int32_t* in, int16_t* out, int frames) {
+    for (int offset = 0; offset < frames; offset += LIMITER_BLOCK) {
+        limiterProcessBlock(limiter, in + offset * 2, out + offset * 2);
+    }
+}
+
+void limiterSettle(Limiter& limiter) {
+    for (int i = 0; i < LIMITER_LOOKAHEAD_BLOCKS; i++) {
+        limiter.targetGain[i] = LIMITER_UNITY;
+    }
+    limiter.gain = LIMITER_UNITY;
+}
\ No newline at end of file
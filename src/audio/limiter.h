@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../config.h"
+
+#define LIMITER_BLOCK       ENV_BLOCK_SIZE      // Frames per gain step
+#define LIMITER_UNITY       32768               // Q15 gain of 1.0
+
+// Stereo-linked peak limiter on the 32-bit mix bus. Incoming audio is delayed by
+// LIMITER_LOOKAHEAD_BLOCKS so gain reduction is already in place when a peak leaves.
+struct Limiter {
+    int32_t delay[LIMITER_LOOKAHEAD_BLOCKS * LIMITER_BLOCK * 2];
+    int32_t targetGain[LIMITER_LOOKAHEAD_BLOCKS];      // Q15 gain each queued block needs, oldest first
+    uint8_t head;                                       // Oldest queued block
+    int32_t gain;                                       // Q15 gain at the end of the last block
+    int32_t ceiling;                                    // Output peak limit
+    int32_t releaseCoef;                                // Q15 fraction of the way back to unity per block
+    int32_t minGain;                                    // Lowest gain since the last reset (for stats)
+};
+
+void limiterInit(Limiter& limiter, int32_t ceiling, float releaseMs);
+void limiterProcess(Limiter& limiter, const int32_t* in, int16_t* out, int frames);
+void limiterSettle(Limiter& limiter);   // Once the lookahead holds only silence: finish the release at once
\ No newline at end of file
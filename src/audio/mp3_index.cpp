@@ -0,0 +1,393 @@
+#include "mp3_index.h"
+#include "../config.h"
+#include "../debug.h"
+#include "SD_MMC.h"
+
+#define MP3_INDEX_MAGIC     0x4933504D  // "MP3I"
+#define MP3_INDEX_VERSION   2
+#define MP3_SCAN_WINDOW     16384
+#define MP3_RESYNC_LIMIT    65536       // Give up if no frame is found within this many bytes
+#define MP3_INFO_WINDOW     2048        // Holds the largest frame, for reading the stream info
+
+struct MP3IndexFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t fileSize;
+    uint32_t modified;
+    uint32_t numFrames;
+    uint32_t sampleRate;
+    uint16_t samplesPerFrame;
+    uint16_t encoderDelay;
+    uint16_t encoderPadding;
+    uint8_t channels;
+    uint8_t reserved;
+};
+
+static const uint16_t bitratesMPEG1[16] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 };
+static const uint16_t bitratesMPEG2[16] = { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 };
+static const uint32_t sampleRatesMPEG1[3] = { 44100, 48000, 32000 };
+
+bool parseMP3FrameHeader(const uint8_t* h, MP3FrameHeader& out) {
+    // 11 sync bits, Layer III only
+    if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) return false;
+    uint8_t version = (h[1] >> 3) & 0x03;      // 3 = MPEG-1, 2 = MPEG-2, 0 = MPEG-2.5
+    uint8_t layer = (h[1] >> 1) & 0x03;        // 1 = Layer III
+    uint8_t bitrateIndex = h[2] >> 4;
+    uint8_t rateIndex = (h[2] >> 2) & 0x03;
+    uint8_t padding = (h[2] >> 1) & 0x01;
+    if (version == 1 || layer != 1 || rateIndex == 3) return false;
+    if (bitrateIndex == 0 || bitrateIndex == 15) return false;  // Free format isn't indexable
+
+    bool mpeg1 = (version == 3);
+    uint32_t bitrate = (mpeg1 ? bitratesMPEG1 : bitratesMPEG2)[bitrateIndex] * 1000;
+    uint32_t sampleRate = sampleRatesMPEG1[rateIndex];
+    if (version == 2) sampleRate /= 2;
+    if (version == 0) sampleRate /= 4;
+
+    out.sampleRate = sampleRate;
+    out.channels = ((h[3] >> 6) == 3) ? 1 : 2;
+    out.samplesPerFrame = mpeg1 ? 1152 : 576;
+    out.frameBytes = (mpeg1 ? 144 : 72) * bitrate / sampleRate + padding;
+    out.sideInfoBytes = mpeg1 ? (out.channels == 1 ? 17 : 32) : (out.channels == 1 ? 9 : 17);
+    return true;
+}
+
+// Sequential read window over the file so scanning costs one SD read per 16 KB
+struct ScanReader {
+    File* file;
+    uint8_t* buffer;
+    uint32_t start;     // File offset of buffer[0]
+    uint32_t length;    // Valid bytes in buffer
+    uint32_t fileSize;
+};
+
+// Make [pos, pos + count) available, returns a pointer or nullptr past the end of file
+static const uint8_t* scanAt(ScanReader& reader, uint32_t pos, uint32_t count) {
+    if (pos + count > reader.fileSize) return nullptr;
+    if (pos < reader.start || pos + count > reader.start + reader.length) {
+        reader.file->seek(pos);
+        reader.start = pos;
+        reader.length = reader.file->read(reader.buffer, MP3_SCAN_WINDOW);
+        if (count > reader.length) return nullptr;
+    }
+    return reader.buffer + (pos - reader.start);
+}
+
+// Find a frame header at or after `pos` that is followed by another valid header
+static bool findFrame(ScanReader& reader, uint32_t& pos, MP3FrameHeader& header) {
+    uint32_t limit = pos + MP3_RESYNC_LIMIT;
+    for (; pos < limit; pos++) {
+        const uint8_t* h = scanAt(reader, pos, 4);
+        if (!h) return false;
+        if (!parseMP3FrameHeader(h, header)) continue;
+
+        MP3FrameHeader next;
+        const uint8_t* n = scanAt(reader, pos + header.frameBytes, 4);
+        if (!n) return true;    // Last frame in the file
+        if (parseMP3FrameHeader(n, next) && next.sampleRate == header.sampleRate) return true;
+    }
+    return false;
+}
+
+static uint32_t readBE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t readBE16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+uint32_t getID3v2Size(const uint8_t* h) {
+    if (memcmp(h, "ID3", 3) != 0) return 0;
+    if ((h[6] | h[7] | h[8] | h[9]) & 0x80) return 0;   // Size bytes are syncsafe
+    uint32_t size = ((uint32_t)h[6] << 21) | ((uint32_t)h[7] << 14) | ((uint32_t)h[8] << 7) | h[9];
+    bool footer = h[5] & 0x10;
+    return 10 + size + (footer ? 10 : 0);
+}
+
+// Offset of the first byte after any ID3v2 tags, without reading their contents
+static uint32_t skipID3v2Tags(File& file) {
+    uint32_t pos = 0;
+    uint8_t header[10];
+    while (file.seek(pos) && file.read(header, sizeof(header)) == sizeof(header)) {
+        uint32_t size = getID3v2Size(header);
+        if (size == 0) break;
+        pos += size;
+    }
+    return pos;
+}
+
+// Xing/Info frames carry no audio; LAME appends encoder delay and padding after them
+static bool parseXingFrame(const uint8_t* frame, const MP3FrameHeader& header, MP3StreamInfo& info) {
+    const uint8_t* xing = frame + 4 + header.sideInfoBytes;
+    const uint8_t* end = frame + header.frameBytes;
+    if (xing + 8 > end) return false;
+    if (memcmp(xing, "Xing", 4) != 0 && memcmp(xing, "Info", 4) != 0) return false;
+
+    uint32_t flags = readBE32(xing + 4);
+    const uint8_t* p = xing + 8;
+    if ((flags & 0x01) && p + 4 <= end) {
+        info.numFrames = readBE32(p);
+        p += 4;
+    }
+    if ((flags & 0x02) && p + 4 <= end) {
+        info.audioBytes = readBE32(p);
+        p += 4;
+    }
+    if ((flags & 0x04) && p + 100 <= end) {
+        memcpy(info.toc, p, 100);
+        info.hasToc = true;
+        p += 100;
+    }
+    if (flags & 0x08) p += 4;   // Quality
+    info.header = 'X';
+
+    // LAME tag: 9 byte version string, then delay/padding 21 bytes in, 12 bits each
+    if (p + 24 <= end && memcmp(p, "LAME", 4) == 0) {
+        info.encoderDelay = (p[21] << 4) | (p[22] >> 4);
+        info.encoderPadding = ((p[22] & 0x0F) << 8) | p[23];
+    }
+    return true;
+}
+
+// Fraunhofer VBRI header, 32 bytes after the frame header, with a seek table
+// of per-entry byte counts that is resampled onto the Xing percent TOC
+static bool parseVBRIFrame(const uint8_t* frame, const MP3FrameHeader& header, MP3StreamInfo& info) {
+    const uint8_t* vbri = frame + 36;
+    const uint8_t* end = frame + header.frameBytes;
+    if (vbri + 26 > end || memcmp(vbri, "VBRI", 4) != 0) return false;
+
+    info.header = 'V';
+    info.audioBytes = readBE32(vbri + 10);
+    info.numFrames = readBE32(vbri + 14);
+    uint16_t entries = readBE16(vbri + 18);
+    uint16_t scale = readBE16(vbri + 20);
+    uint16_t entryBytes = readBE16(vbri + 22);
+    uint16_t framesPerEntry = readBE16(vbri + 24);
+    const uint8_t* table = vbri + 26;
+    if (entries == 0 || entryBytes == 0 || entryBytes > 4 || framesPerEntry == 0) return true;
+    if (table + entries * entryBytes > end || info.audioBytes == 0 || info.numFrames == 0) return true;
+
+    uint32_t bytes = 0;
+    int entry = 0;
+    for (int percent = 0; percent < 100; percent++) {
+        uint32_t target = (uint64_t)info.numFrames * percent / 100;
+        while (entry < entries && (uint32_t)(entry + 1) * framesPerEntry <= target) {
+            uint32_t size = 0;
+            for (int b = 0; b < entryBytes; b++) size = (size << 8) | table[entry * entryBytes + b];
+            bytes += size * scale;
+            entry++;
+        }
+        info.toc[percent] = (uint8_t)min((uint64_t)255, (uint64_t)bytes * 256 / info.audioBytes);
+    }
+    info.hasToc = true;
+    return true;
+}
+
+bool readMP3StreamInfo(File& file, MP3StreamInfo& info) {
+    memset(&info, 0, sizeof(info));
+    uint32_t fileSize = file.size();
+    info.tagBytes = skipID3v2Tags(file);
+
+    uint8_t* window = (uint8_t*)malloc(MP3_INFO_WINDOW);
+    if (!window) return false;
+
+    // The first frame normally starts right after the tags; allow a little padding
+    file.seek(info.tagBytes);
+    size_t length = file.read(window, MP3_INFO_WINDOW);
+    MP3FrameHeader header;
+    size_t pos = 0;
+    bool found = false;
+    for (; pos + 4 <= length && !found; pos++) {
+        if (!parseMP3FrameHeader(window + pos, header)) continue;
+        MP3FrameHeader next;
+        size_t nextPos = pos + header.frameBytes;
+        found = nextPos + 4 > length ||
+                (parseMP3FrameHeader(window + nextPos, next) && next.sampleRate == header.sampleRate);
+        if (found) break;
+    }
+    if (!found) {
+        free(window);
+        return false;
+    }
+
+    // Re-read from the frame so all of it is in the window
+    info.audioStart = info.tagBytes + pos;
+    file.seek(info.audioStart);
+    length = file.read(window, MP3_INFO_WINDOW);
+
+    info.firstFrame = info.audioStart;
+    info.sampleRate = header.sampleRate;
+    info.samplesPerFrame = header.samplesPerFrame;
+    info.channels = header.channels;
+    if (header.frameBytes <= length &&
+        (parseXingFrame(window, header, info) || parseVBRIFrame(window, header, info))) {
+        info.firstFrame += header.frameBytes;
+    }
+    if (info.audioBytes == 0 || info.audioStart + info.audioBytes > fileSize) {
+        info.audioBytes = fileSize - info.audioStart;
+    }
+    free(window);
+    return true;
+}
+
+static String indexPathFor(const char* path) {
+    return String(path) + ".idx";
+}
+
+bool buildMP3Index(const char* path, File& file, MP3FrameIndex& index) {
+    uint32_t started = millis();
+    memset(&index, 0, sizeof(index));
+    index.fileSize = file.size();
+    index.modified = (uint32_t)file.getLastWrite();
+
+    ScanReader reader;
+    reader.file = &file;
+    reader.buffer = (uint8_t*)malloc(MP3_SCAN_WINDOW);
+    reader.start = 0;
+    reader.length = 0;
+    reader.fileSize = index.fileSize;
+    if (!reader.buffer) {
+        DEBUG("Failed to allocate MP3 scan buffer");
+        return false;
+    }
+
+    // Generous estimate (smallest MPEG-1 frame is 104 bytes), trimmed when done
+    uint32_t capacity = index.fileSize / 96 + 16;
+    index.offsets = (uint32_t*)ps_malloc(capacity * sizeof(uint32_t));
+    if (!index.offsets) {
+        DEBUG("Failed to allocate MP3 frame index");
+        free(reader.buffer);
+        return false;
+    }
+
+    // Tags can hold large pictures, so jump over them instead of scanning
+    MP3FrameHeader header;
+    uint32_t pos = skipID3v2Tags(file);
+    if (!findFrame(reader, pos, header)) {
+        DEBUG("No MP3 frames found while indexing");
+        free(reader.buffer);
+        freeMP3Index(index);
+        return false;
+    }
+    index.sampleRate = header.sampleRate;
+    index.samplesPerFrame = header.samplesPerFrame;
+    index.channels = header.channels;
+
+    // Skip the Xing/Info or VBRI frame if present, keeping its gapless information
+    MP3StreamInfo info;
+    memset(&info, 0, sizeof(info));
+    const uint8_t* first = scanAt(reader, pos, header.frameBytes);
+    if (first && (parseXingFrame(first, header, info) || parseVBRIFrame(first, header, info))) {
+        index.encoderDelay = info.encoderDelay;
+        index.encoderPadding = info.encoderPadding;
+        pos += header.frameBytes;
+    }
+
+    while (index.numFrames < capacity) {
+        const uint8_t* h = scanAt(reader, pos, 4);
+        if (!h) break;
+        if (!parseMP3FrameHeader(h, header) || header.sampleRate != index.sampleRate) {
+            // Garbage or a trailing tag: resync, or stop at the end of the audio
+            if (!findFrame(reader, pos, header) || header.sampleRate != index.sampleRate) break;
+        }
+        index.offsets[index.numFrames++] = pos;
+        pos += header.frameBytes;
+    }
+    free(reader.buffer);
+
+    if (index.numFrames == 0) {
+        freeMP3Index(index);
+        return false;
+    }
+    uint32_t* trimmed = (uint32_t*)ps_realloc(index.offsets, index.numFrames * sizeof(uint32_t));
+    if (trimmed) index.offsets = trimmed;
+
+    DEBUGF("Indexed %lu frames of %s in %lu ms (delay %d, padding %d)\n",
+           (unsigned long)index.numFrames, path, (unsigned long)(millis() - started),
+           index.encoderDelay, index.encoderPadding);
+
+    // Cache next to the MP3 so later opens are instant
+    String cachePath = indexPathFor(path);
+    File cache = SD_MMC.open(cachePath.c_str(), FILE_WRITE);
+    if (cache) {
+        MP3IndexFileHeader fileHeader = {
+            MP3_INDEX_MAGIC, MP3_INDEX_VERSION, index.fileSize, index.modified, index.numFrames,
+            index.sampleRate, index.samplesPerFrame, index.encoderDelay, index.encoderPadding,
+            index.channels, 0
+        };
+        cache.write((const uint8_t*)&fileHeader, sizeof(fileHeader));
+        cache.write((const uint8_t*)index.offsets, index.numFrames * sizeof(uint32_t));
+        cache.close();
+    } else {
+        DEBUGF("Could not write MP3 index cache %s\n", cachePath.c_str());
+    }
+    return true;
+}
+
+bool loadMP3Index(const char* path, File& file, MP3FrameIndex& index) {
+    return loadCachedMP3Index(path, file, index) || buildMP3Index(path, file, index);
+}
+
+bool loadCachedMP3Index(const char* path, File& file, MP3FrameIndex& index) {
+    String cachePath = indexPathFor(path);
+    File cache = SD_MMC.open(cachePath.c_str());
+    if (cache) {
+        MP3IndexFileHeader fileHeader;
+        bool valid = cache.read((uint8_t*)&fileHeader, sizeof(fileHeader)) == sizeof(fileHeader)
+                     && fileHeader.magic == MP3_INDEX_MAGIC
+                     && fileHeader.version == MP3_INDEX_VERSION
+                     && fileHeader.fileSize == file.size()
+                     && fileHeader.modified == (uint32_t)file.getLastWrite();
+
+        if (valid) {
+            memset(&index, 0, sizeof(index));
+            index.offsets = (uint32_t*)ps_malloc(fileHeader.numFrames * sizeof(uint32_t));
+            size_t bytes = fileHeader.numFrames * sizeof(uint32_t);
+            if (index.offsets && cache.read((uint8_t*)index.offsets, bytes) == bytes) {
+                index.numFrames = fileHeader.numFrames;
+                index.sampleRate = fileHeader.sampleRate;
+                index.samplesPerFrame = fileHeader.samplesPerFrame;
+                index.channels = fileHeader.channels;
+                index.encoderDelay = fileHeader.encoderDelay;
+                index.encoderPadding = fileHeader.encoderPadding;
+                index.fileSize = fileHeader.fileSize;
+                index.modified = fileHeader.modified;
+                cache.close();
+                return true;
+            }
+            freeMP3Index(index);
+        }
+        cache.close();
+        DEBUGF("MP3 index cache for %s is stale\n", path);
+    }
+    return false;
+}
+
+void freeMP3Index(MP3FrameIndex& index) {
+    if (index.offsets) {
+        free(index.offsets);
+        index.offsets = nullptr;
+    }
+    index.numFrames = 0;
+}
+
+uint32_t getMP3FirstSample(const MP3FrameIndex& index) {
+    return index.encoderDelay + MP3_DECODER_DELAY;
+}
+
+uint32_t getMP3EndSample(const MP3FrameIndex& index) {
+    uint32_t total = index.numFrames * index.samplesPerFrame;
+    uint32_t end = total + MP3_DECODER_DELAY - index.encoderPadding;
+    return min(end, total);
+}
+
+void copyMP3StreamInfo(const MP3StreamInfo& info, MP3FrameIndex& index) {
+    memset(&index, 0, sizeof(index));
+    index.numFrames = info.numFrames;
+    index.sampleRate = info.sampleRate;
+    index.samplesPerFrame = info.samplesPerFrame;
+    index.channels = info.channels;
+    index.encoderDelay = info.encoderDelay;
+    index.encoderPadding = info.encoderPadding;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+#include "FS.h"
+
+// MPEG-1/2/2.5 Layer III frame header fields needed for indexing
+struct MP3FrameHeader {
+    uint32_t sampleRate;
+    uint16_t samplesPerFrame;   // 1152 for MPEG-1, 576 for MPEG-2/2.5
+    uint16_t frameBytes;        // Whole frame including the header
+    uint16_t sideInfoBytes;
+    uint8_t channels;
+};
+
+// Byte offset of every audio frame plus the LAME gapless information.
+// Built once per file by scanning headers, then cached on SD next to the MP3.
+struct MP3FrameIndex {
+    uint32_t* offsets;          // File offset of each audio frame (PSRAM)
+    uint32_t numFrames;
+    uint32_t sampleRate;
+    uint16_t samplesPerFrame;
+    uint8_t channels;
+    uint16_t encoderDelay;      // Samples of encoder priming (LAME tag)
+    uint16_t encoderPadding;    // Samples of padding after the last real sample
+    uint32_t fileSize;          // Cache key
+    uint32_t modified;          // Cache key (last write time)
+};
+
+// What the tags and the first frame say about a stream, read in constant time on open
+struct MP3StreamInfo {
+    uint32_t tagBytes;          // ID3v2 tags before the first frame
+    uint32_t audioStart;        // First frame, which may be the Xing/VBRI frame
+    uint32_t firstFrame;        // First audio frame
+    uint32_t audioBytes;        // From audioStart to the end of the audio
+    uint32_t numFrames;         // Audio frames, 0 when there is no Xing/VBRI header
+    uint32_t sampleRate;
+    uint16_t samplesPerFrame;
+    uint8_t channels;
+    char header;                // 'X' (Xing/Info), 'V' (VBRI) or 0
+    uint16_t encoderDelay;      // LAME tag, 0 when absent
+    uint16_t encoderPadding;
+    bool hasToc;
+    uint8_t toc[100];           // Byte position at each percent of the duration, in 1/256ths of audioBytes
+};
+
+// Decoder delay of the MP3 synthesis filterbank, added to the encoder delay
+#define MP3_DECODER_DELAY 529
+
+bool parseMP3FrameHeader(const uint8_t* header, MP3FrameHeader& out);
+uint32_t getID3v2Size(const uint8_t* header);   // Whole tag size from its 10 byte header, 0 if not a tag
+bool readMP3StreamInfo(File& file, MP3StreamInfo& info);
+
+// Load the cached index for `path`, or scan the file and write the cache
+bool loadMP3Index(const char* path, File& file, MP3FrameIndex& index);
+bool loadCachedMP3Index(const char* path, File& file, MP3FrameIndex& index);  // Never scans
+bool buildMP3Index(const char* path, File& file, MP3FrameIndex& index);
+void freeMP3Index(MP3FrameIndex& index);
+
+// First and one-past-last playable sample (per channel, at the file's rate)
+uint32_t getMP3FirstSample(const MP3FrameIndex& index);
+uint32_t getMP3EndSample(const MP3FrameIndex& index);
+void copyMP3StreamInfo(const MP3StreamInfo& info, MP3FrameIndex& index);  // Timing only, no offsets
\ No newline at end of file
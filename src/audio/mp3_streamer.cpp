@@ -1,118 +1,432 @@
 #include "mp3_streamer.h"
 #include "../config.h"
 #include "../debug.h"
-#include "FS.h"
+#include "pcm_cache.h"
+#include "../utils/trace.h"
 #include "SD_MMC.h"
 
 extern "C" {
 #include "libhelix-mp3/mp3dec.h"
 }
 
+// Largest decoded MP3 frame: 1152 samples per channel, stereo
+#define MP3_MAX_FRAME_SAMPLES 2304
+
+// Largest frame after conversion to SAMPLE_RATE stereo
+#define MP3_MAX_OUTPUT_SAMPLES (RESAMPLER_MAX_OUTPUT_FRAMES * 2)
+
+// Largest Layer III frame (320 kbps at 32 kHz with padding)
+#define MP3_MAX_FRAME_BYTES 1441
+
+// Window the decoder works from, topped up from the compressed read-ahead
+#define MP3_DECODE_BUF_BYTES 4096
+#define MP3_INPUT_BYTES (MP3_IO_CHUNK_BYTES * MP3_IO_CHUNKS)
+
+// Frames decoded ahead of a seek or loop target so the bit reservoir and
+// filterbank overlap are primed; their output is discarded
+#define MP3_PREROLL_FRAMES 2
+
+// Shortest A/B loop, which also bounds how many position marks the ring can hold
+#define MP3_MIN_LOOP_SECONDS 0.25f
+
+// Assumed decode cost of a stem before any has been measured (fraction of a core)
+#define MP3_STEM_LOAD_ESTIMATE 0.10f
+
 // Global variables
-MP3StreamBuffer mp3Buffer;
+MP3Player mp3Players[MP3_MAX_STREAMS];
+MP3SchedulerStats mp3SchedStats;
 volatile bool mp3Streaming = false;
 volatile float mp3Volume = 0.5f;
-TaskHandle_t mp3StreamTask = NULL;
+TaskHandle_t mp3DecodeTask = NULL;
+TaskHandle_t mp3IOTask = NULL;
+
+// Decoder sleeps on a task notification while every ring is above the low-water mark
+static volatile bool mp3DecoderWaiting = false;
+static size_t mp3LowWater = 0;
+static size_t mp3PrimeSamples = 0;
 
-// Stream control
-String currentMP3File;
-File mp3File;
-HMP3Decoder mp3Decoder = NULL;
+// Playback holds until every stem has buffered MP3_PRIME_MS, so stems that start
+// or seek together are heard together
+static volatile bool mp3Primed = false;
+
+// Group requests from the command side, picked up by the decode task between frames
+static volatile float mp3SeekRequest = -1.0f;
+static volatile bool mp3LoopEnabled = false;
 
 bool initMP3Streamer() {
     DEBUG("Initializing MP3 streamer...");
     
-    // Initialize variables first
-    mp3Buffer.buffer = NULL;
-    mp3Buffer.mutex = NULL;
-    mp3Buffer.writePos = 0;
-    mp3Buffer.readPos = 0;
-    mp3Buffer.hasData = false;
-    
-    // Allocate circular buffer (4 seconds of 44.1kHz stereo audio)
-    const size_t bufferSamples = 44100 * 2 * 4; // 4 seconds, stereo
-    mp3Buffer.buffer = (int16_t*)ps_malloc(bufferSamples * sizeof(int16_t));
-    if (!mp3Buffer.buffer) {
-        DEBUG("Failed to allocate MP3 buffer");
-        return false;
-    }
+    mp3LowWater = (size_t)SAMPLE_RATE * 2 * MP3_LOW_WATER_MS / 1000;
+    mp3PrimeSamples = (size_t)SAMPLE_RATE * 2 * MP3_PRIME_MS / 1000;
+    memset(&mp3SchedStats, 0, sizeof(mp3SchedStats));
     
-    mp3Buffer.size = bufferSamples;
+    // Stem buffers are allocated the first time a slot is used
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        MP3Player& player = mp3Players[i];
+        player.active = false;
+        player.stopRequested = false;
+        player.ring.buffer = NULL;
+        player.ring.mutex = NULL;
+        player.fileMutex = NULL;
+        player.input = NULL;
+        player.decodeBuf = NULL;
+        player.decoder = NULL;
+        player.index.offsets = NULL;
+        player.index.numFrames = 0;
+        memset(&player.stats, 0, sizeof(player.stats));
+    }
     
-    // Create mutex for thread safety
-    mp3Buffer.mutex = xSemaphoreCreateMutex();
-    if (!mp3Buffer.mutex) {
-        DEBUG("Failed to create MP3 buffer mutex");
-        free(mp3Buffer.buffer);
-        mp3Buffer.buffer = NULL;
+    // One SD reader and one decoder serve every stem
+    BaseType_t result = xTaskCreatePinnedToCore(
+        mp3IOTaskCode,
+        "MP3IO",
+        4096,
+        NULL,
+        3,              // Above the decoder so reads are issued as soon as there is room
+        &mp3IOTask,
+        1
+    );
+    if (result != pdPASS) {
+        DEBUGF("Failed to create MP3 I/O task, error: %d\n", result);
         return false;
     }
     
-    // Clear buffer
-    memset(mp3Buffer.buffer, 0, bufferSamples * sizeof(int16_t));
-    
-    DEBUGF("MP3 buffer allocated: %d samples (%.1f seconds)\n", 
-           bufferSamples, (float)bufferSamples / 44100.0f / 2.0f);
-    DEBUGF("MP3 mutex created: %p\n", mp3Buffer.mutex);
+    result = xTaskCreatePinnedToCore(
+        mp3DecodeTaskCode,
+        "MP3Decode",
+        8192,           // Stack size
+        NULL,           // Parameters
+        2,              // Priority (higher than audio task)
+        &mp3DecodeTask,
+        1               // Core 1 (opposite from audio task on core 0)
+    );
+    if (result != pdPASS) {
+        DEBUGF("Failed to create MP3 decode task, error: %d\n", result);
+        return false;
+    }
     
+    DEBUGF("MP3 streamer ready: %d stems, %.1f s ring and %d KB read-ahead each\n",
+           MP3_MAX_STREAMS, MP3_BUFFER_MS / 1000.0f, MP3_INPUT_BYTES / 1024);
     return true;
 }
 
-void startMP3Stream(const char* filename) {
-    if (mp3Streaming) {
-        DEBUG("Already streaming, stopping current stream...");
-        stopMP3Stream();
-        vTaskDelay(100 / portTICK_PERIOD_MS); // Wait for cleanup
+// First use of a slot: allocate its ring, read-ahead and locks
+static bool allocatePlayer(MP3Player& player) {
+    if (!player.ring.buffer) {
+        const size_t bufferSamples = (size_t)SAMPLE_RATE * 2 * MP3_BUFFER_MS / 1000;
+        player.ring.buffer = (int16_t*)ps_malloc(bufferSamples * sizeof(int16_t));
+        if (!player.ring.buffer) return false;
+        player.ring.size = bufferSamples;
     }
+    if (!player.input) player.input = (uint8_t*)ps_malloc(MP3_INPUT_BYTES);
+    if (!player.decodeBuf) player.decodeBuf = (uint8_t*)malloc(MP3_DECODE_BUF_BYTES);
+    if (!player.ring.mutex) player.ring.mutex = xSemaphoreCreateMutex();
+    if (!player.fileMutex) player.fileMutex = xSemaphoreCreateMutex();
+    return player.input && player.decodeBuf && player.ring.mutex && player.fileMutex;
+}
+
+// Song sample range and rate of a stem: the MP3's own, or 44.1 kHz for cached PCM
+static uint32_t playerRate(const MP3Player& player) {
+    return player.pcmCached ? SAMPLE_RATE : player.index.sampleRate;
+}
+
+static uint32_t playerFirstSample(const MP3Player& player) {
+    return player.pcmCached ? 0 : getMP3FirstSample(player.index);
+}
+
+static uint32_t playerEndSample(const MP3Player& player) {
+    return player.pcmCached ? player.pcmFrames : getMP3EndSample(player.index);
+}
+
+// Publish the file sample the audio task mixes next (caller holds the ring mutex).
+// Readers load it without the lock so the audio task never waits on the decoder.
+static void publishHeard(MP3Player& player) {
+    uint32_t readTotal = player.ring.totalRead;
     
-    // Safety check
-    if (!mp3Buffer.buffer || !mp3Buffer.mutex) {
-        DEBUG("MP3 streamer not properly initialized");
+    // Newest mark at or behind the read point
+    MP3PositionMark mark = { readTotal, 0 };
+    for (int i = 0; i < player.markCount; i++) {
+        const MP3PositionMark& candidate = player.marks[(player.markHead + MP3_POSITION_MARKS - 1 - i) % MP3_POSITION_MARKS];
+        mark = candidate;
+        if ((int32_t)(readTotal - candidate.ringSample) >= 0) break;
+    }
+    
+    int32_t playedFrames = (int32_t)(readTotal - mark.ringSample) / 2;
+    if (playedFrames < 0) playedFrames = 0;
+    uint32_t heard = mark.songSample + (uint32_t)((uint64_t)playedFrames * playerRate(player) / SAMPLE_RATE);
+    __atomic_store_n(&player.heardSample, heard, __ATOMIC_RELEASE);
+}
+
+// Record that the next sample written to the ring is `songSample` (caller holds the ring mutex)
+static void pushPositionMark(MP3Player& player, uint32_t songSample) {
+    player.marks[player.markHead].ringSample = player.ring.totalWritten;
+    player.marks[player.markHead].songSample = songSample;
+    player.markHead = (player.markHead + 1) % MP3_POSITION_MARKS;
+    if (player.markCount < MP3_POSITION_MARKS) player.markCount++;
+    publishHeard(player);
+}
+
+// Drop everything buffered so a seek is heard immediately
+static void flushRing(MP3Player& player, uint32_t songSample) {
+    xSemaphoreTake(player.ring.mutex, portMAX_DELAY);
+    player.ring.readPos = player.ring.writePos;
+    player.ring.hasData = false;
+    player.ring.totalRead = player.ring.totalWritten;
+    player.markCount = 0;
+    pushPositionMark(player, songSample);
+    xSemaphoreGive(player.ring.mutex);
+}
+
+// Restart decoding at the frame holding `sample`, backed up by the preroll.
+// The SD reader refills the read-ahead from the new offset before decoding resumes.
+static void jumpToSample(MP3Player& player, uint32_t sample) {
+    if (player.pcmCached) {
+        // Cached PCM needs no preroll and seeks straight to the sample
+        player.songSample = sample;
+        player.discardUntil = sample;
+        if (!player.pcmMemory) {
+            player.ioSeekOffset = player.pcmDataOffset + sample * 4;
+            xTaskNotifyGive(mp3IOTask);
+        }
+        return;
+    }
+    if (!player.indexed) {
+        // Xing/VBRI TOC: lands on the nearest whole percent of the track
+        uint32_t first = getMP3FirstSample(player.index);
+        uint32_t end = getMP3EndSample(player.index);
+        uint32_t percent = (end > first && sample > first) ? (uint64_t)(sample - first) * 100 / (end - first) : 0;
+        percent = min(percent, (uint32_t)99);
+        uint32_t frame = (uint64_t)player.index.numFrames * percent / 100;
+        player.frame = frame;
+        player.songSample = frame * player.index.samplesPerFrame;
+        player.discardUntil = max(first, player.songSample);
+        player.needSync = true;
+        player.readPtr = player.decodeBuf;
+        player.bytesLeft = 0;
+        uint32_t offset = player.info.audioStart + (uint64_t)player.info.toc[percent] * player.info.audioBytes / 256;
+        player.ioSeekOffset = max(offset, player.info.firstFrame);
+        xTaskNotifyGive(mp3IOTask);
         return;
     }
+    uint32_t frame = sample / player.index.samplesPerFrame;
+    frame = frame > MP3_PREROLL_FRAMES ? frame - MP3_PREROLL_FRAMES : 0;
+    if (frame >= player.index.numFrames) frame = player.index.numFrames - 1;
+    player.frame = frame;
+    player.songSample = frame * player.index.samplesPerFrame;
+    player.discardUntil = sample;
+    player.readPtr = player.decodeBuf;
+    player.bytesLeft = 0;
+    player.ioSeekOffset = player.index.offsets[frame];
+    xTaskNotifyGive(mp3IOTask);
+}
+
+static uint32_t secondsToSongSample(const MP3Player& player, float seconds) {
+    float first = playerFirstSample(player);
+    float sample = first + seconds * playerRate(player);
+    return (uint32_t)constrain(sample, first, (float)playerEndSample(player));
+}
+
+static float songSampleToSeconds(const MP3Player& player, uint32_t sample) {
+    uint32_t first = playerFirstSample(player);
+    return sample > first ? (float)(sample - first) / playerRate(player) : 0.0f;
+}
+
+int startMP3Stem(const char* filename) {
+    int slot = -1;
+    int activeStems = 0;
+    bool allIndexed = true;
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        if (mp3Players[i].active) {
+            activeStems++;
+            allIndexed = allIndexed && mp3Players[i].indexed;
+        } else if (slot < 0) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        DEBUGF("All %d stems are in use\n", MP3_MAX_STREAMS);
+        return -1;
+    }
     
-    currentMP3File = filename;
-    DEBUGF("Starting MP3 stream for: %s\n", filename);
+    // Only add a stem if the decoder has measured headroom for it
+    float load = getMP3DecodeLoad();
+    float estimate = MP3_STEM_LOAD_ESTIMATE;
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        if (mp3Players[i].active) estimate = max(estimate, getMP3StemLoad(mp3Players[i]));
+    }
+    if (activeStems > 0 && load + estimate > MP3_DECODE_BUDGET) {
+        DEBUGF("No decode headroom for another stem (%.0f%% used, +%.0f%%, budget %.0f%%)\n",
+               load * 100.0f, estimate * 100.0f, MP3_DECODE_BUDGET * 100.0f);
+        return -1;
+    }
     
-    // Create streaming task with simpler parameters
-    BaseType_t result = xTaskCreatePinnedToCore(
-        mp3StreamTaskCode,
-        "MP3Stream",
-        8192,           // Stack size
-        NULL,           // Parameters
-        2,              // Priority (higher than audio task)
-        &mp3StreamTask,
-        1               // Core 1 (opposite from audio task on core 0)
-    );
+    MP3Player& player = mp3Players[slot];
+    if (!allocatePlayer(player)) {
+        DEBUG("Failed to allocate MP3 stem buffers");
+        return -1;
+    }
     
-    if (result != pdPASS) {
-        DEBUGF("Failed to create MP3 stream task, error: %d\n", result);
+    String filepath = filename;
+    if (!filepath.startsWith("/")) {
+        filepath = "/" + filepath;
+    }
+    player.file = SD_MMC.open(filepath.c_str());
+    if (!player.file) {
+        DEBUGF("Failed to open MP3 file: %s\n", filepath.c_str());
+        return -1;
+    }
+    
+    // A decoded copy in the PCM cache plays with no decode cost
+    PCMCacheEntry cached;
+    player.pcmCached = lookupPCMCache(filepath.c_str(), player.file, cached);
+    player.pcmMemory = NULL;
+    player.decoder = NULL;
+    player.index.offsets = NULL;
+    player.index.numFrames = 0;
+    memset(&player.info, 0, sizeof(player.info));
+    if (player.pcmCached) {
+        player.file.close();
+        player.indexed = true;
+        player.timed = true;
+        player.pcmMemory = cached.memory;
+        player.pcmDataOffset = cached.dataOffset;
+        player.pcmFrames = cached.frames;
+        if (!cached.memory) player.file = cached.file;
+    } else {
+        // Opening costs a few small reads whatever the tags hold: jump over ID3v2
+        // and read the Xing/VBRI header for the length, LAME trim and TOC. A cached
+        // index adds sample-accurate seeking. Only files whose header can't give
+        // the length are scanned now; without either they play as a plain stream.
+        bool hasInfo = readMP3StreamInfo(player.file, player.info);
+        bool headerTimed = hasInfo && player.info.numFrames > 0;
+        player.indexed = loadCachedMP3Index(filepath.c_str(), player.file, player.index);
+        if (!player.indexed && !headerTimed) {
+            player.indexed = buildMP3Index(filepath.c_str(), player.file, player.index);
+        }
+        if (!player.indexed && headerTimed) {
+            copyMP3StreamInfo(player.info, player.index);
+        }
+        player.timed = player.indexed || headerTimed;
+        
+        player.decoder = MP3InitDecoder();
+        if (!player.decoder) {
+            DEBUG("Failed to create MP3 decoder");
+            if (player.indexed) freeMP3Index(player.index);
+            player.file.close();
+            return -1;
+        }
+    }
+    
+    player.filename = filepath;
+    player.gain = 1.0f;
+    player.muted = false;
+    player.appliedGain = 0.0f;
+    player.stopRequested = false;
+    player.decodeDone = false;
+    memset(&player.stats, 0, sizeof(player.stats));
+    player.stats.minFill = player.ring.size;
+    
+    player.ring.readPos = 0;
+    player.ring.writePos = 0;
+    player.ring.hasData = false;
+    player.ring.totalWritten = 0;
+    player.ring.totalRead = 0;
+    player.markHead = 0;
+    player.markCount = 0;
+    
+    player.inputWritten = 0;
+    player.inputRead = 0;
+    player.inputEof = false;
+    player.readPtr = player.decodeBuf;
+    player.bytesLeft = 0;
+    player.resampler.inRate = 0;
+    player.frame = 0;
+    player.songSample = 0;
+    
+    // Song position and the window of samples to keep, at the file's rate.
+    // Indexed files skip any ID3 tag, the Xing/LAME frame and the encoder delay.
+    if (player.pcmCached) {
+        player.needSync = false;
+        player.discardUntil = 0;
+        player.trackEnd = player.pcmFrames;
+        player.loopStart = 0;
+        player.loopEnd = player.trackEnd;
+        player.ioSeekOffset = player.pcmMemory ? -1 : (int32_t)player.pcmDataOffset;
+        player.inputEof = player.pcmMemory != NULL;  // Nothing for the SD reader to do
+        player.bytesPerSecond = SAMPLE_RATE * 4;
+    } else if (player.indexed) {
+        player.needSync = false;
+        player.discardUntil = getMP3FirstSample(player.index);
+        player.trackEnd = getMP3EndSample(player.index);
+        player.loopStart = player.discardUntil;
+        player.loopEnd = player.trackEnd;
+        player.ioSeekOffset = player.index.offsets[0];
+        float seconds = (float)(player.trackEnd - player.discardUntil) / player.index.sampleRate;
+        player.bytesPerSecond = seconds > 0 ? (uint32_t)(player.index.fileSize / seconds) : 16000;
+    } else if (player.timed) {
+        player.needSync = true;
+        player.discardUntil = getMP3FirstSample(player.index);
+        player.trackEnd = getMP3EndSample(player.index);
+        player.loopStart = player.discardUntil;
+        player.loopEnd = player.trackEnd;
+        player.ioSeekOffset = player.info.firstFrame;
+        float seconds = (float)(player.trackEnd - player.discardUntil) / player.index.sampleRate;
+        player.bytesPerSecond = seconds > 0 ? (uint32_t)(player.info.audioBytes / seconds) : 16000;
     } else {
-        DEBUG("MP3 stream task created successfully");
+        player.needSync = true;
+        player.discardUntil = 0;
+        player.trackEnd = UINT32_MAX;
+        player.ioSeekOffset = player.info.firstFrame;  // Past any ID3v2 tags
+        player.bytesPerSecond = 16000;  // 128 kbps
+    }
+    pushPositionMark(player, player.discardUntil);
+    
+    // Join the stems already playing at their current position
+    float position = getMP3PositionSeconds();
+    
+    DEBUGF("Starting MP3 stem %d: %s%s\n", slot, filepath.c_str(),
+           player.pcmCached ? (player.pcmMemory ? " (cached in PSRAM)" : " (cached on SD)") : "");
+    mp3Primed = false;
+    player.active = true;
+    mp3Streaming = true;
+    
+    if (activeStems > 0 && allIndexed && player.indexed) {
+        mp3SeekRequest = position;
+    } else if (activeStems == 0) {
+        mp3LoopEnabled = false;
     }
+    xTaskNotifyGive(mp3IOTask);
+    xTaskNotifyGive(mp3DecodeTask);
+    return slot;
+}
+
+void startMP3Stream(const char* filename) {
+    if (mp3Streaming) {
+        DEBUG("Already streaming, stopping current stream...");
+        stopMP3Stream();
+    }
+    startMP3Stem(filename);
+}
+
+void stopMP3Stem(int stem) {
+    if (stem < 0 || stem >= MP3_MAX_STREAMS || !mp3Players[stem].active) return;
+    mp3Players[stem].stopRequested = true;
+    xTaskNotifyGive(mp3DecodeTask);
 }
 
 void stopMP3Stream() {
     if (!mp3Streaming) return;
     
     DEBUG("Stopping MP3 stream...");
-    mp3Streaming = false;
-    
-    // Wait for task to finish
-    if (mp3StreamTask != NULL) {
-        vTaskDelay(200 / portTICK_PERIOD_MS);
-        if (mp3StreamTask != NULL) {
-            vTaskDelete(mp3StreamTask);
-            mp3StreamTask = NULL;
-        }
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        if (mp3Players[i].active) mp3Players[i].stopRequested = true;
     }
+    xTaskNotifyGive(mp3DecodeTask);
     
-    // Reset buffer
-    xSemaphoreTake(mp3Buffer.mutex, portMAX_DELAY);
-    mp3Buffer.writePos = 0;
-    mp3Buffer.readPos = 0;
-    mp3Buffer.hasData = false;
-    xSemaphoreGive(mp3Buffer.mutex);
+    // The decode task tears the stems down between frames
+    for (int wait = 0; wait < 50 && mp3Streaming; wait++) {
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
     
     DEBUG("MP3 stream stopped");
 }
@@ -122,181 +436,693 @@ void setMP3Volume(float volume) {
     DEBUGF("MP3 volume: %.2f\n", mp3Volume);
 }
 
-bool readMP3Samples(int16_t* leftOut, int16_t* rightOut) {
-    if (!mp3Buffer.hasData) return false;
+void setMP3StemGain(int stem, float gain) {
+    if (stem < 0 || stem >= MP3_MAX_STREAMS) return;
+    mp3Players[stem].gain = constrain(gain, 0.0f, 2.0f);
+    DEBUGF("Stem %d gain: %.2f\n", stem, mp3Players[stem].gain);
+}
+
+void setMP3StemMute(int stem, bool muted) {
+    if (stem < 0 || stem >= MP3_MAX_STREAMS) return;
+    mp3Players[stem].muted = muted;
+    DEBUGF("Stem %d %s\n", stem, muted ? "muted" : "unmuted");
+}
+
+// Add `count` samples of one stem into the mix with its gain ramped across the buffer
+static void mixPlayer(MP3Player& player, int32_t* mix, size_t count, size_t wanted) {
+    xSemaphoreTake(player.ring.mutex, portMAX_DELAY);
     
-    bool success = false;
+    size_t available = getAvailableReadSamples(player.ring) & ~(size_t)1;
+    count = min(count, available);
     
-    xSemaphoreTake(mp3Buffer.mutex, portMAX_DELAY);
+    // Muted stems keep advancing so they stay in step with the others
+    float target = player.muted ? 0.0f : player.gain * mp3Volume;
+    float gain = player.appliedGain;
+    float step = count > 0 ? (target - gain) / (float)(count / 2) : 0.0f;
     
-    if (getAvailableReadSamples() >= 2) { // Need stereo pair
-        *leftOut = (int16_t)((float)mp3Buffer.buffer[mp3Buffer.readPos] * mp3Volume);
-        *rightOut = (int16_t)((float)mp3Buffer.buffer[mp3Buffer.readPos + 1] * mp3Volume);
-        advanceReadPos(2);
-        success = true;
+    if (target > 0.0f || gain > 0.0f) {
+        // Read in at most two spans: up to the end of the ring, then from the start
+        size_t readPos = player.ring.readPos;
+        size_t first = min(count, player.ring.size - readPos);
+        const int16_t* src = player.ring.buffer + readPos;
+        for (size_t i = 0; i < first; i += 2) {
+            mix[i] += (int32_t)(src[i] * gain);
+            mix[i + 1] += (int32_t)(src[i + 1] * gain);
+            gain += step;
+        }
+        src = player.ring.buffer;
+        for (size_t i = first; i < count; i += 2) {
+            mix[i] += (int32_t)(src[i - first] * gain);
+            mix[i + 1] += (int32_t)(src[i + 1 - first] * gain);
+            gain += step;
+        }
     }
+    player.appliedGain = target;
+    advanceReadPos(player.ring, count);
+    player.ring.totalRead += count;
+    publishHeard(player);
+    
+    size_t remaining = available - count;
     
-    xSemaphoreGive(mp3Buffer.mutex);
-    return success;
+    xSemaphoreGive(player.ring.mutex);
+    
+    if (!player.decodeDone) {
+        if (available < wanted) {
+            player.stats.underruns++;
+            trace(TRACE_UNDERRUN, TRACE_SRC_MP3, &player - mp3Players);
+        }
+        if (remaining < player.stats.minFill) player.stats.minFill = remaining;
+        
+        // Drained below the low-water mark: let the decoder refill in one burst
+        if (mp3DecoderWaiting && remaining < mp3LowWater) {
+            mp3DecoderWaiting = false;
+            xTaskNotifyGive(mp3DecodeTask);
+        }
+    } else if (remaining == 0 && mp3DecoderWaiting) {
+        // Played out: the decoder retires it
+        mp3DecoderWaiting = false;
+        xTaskNotifyGive(mp3DecodeTask);
+    }
 }
 
-void mp3StreamTaskCode(void* parameter) {
-    DEBUG("MP3 stream task started");
+int mixMP3Samples(int32_t* mix, int frames) {
+    if (!mp3Streaming) return 0;
     
-    // Build file path
-    String filepath = currentMP3File;
-    if (!filepath.startsWith("/")) {
-        filepath = "/" + filepath;
+    // Stems stay sample-aligned by all advancing the same amount. Stems that
+    // have finished decoding just play out what they have left.
+    size_t wanted = (size_t)frames * 2;
+    size_t count = wanted;
+    size_t lowest = SIZE_MAX;
+    int decoding = 0;
+    bool ready = true;
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        MP3Player& player = mp3Players[i];
+        if (!player.active || player.stopRequested || player.decodeDone) continue;
+        size_t available = getAvailableReadSamples(player.ring) & ~(size_t)1;
+        if (available < mp3PrimeSamples) ready = false;
+        count = min(count, available);
+        lowest = min(lowest, available);
+        decoding++;
     }
+    if (decoding > 0) trace(TRACE_MP3_FILL, decoding, lowest / 2);
     
-    // Open file
-    mp3File = SD_MMC.open(filepath.c_str());
-    if (!mp3File) {
-        DEBUGF("Failed to open MP3 file: %s\n", filepath.c_str());
-        mp3Streaming = false;
-        vTaskDelete(NULL);
+    if (!mp3Primed) {
+        if (!ready) return 0;
+        mp3Primed = true;
+    }
+    
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        MP3Player& player = mp3Players[i];
+        if (player.active && !player.stopRequested) {
+            mixPlayer(player, mix, count, wanted);
+        }
+    }
+    
+    return count / 2;
+}
+
+// Copy a decoded frame into the ring in at most two spans (caller holds the mutex)
+static void writeMP3Samples(MP3StreamBuffer& ring, const int16_t* src, size_t count) {
+    size_t writePos = ring.writePos;
+    size_t first = min(count, ring.size - writePos);
+    memcpy(ring.buffer + writePos, src, first * sizeof(int16_t));
+    if (count > first) {
+        memcpy(ring.buffer, src + first, (count - first) * sizeof(int16_t));
+    }
+    advanceWritePos(ring, count);
+    ring.totalWritten += count;
+}
+
+// Top up the decode window from the read-ahead (decode task only)
+static void refillDecodeInput(MP3Player& player) {
+    if (player.bytesLeft >= MP3_DECODE_BUF_BYTES / 2) return;
+    
+    memmove(player.decodeBuf, player.readPtr, player.bytesLeft);
+    player.readPtr = player.decodeBuf;
+    
+    uint32_t inputRead = player.inputRead;
+    uint32_t available = player.inputWritten - inputRead;
+    uint32_t count = min(available, (uint32_t)(MP3_DECODE_BUF_BYTES - player.bytesLeft));
+    uint32_t offset = inputRead % MP3_INPUT_BYTES;
+    uint32_t first = min(count, (uint32_t)MP3_INPUT_BYTES - offset);
+    memcpy(player.decodeBuf + player.bytesLeft, player.input + offset, first);
+    memcpy(player.decodeBuf + player.bytesLeft + first, player.input, count - first);
+    player.bytesLeft += count;
+    player.inputRead = inputRead + count;
+    
+    // A whole chunk has been freed: the reader can fetch more
+    if (MP3_INPUT_BYTES - (player.inputWritten - player.inputRead) >= MP3_IO_CHUNK_BYTES) {
+        xTaskNotifyGive(mp3IOTask);
+    }
+}
+
+// Enough compressed data for a whole frame (a whole window for cached PCM), or the rest of the file
+static bool inputReady(const MP3Player& player) {
+    if (player.pcmMemory) return true;
+    if (player.ioSeekOffset >= 0) return false;
+    bool eof = player.inputEof;
+    uint32_t buffered = player.bytesLeft + (player.inputWritten - player.inputRead);
+    return eof || buffered >= (player.pcmCached ? MP3_DECODE_BUF_BYTES : MP3_MAX_FRAME_BYTES);
+}
+
+static bool inputExhausted(const MP3Player& player) {
+    return player.inputEof && player.bytesLeft == 0 && player.inputWritten == player.inputRead;
+}
+
+// End of the track or loop region: wrap gaplessly or let the stem drain
+static void endOfTrack(MP3Player& player) {
+    if (!(player.indexed && mp3LoopEnabled)) {
+        player.decodeDone = true;
         return;
     }
     
-    // Create decoder
-    mp3Decoder = MP3InitDecoder();
-    if (!mp3Decoder) {
-        DEBUG("Failed to create MP3 decoder in stream task");
-        mp3File.close();
-        mp3Streaming = false;
-        vTaskDelete(NULL);
+    // The ring and resampler carry on, only the input jumps
+    uint32_t loopStart = player.loopStart;
+    jumpToSample(player, loopStart);
+    xSemaphoreTake(player.ring.mutex, portMAX_DELAY);
+    pushPositionMark(player, loopStart);
+    xSemaphoreGive(player.ring.mutex);
+}
+
+// Cached tracks are already 44.1 kHz stereo: copy up to one decode window per turn
+static void copyCachedFrames(MP3Player& player) {
+    uint32_t start = ESP.getCycleCount();
+    uint32_t playEnd = mp3LoopEnabled ? player.loopEnd : player.trackEnd;
+    uint32_t frames = playEnd > player.songSample ? min((uint32_t)(MP3_DECODE_BUF_BYTES / 4), playEnd - player.songSample) : 0;
+    frames = min(frames, (uint32_t)(getAvailableWriteSpace(player.ring) / 2));
+    
+    const int16_t* src;
+    if (player.pcmMemory) {
+        src = player.pcmMemory + (size_t)player.songSample * 2;
+    } else {
+        // Through the decode window so the copy into the ring is one span
+        frames = min(frames, (player.inputWritten - player.inputRead) / 4);
+        uint32_t bytes = frames * 4;
+        uint32_t offset = player.inputRead % MP3_INPUT_BYTES;
+        uint32_t first = min(bytes, (uint32_t)MP3_INPUT_BYTES - offset);
+        memcpy(player.decodeBuf, player.input + offset, first);
+        memcpy(player.decodeBuf + first, player.input, bytes - first);
+        player.inputRead += bytes;
+        if (MP3_INPUT_BYTES - (player.inputWritten - player.inputRead) >= MP3_IO_CHUNK_BYTES) {
+            xTaskNotifyGive(mp3IOTask);
+        }
+        src = (const int16_t*)player.decodeBuf;
+    }
+    
+    if (frames > 0) {
+        xSemaphoreTake(player.ring.mutex, portMAX_DELAY);
+        writeMP3Samples(player.ring, src, frames * 2);
+        player.ring.hasData = true;
+        xSemaphoreGive(player.ring.mutex);
+    }
+    player.songSample += frames;
+    player.stats.decodeCycles += ESP.getCycleCount() - start;
+    player.stats.sourceSamples += frames;
+    player.stats.sourceRate = SAMPLE_RATE;
+    player.stats.sourceChannels = 2;
+    player.stats.framesDecoded++;
+    
+    if (player.songSample >= playEnd || (frames == 0 && inputExhausted(player))) {
+        endOfTrack(player);
+    }
+}
+
+static void decodeFrame(MP3Player& player, int16_t* frameBuffer, int16_t* convertBuffer) {
+    refillDecodeInput(player);
+    if (inputExhausted(player)) {
+        endOfTrack(player);
         return;
     }
     
-    // Allocate working buffers
-    const size_t inputBufSize = 16384;
-    uint8_t* inputBuffer = (uint8_t*)malloc(inputBufSize);
-    int16_t* frameBuffer = (int16_t*)malloc(2304 * sizeof(int16_t));
+    // Find sync on first frame
+    if (player.needSync) {
+        int syncOffset = MP3FindSyncWord(player.readPtr, player.bytesLeft);
+        if (syncOffset < 0) {
+            // Keep the last bytes in case a sync word straddles the refill
+            int keep = min(player.bytesLeft, 3);
+            player.readPtr += player.bytesLeft - keep;
+            player.bytesLeft = keep;
+            if (player.inputEof && player.inputWritten == player.inputRead) {
+                DEBUGQ("No sync found in MP3 stream");
+                player.decodeDone = true;
+            }
+            return;
+        }
+        player.readPtr += syncOffset;
+        player.bytesLeft -= syncOffset;
+        player.needSync = false;
+    }
+    
+    // Decode frame
+    uint32_t decodeStart = ESP.getCycleCount();
+    int err = MP3Decode((HMP3Decoder)player.decoder, &player.readPtr, &player.bytesLeft, frameBuffer, 0);
+    uint32_t decodeEnd = ESP.getCycleCount();
     
-    if (!inputBuffer || !frameBuffer) {
-        DEBUG("Failed to allocate stream buffers");
-        if (inputBuffer) free(inputBuffer);
-        if (frameBuffer) free(frameBuffer);
-        MP3FreeDecoder(mp3Decoder);
-        mp3File.close();
-        mp3Streaming = false;
-        vTaskDelete(NULL);
+    MP3FrameInfo frameInfo;
+    if (err == ERR_MP3_NONE) {
+        MP3GetLastFrameInfo((HMP3Decoder)player.decoder, &frameInfo);
+    } else if (player.indexed) {
+        // Reservoir not primed yet after a jump, or a damaged frame: keep the
+        // timeline with silence. The index knows where the next frame starts.
+        if (err != ERR_MP3_MAINDATA_UNDERFLOW && player.frame + 1 < player.index.numFrames) {
+            player.readPtr = player.decodeBuf;
+            player.bytesLeft = 0;
+            player.ioSeekOffset = player.index.offsets[player.frame + 1];
+            xTaskNotifyGive(mp3IOTask);
+        }
+        frameInfo.nChans = player.index.channels;
+        frameInfo.samprate = player.index.sampleRate;
+        frameInfo.outputSamps = player.index.samplesPerFrame * player.index.channels;
+        memset(frameBuffer, 0, frameInfo.outputSamps * sizeof(int16_t));
+    } else {
+        if (player.inputEof) {
+            player.decodeDone = true;  // Truncated last frame
+            return;
+        }
+        
+        // Try to recover by finding next sync
+        player.needSync = true;
+        if (player.bytesLeft > 0) {
+            player.readPtr++;
+            player.bytesLeft--;
+        }
         return;
     }
     
-    mp3Streaming = true;
+    // Keep only [discardUntil, playEnd) of this frame
+    size_t frameSamples = frameInfo.outputSamps / frameInfo.nChans;
+    bool looping = player.indexed && mp3LoopEnabled;
+    uint32_t playEnd = looping ? player.loopEnd : player.trackEnd;
+    uint32_t songSample = player.songSample;
+    uint32_t skip = player.discardUntil > songSample ? min((uint32_t)frameSamples, player.discardUntil - songSample) : 0;
+    uint32_t keep = playEnd > songSample ? min((uint32_t)frameSamples, playEnd - songSample) : 0;
+    player.songSample += frameSamples;
+    player.frame++;
     
-    // Read initial data and find sync
-    size_t totalBytesRead = mp3File.read(inputBuffer, inputBufSize);
-    uint8_t* readPtr = inputBuffer;
-    int bytesLeft = totalBytesRead;
-    bool firstFrame = true;
+    if (keep > skip) {
+        // Bring mono and non-44.1 kHz frames to the ring's format
+        const int16_t* output;
+        size_t outputFrames = convertToOutputFormat(frameBuffer + skip * frameInfo.nChans, keep - skip,
+                                                    frameInfo.nChans, frameInfo.samprate,
+                                                    player.resampler, convertBuffer, &output);
+        player.stats.convertCycles += ESP.getCycleCount() - decodeEnd;
+        
+        // Write to circular buffer
+        xSemaphoreTake(player.ring.mutex, portMAX_DELAY);
+        
+        size_t samplesToWrite = min(outputFrames * 2, getAvailableWriteSpace(player.ring));
+        writeMP3Samples(player.ring, output, samplesToWrite);
+        player.ring.hasData = true;
+        
+        xSemaphoreGive(player.ring.mutex);
+    }
+    player.stats.decodeCycles += decodeEnd - decodeStart;
+    player.stats.sourceSamples += frameSamples;
+    player.stats.sourceRate = frameInfo.samprate;
+    player.stats.sourceChannels = frameInfo.nChans;
+    player.stats.framesDecoded++;
     
-    DEBUGF("MP3 stream task running, file size: %d\n", mp3File.size());
+    if (player.songSample >= playEnd || (player.indexed && player.frame >= player.index.numFrames)) {
+        endOfTrack(player);
+    }
+}
+
+// Release a stem's file, decoder and index (decode task only)
+static void teardownPlayer(MP3Player& player) {
+    player.stopRequested = true;    // Audio task and SD reader leave it alone from here on
     
-    while (mp3Streaming && mp3File.available()) {
-        // Find sync on first frame
-        if (firstFrame) {
-            int syncOffset = MP3FindSyncWord(readPtr, bytesLeft);
-            if (syncOffset < 0) {
-                DEBUG("No sync found in stream task");
-                break;
+    xSemaphoreTake(player.fileMutex, portMAX_DELAY);
+    player.file.close();
+    xSemaphoreGive(player.fileMutex);
+    
+    if (player.decoder) MP3FreeDecoder((HMP3Decoder)player.decoder);
+    player.decoder = NULL;
+    if (player.indexed) freeMP3Index(player.index);
+    player.indexed = false;
+    player.timed = false;
+    
+    xSemaphoreTake(player.ring.mutex, portMAX_DELAY);
+    player.ring.readPos = player.ring.writePos;
+    player.ring.hasData = false;
+    xSemaphoreGive(player.ring.mutex);
+    
+    DEBUGQF("MP3 stem %s finished\n", player.filename.c_str());
+    player.active = false;          // Slot can be reused
+}
+
+// Something for the decoder to do: a request, a finished stem that has played out
+// or a ring below low water
+static bool decoderHasWork() {
+    if (mp3SeekRequest >= 0.0f) return true;
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        const MP3Player& player = mp3Players[i];
+        if (!player.active) continue;
+        if (player.stopRequested) return true;
+        size_t available = getAvailableReadSamples(player.ring);
+        if (player.decodeDone ? available == 0 : available < mp3LowWater) return true;
+    }
+    return false;
+}
+
+void mp3DecodeTaskCode(void* parameter) {
+    DEBUG("MP3 decode task started");
+    
+    // Shared by every stem since only one frame is decoded at a time
+    int16_t* frameBuffer = (int16_t*)malloc(MP3_MAX_FRAME_SAMPLES * sizeof(int16_t));
+    int16_t* convertBuffer = (int16_t*)malloc(MP3_MAX_OUTPUT_SAMPLES * sizeof(int16_t));
+    if (!frameBuffer || !convertBuffer) {
+        DEBUG("Failed to allocate MP3 decode buffers");
+        vTaskDelete(NULL);
+        return;
+    }
+    
+    while (true) {
+        // Retire stopped stems and stems that have played out
+        bool anyActive = false;
+        for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+            MP3Player& player = mp3Players[i];
+            if (!player.active) continue;
+            if (player.stopRequested || (player.decodeDone && getAvailableReadSamples(player.ring) == 0)) {
+                teardownPlayer(player);
+            } else {
+                anyActive = true;
             }
-            readPtr += syncOffset;
-            bytesLeft -= syncOffset;
-            firstFrame = false;
         }
+        mp3Streaming = anyActive;
         
-        // Refill buffer if needed
-        if (bytesLeft < 2000) {
-            memmove(inputBuffer, readPtr, bytesLeft);
-            size_t moreBytes = mp3File.read(inputBuffer + bytesLeft, inputBufSize - bytesLeft);
-            readPtr = inputBuffer;
-            bytesLeft += moreBytes;
+        // Seek: flush every stem and restart decoding just ahead of the target
+        if (mp3SeekRequest >= 0.0f) {
+            float seconds = mp3SeekRequest;
+            mp3SeekRequest = -1.0f;
+            mp3Primed = false;
+            for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+                MP3Player& player = mp3Players[i];
+                if (!player.active || !(player.indexed || player.info.hasToc)) continue;
+                uint32_t target = secondsToSongSample(player, seconds);
+                player.resampler.inRate = 0;
+                player.decodeDone = false;
+                jumpToSample(player, target);
+                flushRing(player, player.discardUntil);  // Where the jump actually lands
+            }
         }
         
-        // Wait if circular buffer is getting full (prevent overflow)
-        while (mp3Streaming && getAvailableWriteSpace() < 2304) {
-            vTaskDelay(10 / portTICK_PERIOD_MS);
+        // Serve the emptiest stem that has room in its ring and input to decode
+        MP3Player* next = NULL;
+        bool starved = false;
+        for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+            MP3Player& player = mp3Players[i];
+            if (!player.active || player.stopRequested || player.decodeDone) continue;
+            if (getAvailableWriteSpace(player.ring) < MP3_MAX_OUTPUT_SAMPLES) continue;
+            if (!inputReady(player)) {
+                starved = true;
+                continue;
+            }
+            if (!next || getAvailableReadSamples(player.ring) < getAvailableReadSamples(next->ring)) {
+                next = &player;
+            }
         }
         
-        if (!mp3Streaming) break;
+        if (next) {
+            if (next->pcmCached) {
+                copyCachedFrames(*next);
+            } else {
+                decodeFrame(*next, frameBuffer, convertBuffer);
+            }
+            continue;
+        }
         
-        // Decode frame
-        int err = MP3Decode(mp3Decoder, &readPtr, &bytesLeft, frameBuffer, 0);
+        if (starved) {
+            // Waiting on the SD reader, which notifies after every chunk
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(5));
+            continue;
+        }
         
-        if (err == ERR_MP3_NONE) {
-            MP3FrameInfo frameInfo;
-            MP3GetLastFrameInfo(mp3Decoder, &frameInfo);
-            
-            // Write to circular buffer
-            xSemaphoreTake(mp3Buffer.mutex, portMAX_DELAY);
-            
-            size_t samplesToWrite = min((size_t)frameInfo.outputSamps, getAvailableWriteSpace());
-            for (size_t i = 0; i < samplesToWrite; i++) {
-                mp3Buffer.buffer[(mp3Buffer.writePos + i) % mp3Buffer.size] = frameBuffer[i];
-            }
-            advanceWritePos(samplesToWrite);
-            mp3Buffer.hasData = true;
-            
-            xSemaphoreGive(mp3Buffer.mutex);
-            
-        } else {
-            // Try to recover by finding next sync
-            int syncOffset = MP3FindSyncWord(readPtr, bytesLeft);
-            if (syncOffset >= 0) {
-                readPtr += syncOffset;
-                bytesLeft -= syncOffset;
-            } else {
-                DEBUG("Stream decode error, no recovery sync found");
+        // Every ring is full (high-water mark): sleep until the audio task has
+        // drained one below the low-water mark, then decode a burst back up to full
+        mp3DecoderWaiting = true;
+        while (!decoderHasWork()) {
+            // Timeout is only a safety net; the audio task normally notifies us
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MP3_LOW_WATER_MS / 4));
+        }
+        mp3DecoderWaiting = false;
+        if (mp3Streaming) mp3SchedStats.wakeups++;
+    }
+}
+
+// How long a stem can play from what is already buffered, decoded and compressed
+static uint32_t bufferedMs(const MP3Player& player) {
+    uint32_t pcmMs = getAvailableReadSamples(player.ring) * 1000 / (SAMPLE_RATE * 2);
+    uint32_t inputBytes = player.inputWritten - player.inputRead + player.bytesLeft;
+    return pcmMs + (uint32_t)((uint64_t)inputBytes * 1000 / player.bytesPerSecond);
+}
+
+// Read one chunk for a stem, restarting at a new offset first if one was requested
+static void readChunk(MP3Player& player) {
+    xSemaphoreTake(player.fileMutex, portMAX_DELAY);
+    if (!player.active || player.stopRequested) {
+        xSemaphoreGive(player.fileMutex);
+        return;
+    }
+    
+    int32_t seekOffset = player.ioSeekOffset;
+    if (seekOffset >= 0) {
+        // The decoder doesn't touch the read-ahead until the seek is cleared
+        player.file.seek(seekOffset);
+        player.inputWritten = 0;
+        player.inputRead = 0;
+        player.inputEof = false;
+        mp3SchedStats.ioSeeks++;
+    }
+    
+    // Chunks are whole and the read-ahead is a multiple of them, so a read never wraps
+    uint32_t offset = player.inputWritten % MP3_INPUT_BYTES;
+    uint32_t start = ESP.getCycleCount();
+    size_t bytesRead = player.file.read(player.input + offset, MP3_IO_CHUNK_BYTES);
+    uint32_t cycles = ESP.getCycleCount() - start;
+    player.inputWritten += bytesRead;
+    if (bytesRead < MP3_IO_CHUNK_BYTES) player.inputEof = true;
+    
+    // A jump made during the read keeps its new offset, and this chunk is thrown away
+    if (seekOffset >= 0) {
+        int32_t expected = seekOffset;
+        __atomic_compare_exchange_n(&player.ioSeekOffset, &expected, -1, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    }
+    xSemaphoreGive(player.fileMutex);
+    
+    mp3SchedStats.ioReads++;
+    mp3SchedStats.ioBytes += bytesRead;
+    mp3SchedStats.ioCycles += cycles;
+    if (cycles > mp3SchedStats.ioMaxCycles) mp3SchedStats.ioMaxCycles = cycles;
+    trace(TRACE_SD_READ, TRACE_SRC_MP3, cycles / ESP.getCpuFreqMHz());
+}
+
+void mp3IOTaskCode(void* parameter) {
+    DEBUG("MP3 I/O task started");
+    int nextStem = 0;
+    
+    while (true) {
+        // Seeks first so loop wraps stay gapless, then the stem with the least
+        // audio buffered. Scanning from the last stem served breaks ties round-robin.
+        MP3Player* next = NULL;
+        uint32_t bestMs = UINT32_MAX;
+        for (int n = 0; n < MP3_MAX_STREAMS; n++) {
+            int i = (nextStem + n) % MP3_MAX_STREAMS;
+            MP3Player& player = mp3Players[i];
+            if (!player.active || player.stopRequested) continue;
+            if (player.ioSeekOffset >= 0) {
+                next = &player;
                 break;
             }
+            if (player.inputEof) continue;
+            if (MP3_INPUT_BYTES - (player.inputWritten - player.inputRead) < MP3_IO_CHUNK_BYTES) continue;
+            uint32_t ms = bufferedMs(player);
+            if (ms < bestMs) {
+                bestMs = ms;
+                next = &player;
+            }
+        }
+        
+        if (!next) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));
+            continue;
         }
         
-        vTaskDelay(1); // Yield to other tasks
+        nextStem = (int)(next - mp3Players + 1) % MP3_MAX_STREAMS;
+        readChunk(*next);
+        xTaskNotifyGive(mp3DecodeTask);
     }
-    
-    // Cleanup - let the task clean up its own resources
-    DEBUG("MP3 task cleaning up...");
-    free(inputBuffer);
-    free(frameBuffer);
-    if (mp3Decoder) {
-        MP3FreeDecoder(mp3Decoder);
-        mp3Decoder = NULL;
+}
+
+float getMP3StemLoad(const MP3Player& player) {
+    const MP3StreamStats& stats = player.stats;
+    if (stats.sourceSamples == 0 || stats.sourceRate == 0) return 0.0f;
+    float seconds = (float)stats.sourceSamples / stats.sourceRate;
+    float cycles = (float)(stats.decodeCycles + stats.convertCycles);
+    return cycles / seconds / (ESP.getCpuFreqMHz() * 1000000.0f);
+}
+
+float getMP3DecodeLoad() {
+    float load = 0.0f;
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        if (mp3Players[i].active) load += getMP3StemLoad(mp3Players[i]);
+    }
+    return load;
+}
+
+void printMP3Stems() {
+    DEBUG("=== MP3 Stems ===");
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        const MP3Player& player = mp3Players[i];
+        if (!player.active) continue;
+        DEBUGF("%d: %s gain %.2f%s, %.2f s buffered, decode %.1f%%%s\n", i, player.filename.c_str(),
+               player.gain, player.muted ? " (muted)" : "",
+               (float)getAvailableReadSamples(player.ring) / SAMPLE_RATE / 2.0f,
+               getMP3StemLoad(player) * 100.0f,
+               player.indexed ? "" : (player.timed ? ", not indexed (header timing)" : ", not indexed"));
+    }
+    DEBUGF("Decode load %.1f%% of %.0f%% budget\n", getMP3DecodeLoad() * 100.0f, MP3_DECODE_BUDGET * 100.0f);
+    DEBUG("=== End Stems ===");
+}
+
+bool isMP3DecoderIdle() {
+    return !mp3Streaming || mp3DecoderWaiting;
+}
+
+// Without an index a seek lands within a percent of the track, which is only
+// acceptable for a single stream where there is nothing to keep in sync
+static bool canSeekByToc() {
+    MP3Player* stem = NULL;
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        if (!mp3Players[i].active) continue;
+        if (stem) return false;
+        stem = &mp3Players[i];
+    }
+    return stem && !stem->indexed && stem->timed && stem->info.hasToc;
+}
+
+// Every active stem must be indexed for group seeks and loops
+static bool allStemsIndexed(const char* what) {
+    bool any = false;
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        if (!mp3Players[i].active) continue;
+        if (!mp3Players[i].indexed) {
+            DEBUGF("%s needs every MP3 stem indexed\n", what);
+            return false;
+        }
+        any = true;
+    }
+    if (!any) DEBUGF("%s needs an MP3 stream\n", what);
+    return any;
+}
+
+// First stem with a known length, which stands in for the group when reporting times
+static MP3Player* firstStem() {
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        if (mp3Players[i].active && mp3Players[i].timed) return &mp3Players[i];
     }
-    if (mp3File) {
-        mp3File.close();
+    return NULL;
+}
+
+bool seekMP3(float seconds) {
+    if (!canSeekByToc() && !allStemsIndexed("Seeking")) return false;
+    mp3SeekRequest = max(seconds, 0.0f);
+    xTaskNotifyGive(mp3DecodeTask);
+    DEBUGF("MP3 seek to %.2f s\n", seconds);
+    return true;
+}
+
+bool setMP3Loop(float startSeconds, float endSeconds) {
+    if (!allStemsIndexed("Looping")) return false;
+    if (endSeconds < startSeconds + MP3_MIN_LOOP_SECONDS) {
+        DEBUGF("Loop region must be at least %.2f s long\n", MP3_MIN_LOOP_SECONDS);
+        return false;
     }
     
-    // Reset streaming flag and clear task handle
-    mp3Streaming = false;
-    mp3StreamTask = NULL;
+    // Disable while the pairs are inconsistent; the decoder reads them once per frame
+    mp3LoopEnabled = false;
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        MP3Player& player = mp3Players[i];
+        if (!player.active) continue;
+        player.loopStart = secondsToSongSample(player, startSeconds);
+        player.loopEnd = secondsToSongSample(player, endSeconds);
+    }
+    mp3LoopEnabled = true;
     
-    DEBUG("MP3 stream task finished");
-    vTaskDelete(NULL);  // Delete self
+    MP3Player* stem = firstStem();
+    DEBUGF("MP3 loop %.2f s - %.2f s\n", songSampleToSeconds(*stem, stem->loopStart),
+           songSampleToSeconds(*stem, stem->loopEnd));
+    return true;
+}
+
+bool setMP3LoopEnabled(bool enabled) {
+    if (!allStemsIndexed("Looping")) return false;
+    mp3LoopEnabled = enabled;
+    MP3Player* stem = firstStem();
+    DEBUGF("MP3 loop %s (%.2f s - %.2f s)\n", enabled ? "on" : "off",
+           songSampleToSeconds(*stem, stem->loopStart), songSampleToSeconds(*stem, stem->loopEnd));
+    return true;
+}
+
+bool getMP3LoopRegion(float& startSeconds, float& endSeconds) {
+    MP3Player* stem = firstStem();
+    if (!stem) return false;
+    startSeconds = songSampleToSeconds(*stem, stem->loopStart);
+    endSeconds = songSampleToSeconds(*stem, stem->loopEnd);
+    return mp3LoopEnabled;
+}
+
+// File sample the audio task mixes next
+static uint32_t heardSongSample(const MP3Player& player) {
+    return __atomic_load_n(&player.heardSample, __ATOMIC_ACQUIRE);
+}
+
+float getMP3PositionSeconds() {
+    MP3Player* stem = firstStem();
+    if (!stem) return 0.0f;
+    return songSampleToSeconds(*stem, heardSongSample(*stem));
+}
+
+bool getMP3HeardFrame(uint32_t& frame, bool& primed) {
+    MP3Player* stem = firstStem();
+    if (!stem) return false;
+    uint32_t song = heardSongSample(*stem);
+    uint32_t first = playerFirstSample(*stem);
+    frame = song > first ? (uint32_t)((uint64_t)(song - first) * SAMPLE_RATE / playerRate(*stem)) : 0;
+    primed = mp3Primed;
+    return true;
+}
+
+float getMP3DurationSeconds() {
+    MP3Player* stem = firstStem();
+    if (!stem) return 0.0f;
+    return songSampleToSeconds(*stem, playerEndSample(*stem));
 }
 
 // Buffer management functions
-size_t getAvailableReadSamples() {
-    if (mp3Buffer.writePos >= mp3Buffer.readPos) {
-        return mp3Buffer.writePos - mp3Buffer.readPos;
+size_t getAvailableReadSamples(const MP3StreamBuffer& ring) {
+    size_t writePos = ring.writePos;
+    size_t readPos = ring.readPos;
+    if (writePos >= readPos) {
+        return writePos - readPos;
     } else {
-        return (mp3Buffer.size - mp3Buffer.readPos) + mp3Buffer.writePos;
+        return (ring.size - readPos) + writePos;
     }
 }
 
-size_t getAvailableWriteSpace() {
-    size_t used = getAvailableReadSamples();
-    return mp3Buffer.size - used - 1; // -1 to avoid read==write ambiguity
+size_t getAvailableWriteSpace(const MP3StreamBuffer& ring) {
+    size_t used = getAvailableReadSamples(ring);
+    return ring.size - used - 1; // -1 to avoid read==write ambiguity
 }
 
-void advanceReadPos(size_t samples) {
-    mp3Buffer.readPos = (mp3Buffer.readPos + samples) % mp3Buffer.size;
-    if (getAvailableReadSamples() == 0) {
-        mp3Buffer.hasData = false;
+void advanceReadPos(MP3StreamBuffer& ring, size_t samples) {
+    size_t pos = ring.readPos + samples;
+    ring.readPos = (pos >= ring.size) ? pos - ring.size : pos;
+    if (getAvailableReadSamples(ring) == 0) {
+        ring.hasData = false;
     }
 }
 
-void advanceWritePos(size_t samples) {
-    mp3Buffer.writePos = (mp3Buffer.writePos + samples) % mp3Buffer.size;
+void advanceWritePos(MP3StreamBuffer& ring, size_t samples) {
+    size_t pos = ring.writePos + samples;
+    ring.writePos = (pos >= ring.size) ? pos - ring.size : pos;
 }
\ No newline at end of file
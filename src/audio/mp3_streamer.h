@@ -1,6 +1,10 @@
 #pragma once
 
 #include <Arduino.h>
+#include "FS.h"
+#include "../config.h"
+#include "resampler.h"
+#include "mp3_index.h"
 
 // Circular buffer for decoded MP3 audio
 struct MP3StreamBuffer {
@@ -9,25 +13,140 @@ struct MP3StreamBuffer {
     volatile size_t readPos;   // Where to read data for playback
     size_t size;               // Total buffer size in samples
     volatile bool hasData;     // Whether buffer contains audio data
+    uint32_t totalWritten;     // Samples ever written, for mapping ring data to song position
+    uint32_t totalRead;        // Samples ever read by the audio task
     SemaphoreHandle_t mutex;   // Thread safety
 };
 
+// Per-stem decoder activity
+struct MP3StreamStats {
+    uint32_t framesDecoded;    // MP3 frames written to the ring
+    uint32_t underruns;        // Audio buffers that found the ring short of data while streaming
+    uint32_t minFill;          // Lowest ring fill seen while streaming (samples)
+    uint32_t sourceRate;       // Sample rate of the file being streamed
+    uint8_t sourceChannels;
+    uint64_t sourceSamples;    // Samples per channel decoded, for the decode load
+    uint64_t decodeCycles;     // Time spent in MP3Decode
+    uint64_t convertCycles;    // Time spent upmixing and resampling
+};
+
+// Shared decode task and SD reader activity
+struct MP3SchedulerStats {
+    uint32_t wakeups;          // Times the decoder was woken after every ring filled
+    uint32_t ioReads;          // Chunks read from SD
+    uint32_t ioSeeks;          // Reads that started at a new file offset
+    uint64_t ioBytes;
+    uint64_t ioCycles;         // Time spent in SD reads
+    uint32_t ioMaxCycles;
+};
+
+#define MP3_POSITION_MARKS 32
+
+// Ring offset where a seek or loop wrap lands, so the reported position
+// follows what is heard rather than what is being decoded
+struct MP3PositionMark {
+    uint32_t ringSample;       // ring.totalWritten when the mark was pushed
+    uint32_t songSample;       // File sample written at that point
+};
+
+// One backing track stem. The command side sets a stem up while it is idle and
+// then marks it active; after that the SD reader owns the file and compressed
+// input, and the decode task owns everything else until it tears the stem down.
+struct MP3Player {
+    volatile bool active;
+    volatile bool stopRequested;
+    volatile bool decodeDone;      // Reached the end, the ring drains then the stem stops
+    volatile float gain;
+    volatile bool muted;
+    float appliedGain;             // Gain at the end of the last mixed buffer (ramped)
+    String filename;
+
+    MP3StreamBuffer ring;          // Decoded 44.1 kHz stereo
+    MP3StreamStats stats;
+
+    // Compressed read-ahead filled by the SD reader in whole chunks
+    File file;
+    SemaphoreHandle_t fileMutex;   // Held for each SD read and while closing
+    uint8_t* input;
+    volatile uint32_t inputWritten;
+    volatile uint32_t inputRead;
+    volatile bool inputEof;
+    volatile int32_t ioSeekOffset; // File offset the reader should restart from, -1 when none
+    uint32_t bytesPerSecond;       // Average bitrate, for read urgency
+
+    // Decoder state
+    void* decoder;                 // HMP3Decoder
+    uint8_t* decodeBuf;            // Linear window handed to MP3Decode
+    uint8_t* readPtr;
+    int bytesLeft;
+    bool needSync;                 // Unindexed files search for the first frame
+    StreamResampler resampler;
+    MP3StreamInfo info;            // Tags, Xing/VBRI header and TOC, read on open
+    MP3FrameIndex index;           // Frame offsets, or just the timing from `info` when not indexed
+    bool indexed;                  // Sample-accurate seeking (frame index or PCM cache)
+    bool timed;                    // Exact length known, so position and duration can be reported
+
+    // Decode-once copy from the PCM cache, already 44.1 kHz stereo and trimmed
+    bool pcmCached;
+    const int16_t* pcmMemory;      // PSRAM copy, or NULL when read from `file`
+    uint32_t pcmDataOffset;
+    uint32_t pcmFrames;
+
+    // Song position
+    uint32_t frame;                // Next frame to decode
+    uint32_t songSample;           // Song position of that frame at the file's rate
+    uint32_t discardUntil;         // Output before this is dropped (seek/loop preroll)
+    uint32_t trackEnd;
+    uint32_t loopStart;
+    uint32_t loopEnd;
+
+    MP3PositionMark marks[MP3_POSITION_MARKS];
+    uint8_t markHead;
+    uint8_t markCount;
+    uint32_t heardSample;          // File sample the audio task mixes next, published under the ring mutex
+};
+
 // MP3 streaming control
-extern MP3StreamBuffer mp3Buffer;
-extern volatile bool mp3Streaming;
-extern volatile float mp3Volume;
-extern TaskHandle_t mp3StreamTask;
+extern MP3Player mp3Players[MP3_MAX_STREAMS];
+extern MP3SchedulerStats mp3SchedStats;
+extern volatile bool mp3Streaming;     // Any stem active
+extern volatile float mp3Volume;       // Backing track master volume
+extern TaskHandle_t mp3DecodeTask;
+extern TaskHandle_t mp3IOTask;
 
 // Functions
 bool initMP3Streamer();
-void startMP3Stream(const char* filename);
-void stopMP3Stream();
+void startMP3Stream(const char* filename);  // Replace all stems with one track
+int startMP3Stem(const char* filename);     // Add a stem in sync with the others, returns its slot or -1
+void stopMP3Stem(int stem);
+void stopMP3Stream();                        // Stop every stem
 void setMP3Volume(float volume);
-bool readMP3Samples(int16_t* leftOut, int16_t* rightOut); // Read one stereo sample
-void mp3StreamTaskCode(void* parameter);
+void setMP3StemGain(int stem, float gain);
+void setMP3StemMute(int stem, bool muted);
+int mixMP3Samples(int32_t* mix, int frames); // Add up to `frames` stereo frames of every stem into the mix bus
+float getMP3StemLoad(const MP3Player& player); // Measured fraction of a core spent decoding the stem
+float getMP3DecodeLoad();
+bool isMP3DecoderIdle();                     // No stems, or every ring full and the decoder asleep
+void printMP3Stems();
+void mp3DecodeTaskCode(void* parameter);
+void mp3IOTaskCode(void* parameter);
+
+// Seeking and looping apply to all stems and need every stem indexed. A single
+// unindexed stream can still seek approximately with its Xing/VBRI TOC.
+// Times are seconds from the first real sample.
+bool seekMP3(float seconds);
+bool setMP3Loop(float startSeconds, float endSeconds);
+bool setMP3LoopEnabled(bool enabled);   // Loops the A/B region, or the whole track if none is set
+bool getMP3LoopRegion(float& startSeconds, float& endSeconds); // True while looping
+float getMP3PositionSeconds();          // Position of the audio currently being heard
+// The same as an output frame count at SAMPLE_RATE, for the next frame the audio
+// task mixes. False when no stem reports a position; `primed` is false while the
+// stems are still buffering and nothing is being mixed.
+bool getMP3HeardFrame(uint32_t& frame, bool& primed);
+float getMP3DurationSeconds();          // 0 until the length is known
 
 // Internal buffer management
-size_t getAvailableReadSamples();
-size_t getAvailableWriteSpace();
-void advanceReadPos(size_t samples);
-void advanceWritePos(size_t samples);
\ No newline at end of file
+size_t getAvailableReadSamples(const MP3StreamBuffer& ring);
+size_t getAvailableWriteSpace(const MP3StreamBuffer& ring);
+void advanceReadPos(MP3StreamBuffer& ring, size_t samples);
+void advanceWritePos(MP3StreamBuffer& ring, size_t samples);
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "../debug.h"
 #include "FS.h"
 #include "SD_MMC.h"
+#include "resampler.h"
 
 extern "C" {
 #include "libhelix-mp3/mp3dec.h"
@@ -301,4 +302,127 @@ void testMP3Stream(const char* filename) {
     file.close();
     
     DEBUG("=== MP3 Stream Test Complete ===");
+}
+
+void testMP3Conversion(const char* filename, float expectedSeconds) {
+    DEBUG("=== MP3 Format Conversion Test ===");
+    
+    String filepath = String(filename);
+    if (!filepath.startsWith("/")) {
+        filepath = "/" + filepath;
+    }
+    
+    File file = SD_MMC.open(filepath.c_str());
+    if (!file) {
+        DEBUGF("Failed to open MP3 file: %s\n", filepath.c_str());
+        return;
+    }
+    
+    HMP3Decoder mp3Decoder = MP3InitDecoder();
+    const size_t inputBufSize = 16384;
+    uint8_t* inputBuffer = (uint8_t*)ps_malloc(inputBufSize);
+    int16_t* outputBuffer = (int16_t*)ps_malloc(2304 * sizeof(int16_t));
+    int16_t* convertBuffer = (int16_t*)ps_malloc(RESAMPLER_MAX_OUTPUT_FRAMES * 2 * sizeof(int16_t));
+    
+    if (!mp3Decoder || !inputBuffer || !outputBuffer || !convertBuffer) {
+        DEBUG("Failed to allocate decoder or buffers");
+        if (mp3Decoder) MP3FreeDecoder(mp3Decoder);
+        if (inputBuffer) free(inputBuffer);
+        if (outputBuffer) free(outputBuffer);
+        if (convertBuffer) free(convertBuffer);
+        file.close();
+        return;
+    }
+    
+    // Decode the whole file through the same conversion path as the stream task
+    StreamResampler resampler;
+    resampler.inRate = 0;
+    uint8_t* readPtr = inputBuffer;
+    int bytesLeft = 0;
+    bool synced = false;
+    uint32_t sourceFrames = 0, outputFrames = 0, frameCount = 0;
+    uint32_t sourceRate = 0;
+    int sourceChannels = 0;
+    uint32_t convertCycles = 0, decodeCycles = 0;
+    
+    while (true) {
+        if (bytesLeft < 2000 && file.available()) {
+            memmove(inputBuffer, readPtr, bytesLeft);
+            bytesLeft += file.read(inputBuffer + bytesLeft, inputBufSize - bytesLeft);
+            readPtr = inputBuffer;
+        }
+        if (bytesLeft <= 0) break;
+        
+        if (!synced) {
+            int syncOffset = MP3FindSyncWord(readPtr, bytesLeft);
+            if (syncOffset < 0) {
+                DEBUG("No MP3 sync word found");
+                break;
+            }
+            readPtr += syncOffset;
+            bytesLeft -= syncOffset;
+            synced = true;
+        }
+        
+        uint32_t decodeStart = ESP.getCycleCount();
+        int err = MP3Decode(mp3Decoder, &readPtr, &bytesLeft, outputBuffer, 0);
+        uint32_t decodeEnd = ESP.getCycleCount();
+        if (err == ERR_MP3_INDATA_UNDERFLOW && !file.available()) break;
+        if (err != ERR_MP3_NONE) {
+            int syncOffset = MP3FindSyncWord(readPtr, bytesLeft);
+            if (syncOffset <= 0) {
+                // Skip a byte so a bad header can't stall us, or stop at the end of data
+                if (bytesLeft <= 1) break;
+                readPtr++;
+                bytesLeft--;
+            } else {
+                readPtr += syncOffset;
+                bytesLeft -= syncOffset;
+            }
+            continue;
+        }
+        
+        MP3FrameInfo frameInfo;
+        MP3GetLastFrameInfo(mp3Decoder, &frameInfo);
+        size_t frames = frameInfo.outputSamps / frameInfo.nChans;
+        const int16_t* output;
+        outputFrames += convertToOutputFormat(outputBuffer, frames, frameInfo.nChans, frameInfo.samprate,
+                                              resampler, convertBuffer, &output);
+        convertCycles += ESP.getCycleCount() - decodeEnd;
+        decodeCycles += decodeEnd - decodeStart;
+        sourceFrames += frames;
+        sourceRate = frameInfo.samprate;
+        sourceChannels = frameInfo.nChans;
+        frameCount++;
+    }
+    
+    if (frameCount == 0 || sourceRate == 0) {
+        DEBUG("No frames decoded");
+    } else {
+        float sourceSeconds = (float)sourceFrames / sourceRate;
+        float outputSeconds = (float)outputFrames / SAMPLE_RATE;
+        float tolerance = 0.005f + 4.0f / sourceRate;  // Resampler history plus rounding
+        uint32_t cyclesPerUs = ESP.getCpuFreqMHz();
+        
+        DEBUGF("Source: %lu Hz, %s, %lu frames decoded\n", (unsigned long)sourceRate,
+               sourceChannels == 1 ? "mono" : "stereo", (unsigned long)frameCount);
+        DEBUGF("Source duration: %.3f s, output duration at %d Hz: %.3f s\n",
+               sourceSeconds, SAMPLE_RATE, outputSeconds);
+        DEBUGF("Decode %.1f us/frame, convert %.1f us/frame\n",
+               (float)decodeCycles / frameCount / cyclesPerUs, (float)convertCycles / frameCount / cyclesPerUs);
+        DEBUGF("Duration preserved: %s\n", fabsf(outputSeconds - sourceSeconds) <= tolerance ? "PASS" : "FAIL");
+        if (expectedSeconds > 0.0f) {
+            // Encoder delay and padding add up to a couple of frames
+            DEBUGF("Matches expected %.3f s: %s\n", expectedSeconds,
+                   fabsf(outputSeconds - expectedSeconds) <= 0.1f ? "PASS" : "FAIL");
+        }
+    }
+    
+    free(inputBuffer);
+    free(outputBuffer);
+    free(convertBuffer);
+    MP3FreeDecoder(mp3Decoder);
+    file.close();
+    
+    DEBUG("=== MP3 Format Conversion Test Complete ===");
 }
\ No newline at end of file
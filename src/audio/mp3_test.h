@@ -1,4 +1,5 @@
 #pragma once
 
 void testMP3Decode(const char* filename);
-void testMP3Stream(const char* filename);
\ No newline at end of file
+void testMP3Stream(const char* filename);
+void testMP3Conversion(const char* filename, float expectedSeconds);
\ No newline at end of file
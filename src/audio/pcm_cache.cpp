@@ -0,0 +1,462 @@
+#include "pcm_cache.h"
+#include "../config.h"
+#include "../debug.h"
+#include "mp3_index.h"
+#include "mp3_streamer.h"
+#include "resampler.h"
+#include "SD_MMC.h"
+
+extern "C" {
+#include "libhelix-mp3/mp3dec.h"
+}
+
+#define PCM_CACHE_MAGIC       0x4D435050  // "PPCM"
+#define PCM_CACHE_VERSION     1
+#define PCM_CACHE_WRITE_BYTES 16384
+#define PCM_CACHE_READ_BYTES  8192
+#define PCM_CACHE_TEMP        PCM_CACHE_DIR "/fill.tmp"
+
+// 32 bytes so the PCM after it stays 4-byte aligned
+struct PCMCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sourceSize;       // Cache key
+    uint32_t sourceModified;   // Cache key (last write time)
+    uint32_t frames;
+    uint32_t sampleRate;
+    uint32_t reserved[2];
+};
+
+struct PSRAMTrack {
+    uint32_t pathHash;
+    uint32_t sourceSize;
+    uint32_t sourceModified;
+    uint32_t frames;
+    int16_t* data;
+};
+
+PCMCacheStats pcmCacheStats;
+volatile bool pcmCacheAuto = PCM_CACHE_AUTO;
+
+static PSRAMTrack psramTracks[PCM_CACHE_PSRAM_ENTRIES];
+static String fillQueue[PCM_CACHE_QUEUE];
+static int fillQueueCount = 0;
+static String fillingPath;
+static volatile uint32_t fillProgress = 0;     // Percent of the current fill
+static SemaphoreHandle_t pcmCacheMutex = NULL; // Guards the queue, fillingPath and the PSRAM table
+static TaskHandle_t pcmCacheTask = NULL;
+
+// FNV-1a of the path names the cache file
+static uint32_t hashPath(const char* path) {
+    uint32_t hash = 2166136261u;
+    while (*path) {
+        hash ^= (uint8_t)*path++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static String cacheFileFor(uint32_t pathHash) {
+    char name[40];
+    snprintf(name, sizeof(name), "%s/%08lx.pcm", PCM_CACHE_DIR, (unsigned long)pathHash);
+    return String(name);
+}
+
+bool initPCMCache() {
+    memset(&pcmCacheStats, 0, sizeof(pcmCacheStats));
+    memset(psramTracks, 0, sizeof(psramTracks));
+
+    pcmCacheMutex = xSemaphoreCreateMutex();
+    if (!pcmCacheMutex) {
+        DEBUG("Failed to create PCM cache mutex");
+        return false;
+    }
+
+    if (!SD_MMC.exists(PCM_CACHE_DIR)) {
+        SD_MMC.mkdir(PCM_CACHE_DIR);
+    }
+    if (SD_MMC.exists(PCM_CACHE_TEMP)) {
+        SD_MMC.remove(PCM_CACHE_TEMP);  // Fill interrupted by a reset
+    }
+
+    // Count what is already on the card
+    File dir = SD_MMC.open(PCM_CACHE_DIR);
+    if (dir && dir.isDirectory()) {
+        File file = dir.openNextFile();
+        while (file) {
+            if (!file.isDirectory()) {
+                pcmCacheStats.sdFiles++;
+                pcmCacheStats.sdBytes += file.size();
+            }
+            file = dir.openNextFile();
+        }
+        dir.close();
+    }
+
+    // Lowest priority on the decode core: it only gets the time the streamer leaves
+    BaseType_t result = xTaskCreatePinnedToCore(
+        pcmCacheTaskCode,
+        "PCMCache",
+        8192,
+        NULL,
+        1,
+        &pcmCacheTask,
+        1
+    );
+    if (result != pdPASS) {
+        DEBUGF("Failed to create PCM cache task, error: %d\n", result);
+        return false;
+    }
+
+    DEBUGF("PCM cache: %lu files (%.1f MB) on SD\n",
+           (unsigned long)pcmCacheStats.sdFiles, pcmCacheStats.sdBytes / 1048576.0f);
+    return true;
+}
+
+// Valid cached copy of the source, without touching the hit/miss counters
+static bool findCached(uint32_t pathHash, uint32_t sourceSize, uint32_t sourceModified, PCMCacheEntry& entry) {
+    xSemaphoreTake(pcmCacheMutex, portMAX_DELAY);
+    for (int i = 0; i < PCM_CACHE_PSRAM_ENTRIES; i++) {
+        const PSRAMTrack& track = psramTracks[i];
+        if (track.data && track.pathHash == pathHash && track.sourceSize == sourceSize &&
+            track.sourceModified == sourceModified) {
+            entry.memory = track.data;
+            entry.frames = track.frames;
+            entry.dataOffset = 0;
+            xSemaphoreGive(pcmCacheMutex);
+            return true;
+        }
+    }
+    xSemaphoreGive(pcmCacheMutex);
+
+    String cachePath = cacheFileFor(pathHash);
+    File file = SD_MMC.open(cachePath.c_str());
+    if (!file) return false;
+
+    PCMCacheHeader header;
+    bool valid = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header)
+                 && header.magic == PCM_CACHE_MAGIC
+                 && header.version == PCM_CACHE_VERSION
+                 && header.sourceSize == sourceSize
+                 && header.sourceModified == sourceModified
+                 && header.sampleRate == SAMPLE_RATE
+                 && file.size() >= sizeof(header) + (size_t)header.frames * 4;
+    if (!valid) {
+        file.close();
+        return false;
+    }
+
+    entry.memory = NULL;
+    entry.file = file;
+    entry.dataOffset = sizeof(header);
+    entry.frames = header.frames;
+    return true;
+}
+
+bool lookupPCMCache(const char* path, File& source, PCMCacheEntry& entry) {
+    if (!pcmCacheMutex) return false;
+    if (findCached(hashPath(path), source.size(), (uint32_t)source.getLastWrite(), entry)) {
+        pcmCacheStats.hits++;
+        return true;
+    }
+    pcmCacheStats.misses++;
+    if (pcmCacheAuto) queuePCMCacheFill(path);
+    return false;
+}
+
+bool queuePCMCacheFill(const char* path) {
+    if (!pcmCacheMutex) return false;
+    xSemaphoreTake(pcmCacheMutex, portMAX_DELAY);
+    bool queued = fillingPath == path;
+    for (int i = 0; i < fillQueueCount && !queued; i++) {
+        queued = fillQueue[i] == path;
+    }
+    if (!queued && fillQueueCount < PCM_CACHE_QUEUE) {
+        fillQueue[fillQueueCount++] = path;
+        queued = true;
+    }
+    xSemaphoreGive(pcmCacheMutex);
+
+    if (queued) xTaskNotifyGive(pcmCacheTask);
+    return queued;
+}
+
+// Claim a PSRAM slot and buffer for a track of about `frames`, or return NULL
+static int16_t* allocatePSRAMTrack(uint32_t frames) {
+    size_t bytes = (size_t)frames * 4;
+    if (pcmCacheStats.psramBytes + bytes > (size_t)PCM_CACHE_PSRAM_KB * 1024) return NULL;
+    if (pcmCacheStats.psramEntries >= PCM_CACHE_PSRAM_ENTRIES) return NULL;
+    return (int16_t*)ps_malloc(bytes);
+}
+
+// Decode one source file into the cache. Only runs while the streamer's decoder is idle.
+static bool fillTrack(const String& path) {
+    File source = SD_MMC.open(path.c_str());
+    if (!source) {
+        DEBUGF("PCM cache: can't open %s\n", path.c_str());
+        return false;
+    }
+
+    uint32_t pathHash = hashPath(path.c_str());
+    uint32_t sourceSize = source.size();
+    uint32_t sourceModified = (uint32_t)source.getLastWrite();
+    PCMCacheEntry existing;
+    if (findCached(pathHash, sourceSize, sourceModified, existing)) {
+        if (existing.file) existing.file.close();
+        source.close();
+        return true;
+    }
+
+    // With an index the cached copy starts and ends on the real samples
+    MP3FrameIndex index;
+    bool indexed = loadMP3Index(path.c_str(), source, index);
+    uint32_t firstSample = indexed ? getMP3FirstSample(index) : 0;
+    uint32_t endSample = indexed ? getMP3EndSample(index) : UINT32_MAX;
+
+    // PSRAM when the whole track fits, otherwise a file on SD
+    uint32_t capacity = 0;
+    int16_t* memory = NULL;
+    if (indexed) {
+        capacity = (uint32_t)((uint64_t)(endSample - firstSample) * SAMPLE_RATE / index.sampleRate) + 4096;
+        memory = allocatePSRAMTrack(capacity);
+    }
+    File out;
+    if (!memory) {
+        uint64_t estimate = indexed ? (uint64_t)capacity * 4 : (uint64_t)sourceSize * 12;  // ~128 kbps
+        if (pcmCacheStats.sdBytes + estimate > (uint64_t)PCM_CACHE_SD_MB * 1048576) {
+            DEBUGF("PCM cache: no SD space left for %s\n", path.c_str());
+            if (indexed) freeMP3Index(index);
+            source.close();
+            return false;
+        }
+        out = SD_MMC.open(PCM_CACHE_TEMP, FILE_WRITE);
+        if (!out) {
+            DEBUG("PCM cache: can't create cache file");
+            if (indexed) freeMP3Index(index);
+            source.close();
+            return false;
+        }
+        PCMCacheHeader header = { 0 };  // Written properly once the length is known
+        out.write((const uint8_t*)&header, sizeof(header));
+    }
+
+    HMP3Decoder decoder = MP3InitDecoder();
+    uint8_t* inputBuffer = (uint8_t*)malloc(PCM_CACHE_READ_BYTES);
+    int16_t* frameBuffer = (int16_t*)malloc(2304 * sizeof(int16_t));
+    int16_t* convertBuffer = (int16_t*)ps_malloc(RESAMPLER_MAX_OUTPUT_FRAMES * 2 * sizeof(int16_t));
+    uint8_t* writeBuffer = memory ? NULL : (uint8_t*)ps_malloc(PCM_CACHE_WRITE_BYTES);
+    bool ok = decoder && inputBuffer && frameBuffer && convertBuffer && (memory || writeBuffer);
+
+    StreamResampler resampler;
+    resampler.inRate = 0;
+    uint8_t* readPtr = inputBuffer;
+    int bytesLeft = 0;
+    bool synced = indexed;
+    uint32_t songSample = 0;
+    uint32_t frames = 0;
+    size_t writeFill = 0;
+    uint32_t started = millis();
+
+    if (ok && indexed) source.seek(index.offsets[0]);
+
+    while (ok && songSample < endSample) {
+        // Stay out of the way of playback: only decode while every stem's ring is full
+        while (!isMP3DecoderIdle()) {
+            vTaskDelay(20 / portTICK_PERIOD_MS);
+        }
+
+        if (bytesLeft < 2000 && source.available()) {
+            memmove(inputBuffer, readPtr, bytesLeft);
+            bytesLeft += source.read(inputBuffer + bytesLeft, PCM_CACHE_READ_BYTES - bytesLeft);
+            readPtr = inputBuffer;
+        }
+        if (bytesLeft <= 0) break;
+
+        if (!synced) {
+            int syncOffset = MP3FindSyncWord(readPtr, bytesLeft);
+            if (syncOffset < 0) break;
+            readPtr += syncOffset;
+            bytesLeft -= syncOffset;
+            synced = true;
+        }
+
+        int err = MP3Decode(decoder, &readPtr, &bytesLeft, frameBuffer, 0);
+        if (err == ERR_MP3_INDATA_UNDERFLOW && !source.available()) break;
+        if (err != ERR_MP3_NONE) {
+            // Skip a byte so a bad header can't stall us
+            synced = false;
+            if (bytesLeft <= 1) break;
+            readPtr++;
+            bytesLeft--;
+            continue;
+        }
+
+        MP3FrameInfo frameInfo;
+        MP3GetLastFrameInfo(decoder, &frameInfo);
+        uint32_t frameSamples = frameInfo.outputSamps / frameInfo.nChans;
+        uint32_t skip = firstSample > songSample ? min(frameSamples, firstSample - songSample) : 0;
+        uint32_t keep = endSample > songSample ? min(frameSamples, endSample - songSample) : 0;
+        songSample += frameSamples;
+        if (keep <= skip) continue;
+
+        const int16_t* output;
+        size_t outputFrames = convertToOutputFormat(frameBuffer + skip * frameInfo.nChans, keep - skip,
+                                                    frameInfo.nChans, frameInfo.samprate,
+                                                    resampler, convertBuffer, &output);
+        if (memory) {
+            outputFrames = min(outputFrames, (size_t)(capacity - frames));
+            memcpy(memory + (size_t)frames * 2, output, outputFrames * 4);
+        } else {
+            const uint8_t* bytes = (const uint8_t*)output;
+            size_t remaining = outputFrames * 4;
+            while (remaining > 0) {
+                size_t count = min(remaining, (size_t)PCM_CACHE_WRITE_BYTES - writeFill);
+                memcpy(writeBuffer + writeFill, bytes, count);
+                writeFill += count;
+                bytes += count;
+                remaining -= count;
+                if (writeFill == PCM_CACHE_WRITE_BYTES) {
+                    ok = out.write(writeBuffer, writeFill) == writeFill;
+                    writeFill = 0;
+                }
+            }
+        }
+        frames += outputFrames;
+        if (indexed) fillProgress = (uint64_t)(songSample - firstSample) * 100 / (endSample - firstSample);
+    }
+
+    if (decoder) MP3FreeDecoder(decoder);
+    if (inputBuffer) free(inputBuffer);
+    if (frameBuffer) free(frameBuffer);
+    if (convertBuffer) free(convertBuffer);
+    if (indexed) freeMP3Index(index);
+    source.close();
+    ok = ok && frames > 0;
+
+    if (memory) {
+        if (!ok) {
+            free(memory);
+            return false;
+        }
+        int16_t* trimmed = (int16_t*)ps_realloc(memory, (size_t)frames * 4);
+        if (trimmed) memory = trimmed;
+
+        xSemaphoreTake(pcmCacheMutex, portMAX_DELAY);
+        for (int i = 0; i < PCM_CACHE_PSRAM_ENTRIES; i++) {
+            if (!psramTracks[i].data) {
+                psramTracks[i] = { pathHash, sourceSize, sourceModified, frames, memory };
+                break;
+            }
+        }
+        pcmCacheStats.psramEntries++;
+        pcmCacheStats.psramBytes += frames * 4;
+        xSemaphoreGive(pcmCacheMutex);
+    } else {
+        if (ok && writeFill > 0) ok = out.write(writeBuffer, writeFill) == writeFill;
+        if (writeBuffer) free(writeBuffer);
+        if (ok) {
+            PCMCacheHeader header = { PCM_CACHE_MAGIC, PCM_CACHE_VERSION, sourceSize, sourceModified,
+                                      frames, SAMPLE_RATE, { 0, 0 } };
+            out.seek(0);
+            ok = out.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+        }
+        out.close();
+        if (!ok) {
+            SD_MMC.remove(PCM_CACHE_TEMP);
+            return false;
+        }
+
+        String cachePath = cacheFileFor(pathHash);
+        if (SD_MMC.exists(cachePath.c_str())) SD_MMC.remove(cachePath.c_str());
+        SD_MMC.rename(PCM_CACHE_TEMP, cachePath.c_str());
+        pcmCacheStats.sdFiles++;
+        pcmCacheStats.sdBytes += sizeof(PCMCacheHeader) + (uint64_t)frames * 4;
+    }
+
+    DEBUGF("PCM cache: %s decoded to %s (%.1f s) in %lu ms\n", path.c_str(), memory ? "PSRAM" : "SD",
+           (float)frames / SAMPLE_RATE, (unsigned long)(millis() - started));
+    return true;
+}
+
+void pcmCacheTaskCode(void* parameter) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (true) {
+            xSemaphoreTake(pcmCacheMutex, portMAX_DELAY);
+            if (fillQueueCount == 0) {
+                fillingPath = "";
+                xSemaphoreGive(pcmCacheMutex);
+                break;
+            }
+            String path = fillQueue[0];
+            fillingPath = path;
+            for (int i = 1; i < fillQueueCount; i++) fillQueue[i - 1] = fillQueue[i];
+            fillQueueCount--;
+            fillProgress = 0;
+            xSemaphoreGive(pcmCacheMutex);
+
+            if (fillTrack(path)) {
+                pcmCacheStats.fills++;
+            } else {
+                pcmCacheStats.fillFailures++;
+            }
+        }
+    }
+}
+
+bool clearPCMCache() {
+    if (!pcmCacheMutex) return false;
+    xSemaphoreTake(pcmCacheMutex, portMAX_DELAY);
+    if (mp3Streaming || fillingPath.length() > 0) {
+        xSemaphoreGive(pcmCacheMutex);
+        DEBUG("PCM cache is in use; stop playback and wait for fills to finish");
+        return false;
+    }
+
+    for (int i = 0; i < PCM_CACHE_PSRAM_ENTRIES; i++) {
+        if (psramTracks[i].data) free(psramTracks[i].data);
+        psramTracks[i].data = NULL;
+    }
+    pcmCacheStats.psramEntries = 0;
+    pcmCacheStats.psramBytes = 0;
+    xSemaphoreGive(pcmCacheMutex);
+
+    File dir = SD_MMC.open(PCM_CACHE_DIR);
+    if (dir && dir.isDirectory()) {
+        String names[64];
+        int count = 0;
+        File file = dir.openNextFile();
+        while (file && count < 64) {
+            if (!file.isDirectory()) names[count++] = String(PCM_CACHE_DIR) + "/" + file.name();
+            file = dir.openNextFile();
+        }
+        dir.close();
+        for (int i = 0; i < count; i++) SD_MMC.remove(names[i].c_str());
+    }
+    pcmCacheStats.sdFiles = 0;
+    pcmCacheStats.sdBytes = 0;
+
+    DEBUG("PCM cache cleared");
+    return true;
+}
+
+void printPCMCacheStatus() {
+    DEBUGF("PCM cache: %lu hits, %lu misses, %lu tracks cached (%lu failed)%s\n",
+           (unsigned long)pcmCacheStats.hits, (unsigned long)pcmCacheStats.misses,
+           (unsigned long)pcmCacheStats.fills, (unsigned long)pcmCacheStats.fillFailures,
+           pcmCacheAuto ? "" : ", auto off");
+    DEBUGF("  SD: %lu files, %.1f of %d MB; PSRAM: %lu tracks, %.1f of %d KB\n",
+           (unsigned long)pcmCacheStats.sdFiles, pcmCacheStats.sdBytes / 1048576.0f, PCM_CACHE_SD_MB,
+           (unsigned long)pcmCacheStats.psramEntries, pcmCacheStats.psramBytes / 1024.0f, PCM_CACHE_PSRAM_KB);
+    if (!pcmCacheMutex) return;
+
+    // The cache task reassigns the path between fills
+    xSemaphoreTake(pcmCacheMutex, portMAX_DELAY);
+    String filling = fillingPath;
+    int queued = fillQueueCount;
+    xSemaphoreGive(pcmCacheMutex);
+    if (filling.length() > 0) {
+        DEBUGF("  Filling %s (%lu%%), %d queued\n", filling.c_str(), (unsigned long)fillProgress, queued);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+#include "FS.h"
+
+#define PCM_CACHE_DIR "/pcmcache"
+#define PCM_CACHE_PSRAM_ENTRIES 8
+#define PCM_CACHE_QUEUE 4
+
+// Where a cached track's 44.1 kHz stereo PCM lives. The first frame is the
+// track's first real sample (encoder delay and padding already trimmed).
+struct PCMCacheEntry {
+    const int16_t* memory;     // PSRAM copy, or NULL when streamed from `file`
+    File file;
+    uint32_t dataOffset;       // Byte offset of the first frame in `file`
+    uint32_t frames;
+};
+
+struct PCMCacheStats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t fills;            // Tracks decoded into the cache
+    uint32_t fillFailures;
+    uint32_t sdFiles;
+    uint64_t sdBytes;
+    uint32_t psramEntries;
+    uint32_t psramBytes;
+};
+
+extern PCMCacheStats pcmCacheStats;
+extern volatile bool pcmCacheAuto;     // Queue tracks for caching when they miss
+
+bool initPCMCache();
+bool lookupPCMCache(const char* path, File& source, PCMCacheEntry& entry); // Counts a hit or a miss
+bool queuePCMCacheFill(const char* path);
+bool clearPCMCache();
+void printPCMCacheStatus();
+void pcmCacheTaskCode(void* parameter);
\ No newline at end of file
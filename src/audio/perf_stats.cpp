@@ -0,0 +1,79 @@
+#include "perf_stats.h"
+#include "../config.h"
+#include "../debug.h"
+#include "audio_engine.h"
+#include "mp3_streamer.h"
+#include "voice_governor.h"
+#include <math.h>
+
+AudioPerfStats perfStats;
+
+void resetPerfStats() {
+    uint32_t cpuMhz = perfStats.cpuMhz;
+    memset(&perfStats, 0, sizeof(perfStats));
+    perfStats.cpuMhz = cpuMhz;
+    masterLimiter.minGain = LIMITER_UNITY;
+    governorResetStats();
+    memset(&voiceUsage, 0, sizeof(voiceUsage));
+}
+
+uint32_t renderCpuMhz() {
+    return perfStats.cpuMhz ? perfStats.cpuMhz : ESP.getCpuFreqMHz();
+}
+
+void printPerfStats() {
+    // Snapshot so the audio task can keep updating while we print
+    AudioPerfStats stats = perfStats;
+    uint32_t cyclesPerUs = renderCpuMhz();
+    float blockUs = 1000000.0f * DMA_BUF_LEN / SAMPLE_RATE;
+
+    DEBUG("=== Audio Performance ===");
+    DEBUGF("Buffers rendered: %lu, %lu silent (%d frames, %.0f us deadline)\n",
+           (unsigned long)stats.blocks, (unsigned long)stats.idleBlocks, DMA_BUF_LEN, blockUs);
+    uint32_t buffers = stats.blocks + stats.idleBlocks;
+    if (buffers > 0) {
+        float busy = (float)stats.busyNs / 1000.0f / (buffers * blockUs);
+        DEBUGF("Audio core idle: %.1f%%, clock lowered to %d MHz for %.1f%% of buffers\n",
+               100.0f * (1.0f - busy), IDLE_CPU_MHZ, 100.0f * stats.throttledBlocks / buffers);
+    }
+    if (stats.blocks == 0) {
+        DEBUG("=== End Performance ===");
+        return;
+    }
+
+    float renderAvgUs = (float)(stats.renderCyclesTotal / stats.blocks) / cyclesPerUs;
+    float renderMaxUs = (float)stats.renderCyclesMax / cyclesPerUs;
+    DEBUGF("Render: avg %.1f us (%.1f%%), max %.1f us (%.1f%%)\n",
+           renderAvgUs, 100.0f * renderAvgUs / blockUs, renderMaxUs, 100.0f * renderMaxUs / blockUs);
+
+    float limiterAvgUs = (float)(stats.limiterCyclesTotal / stats.blocks) / cyclesPerUs;
+    float limiterMaxUs = (float)stats.limiterCyclesMax / cyclesPerUs;
+    DEBUGF("Limiter: avg %.1f us, max %.1f us per buffer, active in %lu buffers, max reduction %.1f dB\n",
+           limiterAvgUs, limiterMaxUs, (unsigned long)stats.limitedBlocks,
+           -20.0f * log10f((float)masterLimiter.minGain / LIMITER_UNITY));
+    printGovernorStatus();
+    
+    for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+        const MP3StreamStats& mp3Stats = mp3Players[i].stats;
+        if (!mp3Players[i].active || mp3Stats.framesDecoded == 0) continue;
+        DEBUGF("MP3 stem %d: %lu frames decoded, %lu underruns, min fill %.2f s\n", i,
+               (unsigned long)mp3Stats.framesDecoded, (unsigned long)mp3Stats.underruns,
+               (float)mp3Stats.minFill / SAMPLE_RATE / 2.0f);
+        float decodeUs = (float)(mp3Stats.decodeCycles / mp3Stats.framesDecoded) / cyclesPerUs;
+        float convertUs = (float)(mp3Stats.convertCycles / mp3Stats.framesDecoded) / cyclesPerUs;
+        DEBUGF("  source: %lu Hz %s, decode %.1f us/frame, convert %.1f us/frame%s, %.1f%% of a core\n",
+               (unsigned long)mp3Stats.sourceRate, mp3Stats.sourceChannels == 1 ? "mono" : "stereo",
+               decodeUs, convertUs, mp3Stats.sourceRate != SAMPLE_RATE ? " (resampling)" : "",
+               getMP3StemLoad(mp3Players[i]) * 100.0f);
+    }
+    
+    MP3SchedulerStats sched = mp3SchedStats;
+    if (sched.ioReads > 0) {
+        DEBUGF("MP3 scheduler: %lu decoder wakeups, %lu SD reads (%.1f KB avg, %lu seeks), read avg %.1f ms max %.1f ms\n",
+               (unsigned long)sched.wakeups, (unsigned long)sched.ioReads,
+               (float)(sched.ioBytes / sched.ioReads) / 1024.0f, (unsigned long)sched.ioSeeks,
+               (float)(sched.ioCycles / sched.ioReads) / cyclesPerUs / 1000.0f,
+               (float)sched.ioMaxCycles / cyclesPerUs / 1000.0f);
+    }
+    DEBUG("=== End Performance ===");
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Audio task timing, updated once per DMA buffer by the audio task
+struct AudioPerfStats {
+    uint32_t blocks;                // DMA buffers rendered since reset
+    uint32_t renderCyclesMax;       // Worst full-buffer render (voices + MP3 + limiter)
+    uint64_t renderCyclesTotal;
+    uint32_t limiterCyclesMax;      // Worst limiter pass per buffer
+    uint64_t limiterCyclesTotal;
+    uint32_t limitedBlocks;         // Buffers where the limiter reduced gain
+    uint32_t idleBlocks;            // Silent buffers written without mixing (not in `blocks`)
+    uint32_t throttledBlocks;       // Idle buffers with the CPU clock lowered
+    uint64_t busyNs;                // Audio task time spent on all buffers, rendered or idle
+    uint32_t cpuMhz;                // Clock every render runs at, set when the audio task starts
+};
+
+extern AudioPerfStats perfStats;
+
+void resetPerfStats();
+uint32_t renderCpuMhz();            // For converting render cycles, whatever the clock is right now
+void printPerfStats();
\ No newline at end of file
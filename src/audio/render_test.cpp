@@ -0,0 +1,290 @@
+#include "render_test.h"
+#include "../config.h"
+#include "../debug.h"
+#include "audio_engine.h"
+#include "interpolation.h"
+#include "mp3_streamer.h"
+#include "perf_stats.h"
+#include "sample_streamer.h"
+#include "../midi/midi_handler.h"
+#include "../midi/sequencer.h"
+#include "../midi/smf_reader.h"
+#include "../storage/instrument_manager.h"
+#include "../storage/sample.h"
+#include "FS.h"
+#include "SD_MMC.h"
+
+#define RENDER_HOLD_TIMEOUT_MS 500
+#define RENDER_STREAM_TIMEOUT_MS 2000
+
+struct RenderPerf {
+    float usPerSecond;          // Render time per second of audio
+    float worstUs;              // Slowest buffer
+    int peakVoices;
+};
+
+// Large enough to keep off the loop task's stack
+static SmfReader testSong;
+static int16_t renderOut[DMA_BUF_LEN * 2];
+static int16_t goldenIn[DMA_BUF_LEN * 2];
+
+static void writeWavHeader(File& file, uint32_t frames) {
+    uint32_t dataBytes = frames * 2 * sizeof(int16_t);
+    WAVHeader header;
+    memcpy(header.riff, "RIFF", 4);
+    header.fileSize = sizeof(header) + 8 + dataBytes - 8;
+    memcpy(header.wave, "WAVE", 4);
+    memcpy(header.fmt, "fmt ", 4);
+    header.fmtSize = 16;
+    header.audioFormat = 1;
+    header.numChannels = 2;
+    header.sampleRate = SAMPLE_RATE;
+    header.byteRate = SAMPLE_RATE * 2 * sizeof(int16_t);
+    header.blockAlign = 2 * sizeof(int16_t);
+    header.bitsPerSample = 16;
+    file.seek(0);
+    file.write((const uint8_t*)&header, sizeof(header));
+    file.write((const uint8_t*)"data", 4);
+    file.write((const uint8_t*)&dataBytes, 4);
+}
+
+// Leaves the file at the first frame, returns the frame count (0 if it isn't a 16-bit stereo WAV at SAMPLE_RATE)
+static uint32_t openGolden(File& file) {
+    WAVHeader header;
+    if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) || strncmp(header.riff, "RIFF", 4) != 0 ||
+        header.numChannels != 2 || header.bitsPerSample != 16 || header.sampleRate != SAMPLE_RATE) {
+        return 0;
+    }
+    file.seek(20 + header.fmtSize + (header.fmtSize & 1));
+    char chunkId[4];
+    uint32_t chunkSize;
+    while (file.read((uint8_t*)chunkId, 4) == 4 && file.read((uint8_t*)&chunkSize, 4) == 4) {
+        if (strncmp(chunkId, "data", 4) == 0) return chunkSize / (2 * sizeof(int16_t));
+        file.seek(file.position() + chunkSize + (chunkSize & 1));
+    }
+    return 0;
+}
+
+static bool readPerfBaseline(const String& path, RenderPerf& perf) {
+    File file = SD_MMC.open(path.c_str());
+    if (!file) return false;
+    String line = file.readStringUntil('\n');
+    file.close();
+    return sscanf(line.c_str(), "%f %f %d", &perf.usPerSecond, &perf.worstUs, &perf.peakVoices) == 3;
+}
+
+static void writePerfBaseline(const String& path, const RenderPerf& perf) {
+    File file = SD_MMC.open(path.c_str(), FILE_WRITE);
+    if (!file) return;
+    file.printf("%.1f %.1f %d\n# us of render per second of audio, worst buffer us, peak voices\n",
+                perf.usPerSecond, perf.worstUs, perf.peakVoices);
+    file.close();
+}
+
+// Plays one MIDI file into the engine a buffer at a time, each event at the
+// start of the buffer it falls in
+static bool runRenderTest(const String& name, bool record) {
+    String base = String(RENDER_TEST_DIR) + "/" + name;
+    if (!smfOpen(testSong, (base + ".mid").c_str())) return false;
+
+    File golden = SD_MMC.open((base + ".wav").c_str(), record ? FILE_WRITE : FILE_READ);
+    uint32_t goldenFrames = 0;
+    if (!golden) {
+        DEBUGF("%s: no golden WAV, run 'test record %s' first\n", name.c_str(), name.c_str());
+        smfClose(testSong);
+        return false;
+    }
+    if (record) {
+        writeWavHeader(golden, 0);
+    } else {
+        goldenFrames = openGolden(golden);
+        if (goldenFrames == 0) {
+            DEBUGF("%s: golden WAV is not 16-bit stereo at %d Hz\n", name.c_str(), SAMPLE_RATE);
+            golden.close();
+            smfClose(testSong);
+            return false;
+        }
+    }
+
+    // Same starting point every run
+    resetRoundRobin();
+    resetAudioState();
+
+    const uint32_t cpuMhz = renderCpuMhz();
+    const uint64_t tailFrames = (uint64_t)RENDER_TEST_TAIL_MS * SAMPLE_RATE / 1000;
+    const uint64_t maxFrames = (uint64_t)RENDER_TEST_MAX_SECONDS * SAMPLE_RATE;
+    uint64_t position = 0;
+    uint64_t lastEvent = 0;
+    uint64_t totalCycles = 0;
+    uint32_t worstCycles = 0;
+    int peakVoices = 0;
+    int maxDiff = 0;
+    uint32_t firstDiffFrame = 0;
+    uint32_t underruns = sampleStreamStats.underruns;
+    bool streamsLate = false;
+
+    SmfEvent event;
+    bool pending = smfNext(testSong, event);
+    while (position < maxFrames) {
+        while (pending && event.sample <= position) {
+            handleMidiMessage(event.status, event.data1, event.data2);
+            lastEvent = event.sample;
+            pending = smfNext(testSong, event);
+        }
+        peakVoices = max(peakVoices, countActiveVoices());
+
+        // Rendering runs far ahead of real time: streamed voices get their data before the buffer, untimed
+        if (!waitForVoiceStreams(RENDER_STREAM_TIMEOUT_MS)) streamsLate = true;
+
+        uint32_t start = ESP.getCycleCount();
+        uint32_t mixed = renderOffline(renderOut);
+        uint32_t cycles = ESP.getCycleCount() - start;
+        totalCycles += cycles;
+        worstCycles = max(worstCycles, cycles);
+
+        if (record) {
+            golden.write((const uint8_t*)renderOut, sizeof(renderOut));
+        } else {
+            int got = golden.read((uint8_t*)goldenIn, sizeof(goldenIn));
+            int frames = max(got, 0) / (int)(2 * sizeof(int16_t));
+            for (int i = 0; i < DMA_BUF_LEN * 2; i++) {
+                int diff = i < frames * 2 ? abs(renderOut[i] - goldenIn[i]) : abs(renderOut[i]);
+                if (diff > maxDiff) {
+                    if (maxDiff <= RENDER_TEST_TOLERANCE) firstDiffFrame = position + i / 2;
+                    maxDiff = diff;
+                }
+            }
+        }
+        position += DMA_BUF_LEN;
+
+        // A silent buffer also flushed the limiter's lookahead
+        if (!pending && (mixed == 0 || position - lastEvent > tailFrames)) break;
+    }
+    smfClose(testSong);
+    resetAudioState();
+    underruns = sampleStreamStats.underruns - underruns;
+
+    RenderPerf perf;
+    float seconds = (float)position / SAMPLE_RATE;
+    perf.usPerSecond = (float)totalCycles / cpuMhz / seconds;
+    perf.worstUs = (float)worstCycles / cpuMhz;
+    perf.peakVoices = peakVoices;
+
+    // Output that depended on SD timing is no use as a golden or against one
+    bool streamsOk = underruns == 0 && !streamsLate;
+    if (!streamsOk) {
+        DEBUGF("%s: FAIL %lu streamed sample underruns%s\n", name.c_str(), (unsigned long)underruns,
+               streamsLate ? ", SD reader fell behind" : "");
+    }
+
+    if (record) {
+        writeWavHeader(golden, position);
+        golden.close();
+        if (!streamsOk) {
+            SD_MMC.remove((base + ".wav").c_str());
+            return false;
+        }
+        writePerfBaseline(base + ".perf", perf);
+        DEBUGF("%s: recorded %.2f s, %.0f us per second, worst buffer %.0f us, %d voices\n", name.c_str(),
+               seconds, perf.usPerSecond, perf.worstUs, perf.peakVoices);
+        return true;
+    }
+    golden.close();
+
+    bool pass = streamsOk;
+    if (goldenFrames != position) {
+        DEBUGF("%s: FAIL length %lu frames, golden %lu\n", name.c_str(), (unsigned long)position,
+               (unsigned long)goldenFrames);
+        pass = false;
+    }
+    if (maxDiff > RENDER_TEST_TOLERANCE) {
+        DEBUGF("%s: FAIL output differs by up to %d (tolerance %d), first at %.3f s\n", name.c_str(), maxDiff,
+               RENDER_TEST_TOLERANCE, (float)firstDiffFrame / SAMPLE_RATE);
+        pass = false;
+    }
+
+    RenderPerf baseline;
+    if (readPerfBaseline(base + ".perf", baseline)) {
+        if (perf.usPerSecond > baseline.usPerSecond * (1.0f + RENDER_TEST_PERF_MARGIN)) {
+            DEBUGF("%s: FAIL render time %.0f us per second, baseline %.0f\n", name.c_str(), perf.usPerSecond,
+                   baseline.usPerSecond);
+            pass = false;
+        }
+        if (perf.worstUs > baseline.worstUs * (1.0f + RENDER_TEST_WORST_MARGIN)) {
+            DEBUGF("%s: FAIL worst buffer %.0f us, baseline %.0f\n", name.c_str(), perf.worstUs, baseline.worstUs);
+            pass = false;
+        }
+        if (perf.peakVoices > baseline.peakVoices) {
+            DEBUGF("%s: FAIL %d voices at once, baseline %d\n", name.c_str(), perf.peakVoices, baseline.peakVoices);
+            pass = false;
+        }
+    } else {
+        DEBUGF("%s: no perf baseline, timing not checked\n", name.c_str());
+    }
+
+    DEBUGF("%s: %s %.2f s, %.0f us per second (%.1f%% CPU), worst buffer %.0f us, %d voices, max diff %d\n",
+           name.c_str(), pass ? "PASS" : "FAIL", seconds, perf.usPerSecond, perf.usPerSecond / 10000.0f,
+           perf.worstUs, perf.peakVoices, maxDiff);
+    return pass;
+}
+
+int runRenderTests(const char* name, bool record) {
+    if (mp3Streaming) {
+        DEBUG("Stop the MP3 stems before running render tests");
+        return 1;
+    }
+    if (isSequencerPlaying()) {
+        DEBUG("Stop the MIDI file before running render tests");
+        return 1;
+    }
+    if (!holdAudioTask(RENDER_HOLD_TIMEOUT_MS)) {
+        DEBUG("Audio task did not pause");
+        return 1;
+    }
+
+    // The held task may have been idle-throttled: time every run at the clock the baselines assume
+    uint32_t heldMhz = ESP.getCpuFreqMHz();
+    if (heldMhz != renderCpuMhz()) setCpuFrequencyMhz(renderCpuMhz());
+
+    // Every zone resident and default playback settings, so a run never depends on what came before
+    int missing = loadAllZones();
+    if (missing > 0) DEBUGF("%d zones failed to load, their notes will be missing\n", missing);
+    float volume = sampleVolume;
+    InterpMode interp = interpOverride;
+    sampleVolume = 1.0f;
+    interpOverride = INTERP_MODE_COUNT;
+
+    int run = 0;
+    int failed = 0;
+    if (name) {
+        run = 1;
+        if (!runRenderTest(name, record)) failed++;
+    } else {
+        File dir = SD_MMC.open(RENDER_TEST_DIR);
+        if (!dir || !dir.isDirectory()) {
+            DEBUGF("No render tests (%s not found)\n", RENDER_TEST_DIR);
+        } else {
+            File file = dir.openNextFile();
+            while (file) {
+                String test = file.name();
+                bool song = !file.isDirectory() && test.endsWith(".mid");
+                file.close();
+                if (song) {
+                    // Names may come back with the directory in front
+                    test = test.substring(test.lastIndexOf('/') + 1, test.length() - 4);
+                    run++;
+                    if (!runRenderTest(test, record)) failed++;
+                }
+                file = dir.openNextFile();
+            }
+            dir.close();
+        }
+    }
+
+    sampleVolume = volume;
+    interpOverride = interp;
+    if (heldMhz != renderCpuMhz()) setCpuFrequencyMhz(heldMhz);   // The audio task still counts itself throttled
+    releaseAudioTask();
+    DEBUGF("Render tests: %d %s, %d failed\n", run, record ? "recorded" : "run", failed);
+    return failed;
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Offline MIDI file renders compared against golden WAVs and perf baselines
+// (see RENDER_TEST_DIR in config.h). `name` picks one test, NULL runs them all.
+// Recording writes new goldens instead. Returns the number of failed tests.
+int runRenderTests(const char* name, bool record);
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "resampler.h"
+#include "../config.h"
+#include "interpolation.h"
+
+void resamplerInit(StreamResampler& resampler, uint32_t inRate, uint32_t outRate) {
+    resampler.inRate = inRate;
+    // Fixed point so the rate stays exact over a whole track
+    resampler.step = ((uint64_t)inRate << 32) / outRate;
+    resampler.phase = 0;
+    memset(resampler.history, 0, sizeof(resampler.history));
+}
+
+static inline int16_t clampSample(float value) {
+    return (int16_t)constrain(value, -32768.0f, 32767.0f);
+}
+
+// Frame n of the virtual stream history[0..2] followed by in[]
+static inline const int16_t* streamFrame(const StreamResampler& resampler, const int16_t* in, int32_t n) {
+    return n < 3 ? resampler.history + n * 2 : in + (n - 3) * 2;
+}
+
+size_t resamplerProcess(StreamResampler& resampler, const int16_t* in, size_t inFrames,
+                        int16_t* out, size_t maxOutFrames) {
+    const int32_t streamFrames = (int32_t)inFrames + 3;
+    // Hermite reads one frame behind and two ahead, so start at history[1]
+    uint64_t position = resampler.phase + (1ULL << 32);
+    size_t produced = 0;
+
+    while (produced < maxOutFrames) {
+        int32_t pos = (int32_t)(position >> 32);
+        if (pos + 2 >= streamFrames) break;
+
+        const float* c = hermiteTable[(uint32_t)position / (0x100000000ULL / INTERP_PHASES)];
+        const int16_t* x0 = streamFrame(resampler, in, pos - 1);
+        const int16_t* x1 = streamFrame(resampler, in, pos);
+        const int16_t* x2 = streamFrame(resampler, in, pos + 1);
+        const int16_t* x3 = streamFrame(resampler, in, pos + 2);
+
+        out[produced * 2] = clampSample(c[0] * x0[0] + c[1] * x1[0] + c[2] * x2[0] + c[3] * x3[0]);
+        out[produced * 2 + 1] = clampSample(c[0] * x0[1] + c[1] * x1[1] + c[2] * x2[1] + c[3] * x3[1]);
+        produced++;
+        position += resampler.step;
+    }
+
+    // Keep the last three frames and rebase the position onto them
+    for (int i = 0; i < 3; i++) {
+        const int16_t* frame = streamFrame(resampler, in, streamFrames - 3 + i);
+        resampler.history[i * 2] = frame[0];
+        resampler.history[i * 2 + 1] = frame[1];
+    }
+    resampler.phase = position - ((uint64_t)(streamFrames - 2) << 32);
+
+    return produced;
+}
+
+size_t convertToOutputFormat(int16_t* pcm, size_t frames, int channels, uint32_t sampleRate,
+                             StreamResampler& resampler, int16_t* scratch, const int16_t** output) {
+    if (channels == 1) {
+        // Back to front so the upmix can share the decode buffer
+        for (size_t i = frames; i-- > 0;) {
+            pcm[i * 2] = pcm[i];
+            pcm[i * 2 + 1] = pcm[i];
+        }
+    }
+
+    if (sampleRate == SAMPLE_RATE) {
+        *output = pcm;
+        return frames;
+    }
+
+    if (resampler.inRate != sampleRate) {
+        resamplerInit(resampler, sampleRate, SAMPLE_RATE);
+    }
+    *output = scratch;
+    return resamplerProcess(resampler, pcm, frames, scratch, RESAMPLER_MAX_OUTPUT_FRAMES);
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Longest converted MP3 frame: 576 samples at 8 kHz stretched to 44.1 kHz
+#define RESAMPLER_MAX_OUTPUT_FRAMES 3200
+
+// Streaming stereo resampler using the 4-point Hermite table. The last three
+// input frames are carried between calls so frame boundaries are seamless.
+struct StreamResampler {
+    uint32_t inRate;
+    uint64_t step;          // Input frames advanced per output frame (Q32.32)
+    uint64_t phase;         // Read position relative to the carried history (Q32.32)
+    int16_t history[3 * 2];
+};
+
+void resamplerInit(StreamResampler& resampler, uint32_t inRate, uint32_t outRate);
+size_t resamplerProcess(StreamResampler& resampler, const int16_t* in, size_t inFrames,
+                        int16_t* out, size_t maxOutFrames);
+
+// Upmix mono in place (pcm needs room for frames * 2 samples) and resample to
+// SAMPLE_RATE when needed. Points `output` at the converted stereo frames.
+size_t convertToOutputFormat(int16_t* pcm, size_t frames, int channels, uint32_t sampleRate,
+                             StreamResampler& resampler, int16_t* scratch, const int16_t** output);
\ No newline at end of file
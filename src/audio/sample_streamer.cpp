@@ -0,0 +1,289 @@
+#include "sample_streamer.h"
+#include "../debug.h"
+#include "audio_engine.h"
+#include "../utils/trace.h"
+#include "SD_MMC.h"
+
+#define STREAM_RING_BYTES ((STREAM_RING_FRAMES + STREAM_GUARD_FRAMES) * 2 * sizeof(int16_t))
+
+static_assert(STREAM_CHUNK_FRAMES * 2 <= STREAM_RING_FRAMES, "The ring must hold at least two chunks");
+static_assert(STREAM_GUARD_FRAMES <= STREAM_RING_FRAMES, "The mirrored guard can't exceed the ring");
+
+VoiceStream voiceStreams[MAX_POLYPHONY];
+SampleStreamStats sampleStreamStats;
+TaskHandle_t sampleStreamTask = NULL;
+
+static int16_t* stagingBuffer = NULL;          // One chunk, copied into the ring once read
+
+// Streamed sample files kept open by the reader, least recently used replaced first
+struct OpenSampleFile {
+    const Sample* sample;
+    File file;
+    uint32_t lastUsed;
+};
+static OpenSampleFile openFiles[STREAM_OPEN_FILES];
+static uint32_t openCounter = 0;
+
+bool initSampleStreamer() {
+    resetSampleStreamStats();
+
+    stagingBuffer = (int16_t*)malloc(STREAM_CHUNK_FRAMES * 2 * sizeof(int16_t));  // Internal RAM for SD DMA
+    if (!stagingBuffer) {
+        DEBUG("Failed to allocate sample streamer buffers");
+        return false;
+    }
+
+    for (int i = 0; i < MAX_POLYPHONY; i++) {
+        VoiceStream& stream = voiceStreams[i];
+        stream.ring = (int16_t*)ps_malloc(STREAM_RING_BYTES);
+        if (!stream.ring) {
+            DEBUG("Failed to allocate sample stream rings");
+            return false;
+        }
+        stream.sample = NULL;
+        stream.generation = 0;
+        stream.requested = 0;
+        stream.stopped = 0;
+        stream.active = false;
+    }
+
+    // Above the MP3 reader: voices have far less buffered than the backing track
+    BaseType_t result = xTaskCreatePinnedToCore(
+        sampleStreamTaskCode,
+        "SampleIO",
+        4096,
+        NULL,
+        4,
+        &sampleStreamTask,
+        1
+    );
+    if (result != pdPASS) {
+        DEBUGF("Failed to create sample stream task, error: %d\n", result);
+        sampleStreamTask = NULL;
+        return false;
+    }
+
+    DEBUGF("Sample streamer: %d voice rings of %d ms (%d KB PSRAM)\n", MAX_POLYPHONY,
+           STREAM_RING_FRAMES * 1000 / SAMPLE_RATE, (int)(MAX_POLYPHONY * STREAM_RING_BYTES / 1024));
+    return true;
+}
+
+void startVoiceStream(int voice, Sample* sample, float speed) {
+    if (!sampleStreamTask || voice < 0 || voice >= MAX_POLYPHONY) return;
+    VoiceStream& stream = voiceStreams[voice];
+    stream.requestSample = sample;
+    stream.requestSpeed = speed;
+    stream.requested++;            // Published last; the reader resets the ring
+    sampleStreamStats.starts++;
+    xTaskNotifyGive(sampleStreamTask);
+}
+
+void stopVoiceStream(int voice) {
+    if (voice < 0 || voice >= MAX_POLYPHONY) return;
+    VoiceStream& stream = voiceStreams[voice];
+    stream.stopped = stream.requested;
+    stream.active = false;
+}
+
+const int16_t* getStreamWindow(int voice, uint32_t first, uint32_t count) {
+    VoiceStream& stream = voiceStreams[voice];
+    if (stream.generation != stream.requested) return NULL;  // Reader hasn't reset the ring yet
+    if (count > STREAM_GUARD_FRAMES || first < stream.readFrame) return NULL;
+    if (first + count > stream.writeFrame) return NULL;
+
+    stream.readFrame = first;
+    uint32_t room = STREAM_RING_FRAMES - (stream.writeFrame - first);
+    if (room >= STREAM_CHUNK_FRAMES && stream.writeFrame < stream.endFrame) {
+        xTaskNotifyGive(sampleStreamTask);
+    }
+    return stream.ring + (first % STREAM_RING_FRAMES) * 2;
+}
+
+static File* openSampleFile(const Sample* sample) {
+    int slot = 0;
+    for (int i = 0; i < STREAM_OPEN_FILES; i++) {
+        if (openFiles[i].sample == sample && openFiles[i].file) {
+            openFiles[i].lastUsed = ++openCounter;
+            return &openFiles[i].file;
+        }
+        if (openFiles[i].lastUsed < openFiles[slot].lastUsed) slot = i;
+    }
+
+    OpenSampleFile& entry = openFiles[slot];
+    if (entry.file) entry.file.close();
+    String path = sample->filename;
+    if (!path.startsWith("/")) path = "/" + path;
+    entry.file = SD_MMC.open(path.c_str());
+    if (!entry.file) {
+        DEBUGQF("Failed to open streamed sample %s\n", path.c_str());
+        entry.sample = NULL;
+        entry.lastUsed = 0;
+        return NULL;
+    }
+    entry.sample = sample;
+    entry.lastUsed = ++openCounter;
+    return &entry.file;
+}
+
+// Copy frames into the ring, mirroring the first STREAM_GUARD_FRAMES past its end
+static void writeRing(VoiceStream& stream, uint32_t frame, const int16_t* src, uint32_t frames) {
+    while (frames > 0) {
+        uint32_t index = frame % STREAM_RING_FRAMES;
+        uint32_t count = min(frames, (uint32_t)STREAM_RING_FRAMES - index);
+        memcpy(stream.ring + index * 2, src, count * 2 * sizeof(int16_t));
+        if (index < STREAM_GUARD_FRAMES) {
+            uint32_t mirrored = min(count, (uint32_t)STREAM_GUARD_FRAMES - index);
+            memcpy(stream.ring + (STREAM_RING_FRAMES + index) * 2, src, mirrored * 2 * sizeof(int16_t));
+        }
+        frame += count;
+        src += count * 2;
+        frames -= count;
+    }
+}
+
+// Frames a stream can take now, 0 when it is full or finished
+static uint32_t chunkRoom(const VoiceStream& stream) {
+    if (!stream.active || stream.writeFrame >= stream.endFrame) return 0;
+    uint32_t frames = min((uint32_t)STREAM_CHUNK_FRAMES, stream.endFrame - stream.writeFrame);
+    uint32_t buffered = stream.writeFrame - stream.readFrame;
+    return buffered + frames <= STREAM_RING_FRAMES ? frames : 0;
+}
+
+// The voice that will run out soonest, counting the resident head it is still playing
+static int nextStream(uint32_t& leadMs) {
+    int best = -1;
+    float bestMs = 0.0f;
+    for (int i = 0; i < MAX_POLYPHONY; i++) {
+        const VoiceStream& stream = voiceStreams[i];
+        if (chunkRoom(stream) == 0) continue;
+        float rate = stream.sample->sampleRate * max(stream.speed, 0.01f);
+        float ms = max(0.0f, stream.writeFrame - voices[i].positionFloat) * 1000.0f / rate;
+        if (best < 0 || ms < bestMs) {
+            best = i;
+            bestMs = ms;
+        }
+    }
+    leadMs = (uint32_t)bestMs;
+    return best;
+}
+
+// Take up note on and note end requests (reader task only)
+static void applyRequests() {
+    for (int i = 0; i < MAX_POLYPHONY; i++) {
+        VoiceStream& stream = voiceStreams[i];
+        uint32_t requested = stream.requested;
+        if (stream.generation == requested) continue;
+        stream.active = false;
+        stream.sample = stream.requestSample;
+        stream.speed = stream.requestSpeed;
+        uint32_t start = stream.sample->headLength - STREAM_HEAD_OVERLAP;
+        stream.writeFrame = start;
+        stream.readFrame = start;
+        stream.endFrame = stream.sample->length + SAMPLE_PAD_FRAMES;  // Silence after the end for the taps
+        stream.active = stream.stopped != requested;
+        stream.generation = requested;     // Published last; the voice can read from here on
+    }
+}
+
+static void readChunk(int voice) {
+    VoiceStream& stream = voiceStreams[voice];
+    const Sample* sample = stream.sample;
+    uint32_t generation = stream.generation;
+    uint32_t frame = stream.writeFrame;
+    uint32_t frames = chunkRoom(stream);
+    if (frames == 0) return;
+
+    // Past the end of the sample the ring gets silence for the interpolation taps
+    uint32_t fileFrames = frame < sample->length ? min(frames, sample->length - frame) : 0;
+    uint32_t bytesPerFrame = sample->fileChannels * sizeof(int16_t);
+    uint32_t got = 0;
+    uint32_t start = micros();
+    File* file = fileFrames > 0 ? openSampleFile(sample) : NULL;
+    if (file && file->seek(sample->dataOffset + frame * bytesPerFrame)) {
+        got = file->read((uint8_t*)stagingBuffer, fileFrames * bytesPerFrame) / bytesPerFrame;
+    }
+    uint32_t elapsed = micros() - start;
+
+    if (sample->fileChannels == 1) {
+        // Upmix in place, back to front
+        for (int i = (int)got - 1; i >= 0; i--) {
+            int16_t value = stagingBuffer[i];
+            stagingBuffer[i * 2] = value;
+            stagingBuffer[i * 2 + 1] = value;
+        }
+    }
+    memset(stagingBuffer + got * 2, 0, (frames - got) * 2 * sizeof(int16_t));
+
+    // Dropped if the voice was restarted or finished while reading. A restart
+    // that lands during the copy is safe: the voice can't read until the next
+    // applyRequests() resets the ring.
+    if (stream.active && stream.requested == generation) {
+        writeRing(stream, frame, stagingBuffer, frames);
+        stream.writeFrame = frame + frames;
+        trace(TRACE_STREAM_FILL, voice, stream.writeFrame - (uint32_t)voices[voice].positionFloat);
+    }
+    trace(TRACE_SD_READ, TRACE_SRC_SAMPLE_STREAM, elapsed);
+
+    sampleStreamStats.reads++;
+    sampleStreamStats.bytes += got * bytesPerFrame;
+    if (elapsed > sampleStreamStats.maxReadUs) sampleStreamStats.maxReadUs = elapsed;
+}
+
+bool waitForVoiceStreams(uint32_t timeoutMs) {
+    if (!sampleStreamTask) return true;
+    uint32_t start = millis();
+    while (true) {
+        bool ready = true;
+        for (int i = 0; i < MAX_POLYPHONY && ready; i++) {
+            const VoiceStream& stream = voiceStreams[i];
+            uint32_t requested = stream.requested;
+            if (stream.stopped == requested) continue;    // Ended, or never started
+            ready = stream.generation == requested && chunkRoom(stream) == 0;
+        }
+        if (ready) return true;
+        if (millis() - start >= timeoutMs) return false;
+        xTaskNotifyGive(sampleStreamTask);
+        vTaskDelay(1);
+    }
+}
+
+void sampleStreamTaskCode(void* parameter) {
+    DEBUG("Sample stream task started");
+    while (true) {
+        applyRequests();
+        uint32_t leadMs;
+        int next = nextStream(leadMs);
+        if (next < 0) {
+            // Woken by note on and by voices that have made room for a chunk
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(20));
+            continue;
+        }
+        if (leadMs < sampleStreamStats.minLeadMs) sampleStreamStats.minLeadMs = leadMs;
+        readChunk(next);
+    }
+}
+
+void resetSampleStreamStats() {
+    memset(&sampleStreamStats, 0, sizeof(sampleStreamStats));
+    sampleStreamStats.minLeadMs = UINT32_MAX;
+}
+
+void printSampleStreamStats() {
+    if (!sampleStreamTask) {
+        DEBUG("Sample streaming: not available");
+        return;
+    }
+    DEBUGF("Sample streaming: %lu notes, %lu reads (%.1f MB), slowest read %lu us, %lu underruns\n",
+           (unsigned long)sampleStreamStats.starts, (unsigned long)sampleStreamStats.reads,
+           sampleStreamStats.bytes / 1048576.0f, (unsigned long)sampleStreamStats.maxReadUs,
+           (unsigned long)sampleStreamStats.underruns);
+    if (sampleStreamStats.minLeadMs != UINT32_MAX) {
+        DEBUGF("  Least audio buffered when served: %lu ms\n", (unsigned long)sampleStreamStats.minLeadMs);
+    }
+    for (int i = 0; i < MAX_POLYPHONY; i++) {
+        const VoiceStream& stream = voiceStreams[i];
+        if (!stream.active) continue;
+        DEBUGF("  Voice %d: %s, %lu frames buffered\n", i, stream.sample->filename.c_str(),
+               (unsigned long)(stream.writeFrame - stream.readFrame));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../config.h"
+#include "../storage/sample.h"
+
+// Frames mirrored past the end of each ring so a render block never sees the wrap.
+// Covers one envelope block at up to ~15x speed plus the sinc taps.
+#define STREAM_GUARD_FRAMES   512
+
+// The ring starts this far before the end of the head, so a voice can switch
+// over mid-block without its interpolation taps leaving the buffered range
+#define STREAM_HEAD_OVERLAP   (STREAM_GUARD_FRAMES + 16)
+
+// Ring of one voice's streamed frames. Only the reader task resets and fills
+// it; note on posts a request the reader picks up before its next read, so
+// neither the control side nor the audio task ever waits on SD.
+struct VoiceStream {
+    int16_t* ring;                 // STREAM_RING_FRAMES stereo frames plus the mirrored guard (PSRAM)
+    Sample* sample;
+    float speed;                   // Playback stride, for read urgency
+    uint32_t generation;           // Request the ring currently holds
+    volatile bool active;
+    volatile uint32_t writeFrame;  // Sample frame one past the last buffered
+    volatile uint32_t readFrame;   // Oldest frame the voice can still read
+    uint32_t endFrame;             // Sample length plus silent guard frames
+
+    // Posted by startVoiceStream/stopVoiceStream
+    Sample* volatile requestSample;
+    volatile float requestSpeed;
+    volatile uint32_t requested;   // Bumped for each note on
+    volatile uint32_t stopped;     // Request that has since ended
+};
+
+struct SampleStreamStats {
+    uint32_t starts;
+    uint32_t reads;                // Chunks read from SD
+    uint64_t bytes;
+    uint32_t maxReadUs;
+    uint32_t underruns;            // Blocks a voice waited because its data wasn't buffered yet
+    uint32_t minLeadMs;            // Least audio any voice had buffered when served
+};
+
+extern VoiceStream voiceStreams[MAX_POLYPHONY];
+extern SampleStreamStats sampleStreamStats;
+extern TaskHandle_t sampleStreamTask;
+
+bool initSampleStreamer();
+void startVoiceStream(int voice, Sample* sample, float speed);  // Reading starts just before the end of the head
+void stopVoiceStream(int voice);                                // When the voice ends
+
+// Pointer to `count` contiguous stereo frames starting at sample frame `first`,
+// or NULL when they haven't been read yet. Frames before `first` are released.
+const int16_t* getStreamWindow(int voice, uint32_t first, uint32_t count);
+
+// Offline renders: waits until every playing stream's ring is as full as it
+// gets, so the next buffer can't underrun. False on timeout.
+bool waitForVoiceStreams(uint32_t timeoutMs);
+
+void printSampleStreamStats();
+void resetSampleStreamStats();
+void sampleStreamTaskCode(void* parameter);
\ No newline at end of file
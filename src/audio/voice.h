@@ -1,24 +1,47 @@
 #pragma once
 
 #include <Arduino.h>
+#include "envelope.h"
+#include "interpolation.h"
 
 struct Sample; // Forward declaration
 
+// Everything the renderer needs to start a note
+struct NoteStart {
+    Sample* sample;
+    float amplitude;
+    float speed;
+    uint8_t mipLevel;
+    InterpMode interp;
+    EnvelopeSettings envelope;
+    uint8_t delay;              // Frames into the first envelope block the note starts
+};
+
+// Render state, read and written by the audio task every block (hot). Whether
+// a voice is playing lives in activeVoiceMask, not here.
 struct Voice {
     Sample* sample;         // Pointer to the sample being played
-    uint32_t position;      // Current playback position
     float positionFloat;    // Precise position for pitch shifting
-    bool isActive;          // Whether this voice is playing
+    float speed;            // Playback stride within the selected mip level (1.0 = normal)
+    float baseSpeed;        // Stride before the channel's bend and vibrato
+    float amplitude;        // Current amplitude
+    uint8_t mipLevel;       // Which band-limited copy of the sample is read
+    InterpMode interp;      // Interpolation kernel chosen at note on
+    volatile bool noteOff;  // Set by noteOff(), picked up by the audio task at the next block
+    volatile bool restart;  // A stolen voice is restarted by the audio task at its next block
+    uint8_t startDelay;     // Frames of the next block to leave silent (sequenced note on)
+    bool shedding;          // Cut by the governor: fades to silence over its next block, then ends
+
+    // ADSR envelope, evaluated once per ENV_BLOCK_SIZE frames
+    Envelope env;
+};
+
+// Note bookkeeping, used by note off and voice allocation (cold)
+struct VoiceInfo {
     uint8_t midiNote;       // MIDI note for this voice
     uint8_t velocity;       // MIDI velocity
-    float amplitude;        // Current amplitude
-    float speed;            // Playback speed (1.0 = normal)
-    
-    // Simple ADSR envelope
-    enum EnvState { ATTACK, DECAY, SUSTAIN, RELEASE, IDLE };
-    EnvState envState;
-    float envValue;
-    float envTarget;
-    float envRate;
-    bool noteOff;
+    uint8_t channel;        // MIDI channel (0-15) that started the note
+    bool sustained;         // Key released with the pedal down, released when the pedal lifts
+    uint32_t startOrder;    // Allocation counter, the oldest voice is stolen first
+    NoteStart pending;      // Next note for a stolen voice, applied with `restart`
 };
\ No newline at end of file
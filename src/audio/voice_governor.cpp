@@ -0,0 +1,82 @@
+#include "voice_governor.h"
+#include "../debug.h"
+
+VoiceGovernor voiceGovernor;
+
+#define BLOCKS_PER_BUFFER (DMA_BUF_LEN / ENV_BLOCK_SIZE)
+
+// Cost estimates follow a rise almost at once and a fall slowly, like a peak meter
+#define COST_ATTACK  0.5f
+#define COST_RELEASE 0.05f
+
+static_assert(POLYPHONY_FLOOR >= 1 && POLYPHONY_FLOOR <= POLYPHONY_START && POLYPHONY_START <= MAX_POLYPHONY,
+              "Polyphony budget limits out of order");
+
+void governorInit() {
+    voiceGovernor.budget = POLYPHONY_START;
+    voiceGovernor.raiseCountdown = GOVERNOR_RAISE_BUFFERS;
+    voiceGovernor.deadlineCycles = (uint32_t)((uint64_t)ESP.getCpuFreqMHz() * 1000000 * DMA_BUF_LEN / SAMPLE_RATE);
+    voiceGovernor.voiceBlockCycles = 0.0f;
+    voiceGovernor.fixedCycles = 0.0f;
+    governorResetStats();
+}
+
+void governorResetStats() {
+    voiceGovernor.lowestBudget = voiceGovernor.budget;
+    voiceGovernor.raises = 0;
+    voiceGovernor.cuts = 0;
+    voiceGovernor.shed = 0;
+}
+
+static float smoothCost(float estimate, float measured) {
+    if (estimate <= 0.0f) return measured;
+    return estimate + (measured - estimate) * (measured > estimate ? COST_ATTACK : COST_RELEASE);
+}
+
+void governorUpdate(uint32_t voiceCycles, uint32_t voiceBlocks, uint32_t otherCycles) {
+    VoiceGovernor& g = voiceGovernor;
+    if (voiceBlocks > 0) {
+        g.voiceBlockCycles = smoothCost(g.voiceBlockCycles, (float)voiceCycles / voiceBlocks);
+    }
+    g.fixedCycles = smoothCost(g.fixedCycles, (float)otherCycles);
+    if (g.voiceBlockCycles <= 0.0f) return;
+
+    // Voices that fit in the target share of the deadline next to the fixed work
+    float spare = g.deadlineCycles * GOVERNOR_TARGET_LOAD - g.fixedCycles;
+    int fit = spare > 0.0f ? (int)(spare / (g.voiceBlockCycles * BLOCKS_PER_BUFFER)) : 0;
+    fit = constrain(fit, POLYPHONY_FLOOR, MAX_POLYPHONY);
+
+    if (fit < g.budget) {
+        g.budget = fit;
+        g.cuts++;
+        g.raiseCountdown = GOVERNOR_RAISE_BUFFERS;
+        if (fit < g.lowestBudget) g.lowestBudget = fit;
+    } else if (fit > g.budget && --g.raiseCountdown == 0) {
+        // One voice at a time, so a cost spike is measured before the budget overshoots
+        g.budget++;
+        g.raises++;
+        g.raiseCountdown = GOVERNOR_RAISE_BUFFERS;
+    }
+}
+
+int governorOverload(uint32_t elapsedCycles, int blocksLeft, int activeVoices) {
+    const VoiceGovernor& g = voiceGovernor;
+    if (g.voiceBlockCycles <= 0.0f || blocksLeft <= 0 || activeVoices == 0) return 0;
+
+    float perVoice = g.voiceBlockCycles * blocksLeft;
+    float projected = elapsedCycles + activeVoices * perVoice + g.fixedCycles;
+    float limit = g.deadlineCycles * GOVERNOR_SHED_LOAD;
+    if (projected <= limit) return 0;
+    return min(activeVoices, (int)ceilf((projected - limit) / perVoice));
+}
+
+void printGovernorStatus() {
+    const VoiceGovernor& g = voiceGovernor;
+    float cyclesPerUs = g.deadlineCycles * (float)SAMPLE_RATE / DMA_BUF_LEN / 1000000.0f;
+    DEBUGF("Voice budget: %d of %d (lowest %d), %lu raises, %lu cuts, %lu voices shed\n", g.budget, MAX_POLYPHONY,
+           g.lowestBudget, (unsigned long)g.raises, (unsigned long)g.cuts, (unsigned long)g.shed);
+    if (g.voiceBlockCycles > 0.0f) {
+        DEBUGF("  Cost: %.2f us per voice block, %.1f us fixed per buffer\n",
+               g.voiceBlockCycles / cyclesPerUs, g.fixedCycles / cyclesPerUs);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../config.h"
+
+// Voice budget sized from measured render cost. The audio task reports each
+// buffer's timing; the budget limits new voices and tells the task when to
+// shed voices before a buffer misses its deadline.
+struct VoiceGovernor {
+    volatile uint8_t budget;        // Voices allowed to play at once
+    uint8_t lowestBudget;           // Since the last reset
+    uint16_t raiseCountdown;        // Buffers until the budget may grow again
+    uint32_t deadlineCycles;        // CPU cycles in one DMA buffer of audio
+    float voiceBlockCycles;         // Smoothed cost of one voice for one envelope block, 0 until measured
+    float fixedCycles;              // Smoothed per-buffer cost of everything else (MP3, limiter)
+    uint32_t raises;
+    uint32_t cuts;
+    uint32_t shed;                  // Voices cut to protect a deadline or the budget
+};
+
+extern VoiceGovernor voiceGovernor;
+
+void governorInit();
+void governorResetStats();
+
+// Once per buffer: cycles spent mixing voices, voice blocks mixed, and everything else
+void governorUpdate(uint32_t voiceCycles, uint32_t voiceBlocks, uint32_t otherCycles);
+
+// Voices to drop before the next envelope block so the buffer still ends in time
+int governorOverload(uint32_t elapsedCycles, int blocksLeft, int activeVoices);
+
+void printGovernorStatus();
\ No newline at end of file
@@ -5,9 +5,20 @@
 
 // Audio configuration
 #define SAMPLE_RATE           44100
-#define MAX_POLYPHONY         8           
-#define MAX_SAMPLES           16          
+#define MAX_POLYPHONY         24          // Voice pool; the governor decides how many may play at once
+#define MAX_SAMPLES           64          // Loaded sample pool shared by every instrument
 #define MAX_INSTRUMENTS       4           // Maximum number of instruments
+#define MAX_ZONES             128         // Zones defined per instrument (loaded lazily)
+#define MAX_VELOCITY_LAYERS   8           // Distinct velocity ranges per instrument
+#define MIDI_CHANNELS         16          // Each channel plays its own instrument from the shared voice pool
+#define SAMPLE_MIP_LEVELS     3           // Extra half-rate copies built for pitched-up samples (0 = off)
+#define MIP_SWITCH_RATIO      1.414f      // Playback speed at which a voice moves to the next mip level
+
+// MIDI controllers, ramped once per envelope block
+#define PITCH_BEND_SEMITONES  2.0f        // Bend range either way
+#define MOD_VIBRATO_CENTS     50.0f       // Vibrato depth with the mod wheel fully up
+#define MOD_VIBRATO_HZ        5.5f
+#define CONTROL_SMOOTHING_MS  5.0f        // Time constant of the bend and mod wheel ramps
 
 // I2S pins for UDA1334A DAC
 #define I2S_BCLK_PIN    5
@@ -35,6 +46,85 @@
 // Audio settings
 #define DMA_BUF_LEN     256
 #define DMA_NUM_BUF     8
+#define ENV_BLOCK_SIZE  32          // Frames per envelope step (must divide DMA_BUF_LEN)
+
+// Master limiter
+#define LIMITER_CEILING           32000     // Output peak ceiling (about -0.2 dBFS)
+#define LIMITER_LOOKAHEAD_BLOCKS  2         // Lookahead in ENV_BLOCK_SIZE blocks (~1.5 ms)
+#define LIMITER_RELEASE_MS        80.0f
+
+// Polyphony governor: the voice budget follows the measured render cost per
+// voice, so cheap voices get more of the pool and expensive ones fewer
+#define POLYPHONY_FLOOR           4         // Budget never drops below this
+#define POLYPHONY_START           8         // Budget until a render cost has been measured
+#define GOVERNOR_TARGET_LOAD      0.70f     // Budget sized so a full mix takes this share of a buffer's deadline
+#define GOVERNOR_SHED_LOAD        0.90f     // Projected share of the deadline at which voices are cut mid-buffer
+#define GOVERNOR_RAISE_BUFFERS    32        // Buffers between budget raises (~190 ms), cuts apply at once
+
+// Idle power saving: silent buffers skip the mix, and after a while the CPU
+// clock drops until something plays again. 80 MHz keeps the PLL that clocks I2S.
+#define IDLE_CPU_MHZ              80        // 0 = never lower the clock
+#define IDLE_THROTTLE_MS          1000      // Silence before the clock drops
+
+// MP3 streaming ring: the decoder sleeps once the ring is full and is woken
+// by the audio task when the fill drops below the low-water mark
+#define MP3_BUFFER_MS         4000
+#define MP3_LOW_WATER_MS      2500
+
+// Backing track stems: each has its own ring and gain, decoded by one task and
+// fed by one SD reader that serves them in large round-robin chunks
+#define MP3_MAX_STREAMS       4
+#define MP3_IO_CHUNK_BYTES    16384       // SD read size per scheduling turn
+#define MP3_IO_CHUNKS         3           // Compressed read-ahead per stem, in chunks
+#define MP3_PRIME_MS          300         // Every stem buffers this much before playback starts
+#define MP3_DECODE_BUDGET     0.60f       // Fraction of core 1 the decoder may use across all stems
+
+// Decode-once PCM cache for backing tracks: 44.1 kHz stereo in PSRAM when it
+// fits, otherwise a file on SD. Filled in the background while the decoder is idle.
+#define PCM_CACHE_AUTO        1           // Queue tracks for caching the first time they play
+#define PCM_CACHE_PSRAM_KB    4096        // PSRAM kept for resident tracks
+#define PCM_CACHE_SD_MB       2048        // Cache files stop being written past this total
+
+// Disk-streamed samples: long samples keep only a head in PSRAM, the rest is
+// read from SD into a ring per voice while the note plays
+#define SAMPLE_STREAM_MIN_KB  512         // Samples larger than this are streamed (0 = never)
+#define SAMPLE_HEAD_MS        400         // Resident head, covers SD latency at note on
+#define STREAM_RING_FRAMES    16384       // Per-voice ring (~370 ms at 44.1 kHz)
+#define STREAM_CHUNK_FRAMES   4096        // SD read size per scheduling turn
+#define STREAM_OPEN_FILES     4           // Streamed sample files kept open by the reader
+
+// Instrument manifests: one text file per instrument, read at boot. Zone PCM
+// loads in the background on first use and around the notes being played.
+#define INSTRUMENT_DIR        "/instruments"
+#define ZONE_LOAD_QUEUE       16
+#define ZONE_PREFETCH_SEMITONES 12        // Neighbouring zones queued on every note on
+
+// Trace ring: compact binary events from the audio, MIDI and SD paths, dumped
+// over serial with 'trace dump' and decoded on the host by tools/trace_decode.py
+#define TRACE_EVENTS          4096        // Power of two, 16 bytes each in PSRAM (0 = compiled out)
+
+// Deferred debug output (DEBUGQF): messages from the real-time paths waiting
+// for the log task. A full queue drops messages and counts them.
+#define DEBUG_LOG_QUEUE       64          // Power of two, ~90 bytes each
+
+// Render tests ('test render'): each .mid in RENDER_TEST_DIR is played offline
+// through the engine and checked against <name>.wav and <name>.perf beside it,
+// which 'test record' writes
+#define RENDER_TEST_DIR          "/tests"
+#define RENDER_TEST_TOLERANCE    4         // Largest difference from the golden WAV, in 16-bit steps
+#define RENDER_TEST_PERF_MARGIN  0.10f     // Render time over the recorded baseline that fails
+#define RENDER_TEST_WORST_MARGIN 0.50f     // Same for the worst buffer, which is noisier
+#define RENDER_TEST_TAIL_MS      5000      // Longest release tail rendered after the last event
+#define RENDER_TEST_MAX_SECONDS  600
+
+// MIDI file sequencer ('seq play'): events are read ahead from SD and played by
+// the audio task, following the backing track's position while one plays
+#define SEQUENCER_QUEUE          256       // Events read ahead, power of two
+#define SEQUENCER_RESYNC_FRAMES  (DMA_BUF_LEN * 2) // Backing track jump (seek, loop) that makes the song follow
+
+// Live note ons, offs and pedals from the MIDI and serial side wait here for
+// the audio task's next envelope block. A full queue drops the message.
+#define NOTE_QUEUE               128       // Power of two, 8 bytes each
 
 // Global audio settings
 extern float sampleVolume;
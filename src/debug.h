@@ -3,9 +3,15 @@
 #include <Arduino.h>
 
 #ifdef DEBUG_ON 
+  #include "utils/deferred_log.h"
   #define DEBUG(x) Serial.println(x)
   #define DEBUGF(x, ...) Serial.printf(x, __VA_ARGS__)
+  // Queued for the log task instead of printed: for code that must not block on Serial
+  #define DEBUGQ(x) deferredLog(x "\n")
+  #define DEBUGQF(x, ...) deferredLog(x, __VA_ARGS__)
 #else
   #define DEBUG(x)
   #define DEBUGF(x, ...)
+  #define DEBUGQ(x)
+  #define DEBUGQF(x, ...)
 #endif
\ No newline at end of file
@@ -4,11 +4,16 @@
 #include "audio/i2s_manager.h"
 #include "audio/audio_engine.h"
 #include "audio/mp3_streamer.h"
+#include "audio/pcm_cache.h"
+#include "audio/sample_streamer.h"
 #include "storage/sd_manager.h"
 #include "storage/sample_loader.h"
 #include "storage/instrument_manager.h"
 #include "midi/midi_handler.h"
+#include "midi/sequencer.h"
 #include "utils/serial_commands.h"
+#include "utils/trace.h"
+#include "utils/deferred_log.h"
 
 // Global variables (defined here)
 float sampleVolume = 1.0f;
@@ -17,13 +22,18 @@ int loadedSamples = 0;
 void setup() {
     Serial.begin(115200);
     delay(1000);
+    initDeferredLog();
     
     DEBUG("ESP32-S3 RAM Sampler Starting...");
+    initTrace();
 
     // Initialize hardware
     initI2S();
     initSD();
     initVoices();
+    if (!initSampleStreamer()) {
+        DEBUG("Sample streaming unavailable, long samples will load fully into PSRAM");
+    }
 
     // Initialize MP3 streamer
     DEBUG("Calling initMP3Streamer...");
@@ -31,22 +41,31 @@ void setup() {
         DEBUG("Failed to initialize MP3 streamer");
     } else {
         DEBUG("MP3 streamer initialized successfully");
+        if (!initPCMCache()) {
+            DEBUG("PCM cache unavailable, backing tracks will always be decoded");
+        }
     }
 
-    // Load instruments instead of individual samples
+    // Instruments come from manifests on SD; only the zone tables are read
+    // here, the samples load in the background
     DEBUG("Loading instruments...");
-    
-    // Load a basic piano instrument
-    loadBasicPiano();
-    
-    // You could also load a drum kit:
-    // loadBasicDrumKit();
+    initZoneLoader();
+    if (loadInstrumentManifests() == 0) {
+        // No manifests: fall back to the built-in piano
+        loadBasicPiano();
+        
+        // You could also load a drum kit:
+        // loadBasicDrumKit();
+    }
     
     // Select the first instrument
     selectInstrument(0);
 
     // Setup MIDI
     initMIDI();
+    if (!initSequencer()) {
+        DEBUG("MIDI file playback unavailable");
+    }
 
     // Create audio task
     xTaskCreatePinnedToCore(
@@ -1,6 +1,8 @@
 #include "midi_handler.h"
 #include "midi_config.h"
 #include "../audio/audio_engine.h"
+#include "../audio/controllers.h"
+#include "../utils/trace.h"
 #include "../config.h"
 
 MIDI_NAMESPACE::SerialMIDI<HardwareSerial> Serial2MIDI(Serial2);
@@ -10,6 +12,8 @@ void initMIDI() {
     Serial2.begin(31250, SERIAL_8N1, MIDIRX_PIN, MIDITX_PIN);
     MIDI.setHandleNoteOn(handleNoteOn);
     MIDI.setHandleNoteOff(handleNoteOff);
+    MIDI.setHandleControlChange(handleControlChange);
+    MIDI.setHandlePitchBend(handlePitchBend);
     MIDI.begin(MIDI_CHANNEL_OMNI);
 }
 
@@ -17,10 +21,55 @@ void processMIDI() {
     MIDI.read();
 }
 
+// The MIDI library numbers channels 1-16, the engine 0-15
 void handleNoteOn(byte channel, byte note, byte velocity) {
-    noteOn(note, velocity);
+    noteOn(channel - 1, note, velocity);
 }
 
 void handleNoteOff(byte channel, byte note, byte velocity) {
-    noteOff(note);
+    noteOff(channel - 1, note);
+}
+
+void handleControlChange(byte channel, byte number, byte value) {
+    trace(TRACE_CONTROL, (channel - 1) << 8 | number, value);
+    switch (number) {
+        case 1:     // Mod wheel
+            setModWheel(channel - 1, value);
+            break;
+        case 64:    // Sustain pedal
+            setSustain(channel - 1, value >= 64);
+            break;
+        case 121:   // Reset all controllers
+            setSustain(channel - 1, false);
+            resetControllers(channel - 1);
+            break;
+    }
+}
+
+// The library centres the bend on 0 (-8192 to 8191)
+void handlePitchBend(byte channel, int bend) {
+    trace(TRACE_CONTROL, (channel - 1) << 8 | 128, (uint32_t)bend);
+    setPitchBend(channel - 1, bend);
+}
+
+// Same routing as the serial port for messages that didn't come through the library
+void handleMidiMessage(uint8_t status, uint8_t data1, uint8_t data2) {
+    byte channel = (status & 0x0F) + 1;
+    switch (status & 0xF0) {
+        case 0x90:
+            if (data2 > 0) {
+                handleNoteOn(channel, data1, data2);
+                break;
+            }
+            // Velocity 0 is a note off, fall through
+        case 0x80:
+            handleNoteOff(channel, data1, data2);
+            break;
+        case 0xB0:
+            handleControlChange(channel, data1, data2);
+            break;
+        case 0xE0:
+            handlePitchBend(channel, ((int)data2 << 7 | data1) - 8192);
+            break;
+    }
 }
\ No newline at end of file
@@ -6,4 +6,7 @@
 void initMIDI();
 void processMIDI();
 void handleNoteOn(byte channel, byte note, byte velocity);
-void handleNoteOff(byte channel, byte note, byte velocity);
\ No newline at end of file
+void handleNoteOff(byte channel, byte note, byte velocity);
+void handleControlChange(byte channel, byte number, byte value);
+void handlePitchBend(byte channel, int bend);
+void handleMidiMessage(uint8_t status, uint8_t data1, uint8_t data2);   // Raw channel message, e.g. from a MIDI file
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "sequencer.h"
+#include "../debug.h"
+#include "smf_reader.h"
+#include "midi_handler.h"
+#include "../audio/audio_engine.h"
+#include "../audio/controllers.h"
+#include "../audio/mp3_streamer.h"
+
+static_assert((SEQUENCER_QUEUE & (SEQUENCER_QUEUE - 1)) == 0, "SEQUENCER_QUEUE must be a power of two");
+
+struct SequencerEvent {
+    uint32_t frame;             // Song frame at SAMPLE_RATE
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+    uint8_t generation;         // Low bits of the relocation it was read for
+};
+
+SequencerStats sequencerStats = {};
+static TaskHandle_t sequencerTask = NULL;
+
+// The open file: reader task, and the command side while opening or closing it
+static SmfReader song;
+static String songPath;
+static SemaphoreHandle_t fileMutex = NULL;
+
+// Read-ahead: the reader task writes the head, the audio task the tail
+static SequencerEvent queue[SEQUENCER_QUEUE];
+static uint32_t queueHead = 0;
+static uint32_t queueTail = 0;
+
+// Command side to audio task
+static volatile bool playing = false;
+static volatile bool restartRequested = false;  // A new file is open, the audio task picks where it starts
+
+// Audio task to reader task: every start, seek and loop is a new generation,
+// and events read for an older one are dropped unplayed
+static volatile uint32_t generation = 0;
+static volatile uint32_t seekFrame = 0;
+static volatile uint32_t readyGeneration = 0;   // Reader has queued events from the new position
+static volatile uint32_t endGeneration = 0;     // Reader has queued the last event of the file
+
+// Audio task only
+static uint32_t songFrame = 0;                  // Song frame of the next envelope block
+static bool blockActive = false;                // Events are due this buffer
+static bool following = false;                  // Clock is the backing track's position
+static uint32_t heldNotes[MIDI_CHANNELS][4];    // Notes it started and hasn't ended, a bit per key
+static uint16_t usedChannels = 0;
+
+// Note offs for everything it is holding, and the channels' pedals and bends back to rest
+static void releaseNotes() {
+    for (int c = 0; c < MIDI_CHANNELS; c++) {
+        if (!(usedChannels & (1u << c))) continue;
+        for (int word = 0; word < 4; word++) {
+            for (uint32_t held = heldNotes[c][word]; held; held &= held - 1) {
+                noteOff(c, word * 32 + __builtin_ctz(held));
+            }
+            heldNotes[c][word] = 0;
+        }
+        setSustain(c, false);
+        resetControllers(c);
+    }
+    usedChannels = 0;
+}
+
+static void relocate(uint32_t frame) {
+    releaseNotes();
+    seekFrame = frame;
+    __atomic_store_n(&generation, generation + 1, __ATOMIC_RELEASE);
+    songFrame = frame;
+    sequencerStats.relocations++;
+    if (sequencerTask) xTaskNotifyGive(sequencerTask);
+}
+
+static void applyEvent(const SequencerEvent& event, uint8_t offset) {
+    uint8_t channel = event.status & 0x0F;
+    if (channel >= MIDI_CHANNELS) return;
+    uint32_t& held = heldNotes[channel][event.data1 >> 5];
+    uint32_t bit = 1u << (event.data1 & 31);
+    usedChannels |= 1u << channel;
+    sequencerStats.events++;
+
+    switch (event.status & 0xF0) {
+        case 0x90:
+            if (event.data2 > 0) {
+                noteOn(channel, event.data1, event.data2, offset);
+                held |= bit;
+                break;
+            }
+            // Velocity 0 is a note off, fall through
+        case 0x80:
+            noteOff(channel, event.data1);
+            held &= ~bit;
+            break;
+        default:
+            // Controllers and bends are ramped per envelope block anyway
+            handleMidiMessage(event.status, event.data1, event.data2);
+            break;
+    }
+}
+
+void sequencerBeginBuffer() {
+    blockActive = false;
+    uint32_t head = __atomic_load_n(&queueHead, __ATOMIC_ACQUIRE);
+    if (!playing) {
+        if (usedChannels) releaseNotes();
+        __atomic_store_n(&queueTail, head, __ATOMIC_RELEASE);
+        return;
+    }
+
+    uint32_t heard = 0;
+    bool primed = false;
+    bool follow = getMP3HeardFrame(heard, primed);
+    if (restartRequested) {
+        relocate(follow ? heard : 0);
+        restartRequested = false;   // Only after the new generation, the reader waits on it
+    } else if (follow && primed && abs((int32_t)(heard - songFrame)) > SEQUENCER_RESYNC_FRAMES) {
+        relocate(heard);            // The backing track was seeked, looped or started
+    }
+
+    // Events from before a relocation are at the front: drop them so the reader has room
+    uint8_t current = generation;
+    uint32_t tail = queueTail;
+    while (tail != head && queue[tail & (SEQUENCER_QUEUE - 1)].generation != current) tail++;
+    __atomic_store_n(&queueTail, tail, __ATOMIC_RELEASE);
+
+    following = follow;
+    if (follow) {
+        if (!primed) return;        // Track still buffering: the song waits with it
+        songFrame = heard;
+    } else if (readyGeneration != generation) {
+        return;                     // Free running starts once the first events are queued
+    }
+    blockActive = true;
+}
+
+void sequencerRenderBlock(int frames) {
+    if (!blockActive) return;
+    uint32_t end = songFrame + frames;
+    uint32_t head = __atomic_load_n(&queueHead, __ATOMIC_ACQUIRE);
+    uint32_t tail = queueTail;
+    uint8_t current = generation;
+    while (tail != head) {
+        const SequencerEvent& event = queue[tail & (SEQUENCER_QUEUE - 1)];
+        if (event.generation != current) {
+            // Read just before the relocation
+            __atomic_store_n(&queueTail, ++tail, __ATOMIC_RELEASE);
+            continue;
+        }
+        if ((int32_t)(event.frame - end) >= 0) break;
+        int32_t offset = (int32_t)(event.frame - songFrame);
+        if (offset < 0) {
+            // Read too late after a relocation: play it now
+            sequencerStats.late++;
+            sequencerStats.maxLateFrames = max(sequencerStats.maxLateFrames, (uint32_t)-offset);
+            offset = 0;
+        }
+        applyEvent(event, offset);
+        __atomic_store_n(&queueTail, ++tail, __ATOMIC_RELEASE);
+    }
+    songFrame = end;
+
+    // Free running and the whole file played
+    if (!following && tail == head && endGeneration == generation) {
+        playing = false;
+        DEBUGQ("Sequencer: end of song");
+    }
+}
+
+void sequencerTaskCode(void* parameter) {
+    uint32_t positioned = 0;
+    SmfEvent next;
+    bool hasNext = false;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+
+        xSemaphoreTake(fileMutex, portMAX_DELAY);
+        if (playing && !restartRequested && song.numTracks > 0) {
+            uint32_t current = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+            if (current != positioned) {
+                // Read from the top so tempo changes before the new position still count
+                uint32_t target = seekFrame;
+                smfRewind(song);
+                hasNext = smfNext(song, next);
+                while (hasNext && next.sample < target) hasNext = smfNext(song, next);
+                positioned = current;
+            }
+            while (hasNext && queueHead - __atomic_load_n(&queueTail, __ATOMIC_ACQUIRE) < SEQUENCER_QUEUE) {
+                SequencerEvent& event = queue[queueHead & (SEQUENCER_QUEUE - 1)];
+                event.frame = next.sample;
+                event.status = next.status;
+                event.data1 = next.data1;
+                event.data2 = next.data2;
+                event.generation = positioned;
+                __atomic_store_n(&queueHead, queueHead + 1, __ATOMIC_RELEASE);
+                hasNext = smfNext(song, next);
+            }
+            readyGeneration = positioned;
+            if (!hasNext) endGeneration = positioned;
+        }
+        xSemaphoreGive(fileMutex);
+    }
+}
+
+bool initSequencer() {
+    fileMutex = xSemaphoreCreateMutex();
+    if (!fileMutex) {
+        DEBUG("Failed to create sequencer mutex");
+        return false;
+    }
+
+    // Same level as the MP3 reader: a few bytes per event, but due on time
+    BaseType_t result = xTaskCreatePinnedToCore(
+        sequencerTaskCode,
+        "Sequencer",
+        4096,
+        NULL,
+        3,
+        &sequencerTask,
+        1
+    );
+    if (result != pdPASS) {
+        DEBUGF("Failed to create sequencer task, error: %d\n", result);
+        sequencerTask = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool startSequencer(const char* path) {
+    if (!sequencerTask) {
+        DEBUG("Sequencer not available");
+        return false;
+    }
+    String filepath = path;
+    if (!filepath.startsWith("/")) filepath = "/" + filepath;
+
+    xSemaphoreTake(fileMutex, portMAX_DELAY);
+    smfClose(song);
+    bool opened = smfOpen(song, filepath.c_str());
+    if (opened) {
+        songPath = filepath;
+        restartRequested = true;
+    }
+    playing = opened;
+    xSemaphoreGive(fileMutex);
+    if (!opened) return false;
+
+    DEBUGF("Sequencer: playing %s, %d tracks%s\n", filepath.c_str(), song.numTracks,
+           mp3Streaming ? ", following the backing track" : "");
+    return true;
+}
+
+void stopSequencer() {
+    if (!fileMutex) return;
+    xSemaphoreTake(fileMutex, portMAX_DELAY);
+    playing = false;
+    restartRequested = false;
+    smfClose(song);
+    xSemaphoreGive(fileMutex);
+    DEBUG("Sequencer stopped");
+}
+
+bool isSequencerPlaying() {
+    return playing;
+}
+
+void printSequencerStatus() {
+    if (!playing) {
+        DEBUG("Sequencer: stopped");
+    } else {
+        DEBUGF("Sequencer: %s at %.2f s, %s\n", songPath.c_str(), (float)songFrame / SAMPLE_RATE,
+               following ? "following the backing track" : "free running");
+    }
+    DEBUGF("  %lu events, %lu late (worst %.1f ms), %lu relocations, %lu queued\n",
+           (unsigned long)sequencerStats.events, (unsigned long)sequencerStats.late,
+           sequencerStats.maxLateFrames * 1000.0f / SAMPLE_RATE, (unsigned long)sequencerStats.relocations,
+           (unsigned long)(queueHead - queueTail));
+}
\ No newline at end of file
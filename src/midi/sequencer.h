@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../config.h"
+
+// Standard MIDI File player. A reader task streams the file from SD into an
+// event queue stamped with song frames; the audio task takes the events due in
+// each envelope block and starts notes at their exact frame. While a backing
+// track plays the song clock is the track's position, so seeks and loops of
+// the track carry the song with them; otherwise it runs from the output clock.
+
+struct SequencerStats {
+    uint32_t events;                // Applied by the audio task
+    uint32_t late;                  // Applied after their frame (reader behind after a seek)
+    uint32_t maxLateFrames;
+    uint32_t relocations;           // Starts, seeks and loops the reader had to follow
+};
+
+extern SequencerStats sequencerStats;
+
+bool initSequencer();                   // Starts the reader task
+bool startSequencer(const char* path);  // From the backing track's position, or the top
+void stopSequencer();                   // Releases the notes it was holding
+bool isSequencerPlaying();
+void printSequencerStatus();
+void sequencerTaskCode(void* parameter);
+
+// Audio task only: once per buffer, then once per envelope block before the voices mix
+void sequencerBeginBuffer();
+void sequencerRenderBlock(int frames);
\ No newline at end of file
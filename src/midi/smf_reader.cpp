@@ -0,0 +1,220 @@
+#include "smf_reader.h"
+#include "../debug.h"
+#include "SD_MMC.h"
+
+#define SMF_DEFAULT_TEMPO 500000        // 120 BPM until the file says otherwise
+
+static uint32_t readBigEndian(const uint8_t* bytes, int count) {
+    uint32_t value = 0;
+    for (int i = 0; i < count; i++) value = value << 8 | bytes[i];
+    return value;
+}
+
+// -1 once the track is used up
+static int readByte(SmfReader& reader, SmfTrack& track) {
+    if (track.pos == track.fill) {
+        if (track.offset >= track.end) return -1;
+        uint32_t wanted = min((uint32_t)SMF_TRACK_BUFFER, track.end - track.offset);
+        if (!reader.file.seek(track.offset)) return -1;
+        int got = reader.file.read(track.buffer, wanted);
+        if (got <= 0) return -1;
+        track.offset += got;
+        track.fill = got;
+        track.pos = 0;
+    }
+    return track.buffer[track.pos++];
+}
+
+// Variable-length quantity, at most four bytes
+static bool readVarLen(SmfReader& reader, SmfTrack& track, uint32_t& value) {
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        int byte = readByte(reader, track);
+        if (byte < 0) return false;
+        value = value << 7 | (byte & 0x7F);
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+static void skipBytes(SmfReader& reader, SmfTrack& track, uint32_t count) {
+    uint32_t buffered = track.fill - track.pos;
+    if (count <= buffered) {
+        track.pos += count;
+        return;
+    }
+    track.pos = track.fill;
+    track.offset = min(track.end, track.offset + (count - buffered));
+}
+
+static void readNextDelta(SmfReader& reader, SmfTrack& track) {
+    uint32_t delta;
+    if (!readVarLen(reader, track, delta)) {
+        track.done = true;
+        return;
+    }
+    track.nextTick += delta;
+}
+
+uint64_t smfTickToSample(const SmfReader& reader, uint32_t tick) {
+    // Ticks * us per quarter * rate stays inside 64 bits for hours of music
+    uint64_t ticks = tick - reader.tempoTick;
+    return reader.tempoSample + ticks * reader.tempo * SAMPLE_RATE / ((uint64_t)reader.division * 1000000);
+}
+
+bool smfRewind(SmfReader& reader) {
+    if (!reader.file.seek(14)) return false;
+    uint32_t position = 14;
+    uint8_t header[8];
+    int found = 0;
+    while (found < reader.numTracks && reader.file.read(header, 8) == 8) {
+        uint32_t length = readBigEndian(header + 4, 4);
+        position += 8;
+        if (memcmp(header, "MTrk", 4) == 0) {
+            SmfTrack& track = reader.tracks[found++];
+            track.offset = position;
+            track.end = position + length;
+            track.fill = 0;
+            track.pos = 0;
+            track.runningStatus = 0;
+            track.done = false;
+            track.nextTick = 0;
+        }
+        // Unknown chunks are skipped, as the spec asks
+        position += length;
+        if (!reader.file.seek(position)) break;
+    }
+    reader.numTracks = found;
+
+    // SMPTE files count ticks per second: a fixed one-second "quarter note"
+    reader.tempo = reader.smpte ? 1000000 : SMF_DEFAULT_TEMPO;
+    reader.tempoTick = 0;
+    reader.tempoSample = 0;
+    for (int i = 0; i < reader.numTracks; i++) readNextDelta(reader, reader.tracks[i]);
+    return found > 0;
+}
+
+bool smfOpen(SmfReader& reader, const char* path) {
+    reader.file = SD_MMC.open(path);
+    if (!reader.file) {
+        DEBUGF("Failed to open MIDI file: %s\n", path);
+        return false;
+    }
+
+    uint8_t header[14];
+    if (reader.file.read(header, 14) != 14 || memcmp(header, "MThd", 4) != 0 ||
+        readBigEndian(header + 4, 4) < 6) {
+        DEBUGF("%s is not a Standard MIDI File\n", path);
+        smfClose(reader);
+        return false;
+    }
+    reader.format = readBigEndian(header + 8, 2);
+    uint32_t tracks = readBigEndian(header + 10, 2);
+    uint16_t division = readBigEndian(header + 12, 2);
+    if (reader.format > 1) {
+        DEBUGF("%s: format %d MIDI files are not supported\n", path, reader.format);
+        smfClose(reader);
+        return false;
+    }
+    if (tracks > SMF_MAX_TRACKS) {
+        DEBUGF("%s: only the first %d of %lu tracks are played\n", path, SMF_MAX_TRACKS, (unsigned long)tracks);
+        tracks = SMF_MAX_TRACKS;
+    }
+    reader.numTracks = tracks;
+    reader.smpte = division & 0x8000;
+    if (reader.smpte) {
+        // Upper byte is -frames per second, lower byte ticks per frame
+        division = (uint16_t)(-(int8_t)(division >> 8)) * (division & 0xFF);
+    }
+    reader.division = division;
+    if (reader.division == 0 || !smfRewind(reader)) {
+        DEBUGF("%s has no tracks\n", path);
+        smfClose(reader);
+        return false;
+    }
+    return true;
+}
+
+void smfClose(SmfReader& reader) {
+    if (reader.file) reader.file.close();
+    reader.numTracks = 0;
+}
+
+bool smfNext(SmfReader& reader, SmfEvent& event) {
+    for (;;) {
+        // Earliest track next; on a tie the lower track, so tempo maps in track 0 come first
+        SmfTrack* track = NULL;
+        for (int i = 0; i < reader.numTracks; i++) {
+            SmfTrack& candidate = reader.tracks[i];
+            if (!candidate.done && (!track || candidate.nextTick < track->nextTick)) track = &candidate;
+        }
+        if (!track) return false;
+
+        uint32_t tick = track->nextTick;
+        int status = readByte(reader, *track);
+        if (status < 0) {
+            track->done = true;
+            continue;
+        }
+
+        if (status == 0xFF) {
+            int type = readByte(reader, *track);
+            uint32_t length;
+            if (type < 0 || !readVarLen(reader, *track, length)) {
+                track->done = true;
+                continue;
+            }
+            if (type == 0x2F) {
+                track->done = true;
+                continue;
+            }
+            if (type == 0x51 && length == 3 && !reader.smpte) {
+                uint8_t bytes[3];
+                for (int i = 0; i < 3; i++) bytes[i] = readByte(reader, *track);
+                // Move the reference point first so earlier ticks keep their time
+                reader.tempoSample = smfTickToSample(reader, tick);
+                reader.tempoTick = tick;
+                reader.tempo = max(readBigEndian(bytes, 3), (uint32_t)1);
+            } else {
+                skipBytes(reader, *track, length);
+            }
+            readNextDelta(reader, *track);
+            continue;
+        }
+        if (status == 0xF0 || status == 0xF7) {
+            uint32_t length;
+            if (readVarLen(reader, *track, length)) skipBytes(reader, *track, length);
+            readNextDelta(reader, *track);
+            continue;
+        }
+
+        int data1;
+        if (status > 0xEF) {
+            track->done = true;     // System messages don't belong in a file
+            continue;
+        } else if (status & 0x80) {
+            track->runningStatus = status;
+            data1 = readByte(reader, *track);
+        } else if (track->runningStatus) {
+            data1 = status;
+            status = track->runningStatus;
+        } else {
+            track->done = true;     // Data byte with no status to run on: corrupt track
+            continue;
+        }
+        uint8_t type = status & 0xF0;
+        int data2 = (type == 0xC0 || type == 0xD0) ? 0 : readByte(reader, *track);
+        if (data1 < 0 || data2 < 0) {
+            track->done = true;
+            continue;
+        }
+        readNextDelta(reader, *track);
+
+        event.tick = tick;
+        event.sample = smfTickToSample(reader, tick);
+        event.status = status;
+        event.data1 = data1;
+        event.data2 = data2;
+        return true;
+    }
+}
\ No newline at end of file
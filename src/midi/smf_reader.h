@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+#include "FS.h"
+#include "../config.h"
+
+#define SMF_MAX_TRACKS      16
+#define SMF_TRACK_BUFFER    64          // Bytes read ahead per track
+
+// Standard MIDI File (format 0 or 1) read straight from SD: each track keeps a
+// small read-ahead buffer and the tracks are merged in time order, so a file
+// of any length costs about 1.5 KB.
+struct SmfTrack {
+    uint32_t offset;                    // File position of the next refill
+    uint32_t end;                       // File position just past the track
+    uint8_t buffer[SMF_TRACK_BUFFER];
+    uint8_t fill;
+    uint8_t pos;
+    uint8_t runningStatus;
+    bool done;
+    uint32_t nextTick;                  // Absolute tick of the track's next event
+};
+
+struct SmfEvent {
+    uint64_t sample;                    // Frames from the start of the song at SAMPLE_RATE
+    uint32_t tick;
+    uint8_t status;                     // Channel messages only (0x80-0xEF)
+    uint8_t data1;
+    uint8_t data2;
+};
+
+struct SmfReader {
+    File file;
+    uint8_t format;
+    uint8_t numTracks;
+    uint16_t division;                  // Ticks per quarter note, or per second for SMPTE files
+    bool smpte;
+    uint32_t tempo;                     // Microseconds per quarter note
+    uint32_t tempoTick;                 // Tick and sample where the tempo last changed
+    uint64_t tempoSample;
+    SmfTrack tracks[SMF_MAX_TRACKS];
+};
+
+bool smfOpen(SmfReader& reader, const char* path);
+void smfClose(SmfReader& reader);
+bool smfRewind(SmfReader& reader);
+bool smfNext(SmfReader& reader, SmfEvent& event);  // Next channel event in time order, false at the end
+uint64_t smfTickToSample(const SmfReader& reader, uint32_t tick); // At the current tempo
\ No newline at end of file
@@ -3,24 +3,53 @@
 #include <Arduino.h>
 #include "../config.h"
 #include "sample.h"
+#include "../audio/envelope.h"
+#include "../audio/interpolation.h"
 
+// One zone of an instrument. Zones are defined up front (from a manifest or in
+// code) and their PCM is loaded on first use or prefetched in the background.
 struct KeySample {
-    Sample* sample;          // Pointer to the actual sample data
+    Sample* sample;          // Pointer to the actual sample data, NULL until loaded
+    String filename;         // WAV on SD
     uint8_t rootNote;        // The MIDI note this sample was recorded at
     uint8_t minNote;         // Minimum MIDI note this sample should cover
     uint8_t maxNote;         // Maximum MIDI note this sample should cover
-    bool isLoaded;           // Whether this key sample is loaded
+    uint8_t minVelocity;     // Velocity layer
+    uint8_t maxVelocity;
+    LoopSettings loop;       // Manifest loop points and crossfade (end 0: the WAV's smpl loop)
+    uint8_t rrNext;          // Next zone with the same key and velocity range (round robin ring)
+    volatile uint8_t rrCursor; // On the ring's first zone: the zone the next note plays
+    volatile bool isLoaded;  // Whether this key sample is loaded
+    volatile bool loadQueued;
+    bool loadFailed;         // Not retried until the instrument is redefined
 };
 
 struct Instrument {
     String name;             // Instrument name
-    KeySample keySamples[MAX_SAMPLES];  // Array of key samples
-    int numKeySamples;       // Number of loaded key samples
+    KeySample keySamples[MAX_ZONES];  // Array of key samples
+    int numKeySamples;       // Number of defined zones
+    EnvelopeSettings envelope; // Amplitude envelope applied to every note
+    InterpMode interpMode;   // Resampling quality used when pitch shifting
     bool isLoaded;           // Whether this instrument is loaded
+    volatile bool preload;   // Zone loader fills in every zone while idle
+    uint8_t velocityLayer[128];  // Velocity -> layer, layers split where any zone's range starts or ends
+    uint8_t numVelocityLayers;
+    uint8_t zoneGrid[128][MAX_VELOCITY_LAYERS]; // First zone of the round robin ring for a note and layer
+    uint8_t residentMap[128]; // Closest loaded zone for a note: played while a note's own zone loads
 };
 
+#define NO_KEY_SAMPLE 0xFF
+
 // Function to calculate pitch ratio from semitone difference
 float calculatePitchRatio(int semitoneOffset);
 
-// Function to find the best key sample for a given MIDI note
-KeySample* findBestKeySample(Instrument* instrument, uint8_t midiNote);
\ No newline at end of file
+// Function to find the best key sample for a given MIDI note and velocity (table
+// lookups, then a step round the ring). An unloaded zone is queued for loading
+// and the closest loaded one stands in.
+KeySample* findBestKeySample(Instrument* instrument, uint8_t midiNote, uint8_t velocity);
+
+// Rebuild the lookup tables after zones are added or loaded
+void buildNoteMap(Instrument* instrument);
+
+// PSRAM held by the instrument's loaded zones
+size_t getInstrumentMemoryUsage(const Instrument* instrument);
\ No newline at end of file
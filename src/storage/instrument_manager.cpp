@@ -2,11 +2,35 @@
 #include "../config.h"
 #include "../debug.h"
 #include "sample_loader.h"
+#include "../utils/trace.h"
+#include "FS.h"
+#include "SD_MMC.h"
 #include <math.h>
 
 Instrument instruments[MAX_INSTRUMENTS];
 int currentInstrument = 0;
 int loadedInstruments = 0;
+int8_t channelInstruments[MIDI_CHANNELS] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+ZoneLoaderStats zoneStats;
+
+// Zones waiting for the loader task
+struct ZoneRequest {
+    uint8_t instrument;
+    uint8_t zone;
+};
+
+static_assert((ZONE_LOAD_QUEUE & (ZONE_LOAD_QUEUE - 1)) == 0, "ZONE_LOAD_QUEUE must be a power of two");
+
+// Requests come from note ons, which only the audio task plays, so the queue
+// has one writer and one reader and neither side takes a lock
+static ZoneRequest zoneQueue[ZONE_LOAD_QUEUE];
+static uint32_t zoneQueueHead = 0;              // Written by the note path
+static uint32_t zoneQueueTail = 0;              // Written by the loader task
+static SemaphoreHandle_t zoneLoadMutex = NULL;   // Sample pool and zone tables while a zone loads
+static TaskHandle_t zoneLoaderTask = NULL;
+
+// Short attack and release, full sustain - close to a plain one-shot
+const EnvelopeSettings defaultEnvelope = { 2.0f, 0.0f, 1.0f, 12.0f, ENV_CURVE_LINEAR };
 
 float calculatePitchRatio(int semitoneOffset) {
     // Calculate pitch ratio using 12-tone equal temperament
@@ -14,85 +38,536 @@ float calculatePitchRatio(int semitoneOffset) {
     return pow(2.0f, semitoneOffset / 12.0f);
 }
 
-KeySample* findBestKeySample(Instrument* instrument, uint8_t midiNote) {
-    if (!instrument || !instrument->isLoaded) {
+static void requestZoneLoad(Instrument* instrument, uint8_t zone) {
+    KeySample* ks = &instrument->keySamples[zone];
+    if (ks->isLoaded || ks->loadQueued || ks->loadFailed || !zoneLoaderTask) return;
+
+    bool queued = false;
+    uint32_t head = zoneQueueHead;
+    if (head - __atomic_load_n(&zoneQueueTail, __ATOMIC_ACQUIRE) < ZONE_LOAD_QUEUE) {
+        ZoneRequest& request = zoneQueue[head & (ZONE_LOAD_QUEUE - 1)];
+        request.instrument = instrument - instruments;
+        request.zone = zone;
+        ks->loadQueued = true;
+        __atomic_store_n(&zoneQueueHead, head + 1, __ATOMIC_RELEASE);
+        queued = true;
+    }
+
+    // A full queue just drops the request, the next note asks again
+    if (queued) xTaskNotifyGive(zoneLoaderTask);
+}
+
+KeySample* findBestKeySample(Instrument* instrument, uint8_t midiNote, uint8_t velocity) {
+    if (!instrument || !instrument->isLoaded || midiNote > 127 || velocity > 127) {
         return nullptr;
     }
+    uint8_t head = instrument->zoneGrid[midiNote][instrument->velocityLayer[velocity]];
+    if (head == NO_KEY_SAMPLE) return nullptr;
     
-    // First, look for a key sample that covers this note directly
+    // Take the ring's next recording and move the cursor on for the next hit
+    KeySample* zones = instrument->keySamples;
+    uint8_t index = zones[head].rrCursor;
+    zones[head].rrCursor = zones[index].rrNext;
+    if (zones[index].isLoaded) return &zones[index];
+
+    // First use: load it in the background. Another recording of the ring
+    // will do, otherwise pitch the nearest resident zone meanwhile.
+    // Bounded: while a rebuild runs the walk can start on a zone since dropped from the ring
+    requestZoneLoad(instrument, index);
+    uint8_t i = zones[index].rrNext;
+    for (int steps = 0; i != index && steps < instrument->numKeySamples && !zones[i].loadFailed; steps++) {
+        if (zones[i].isLoaded) return &zones[i];
+        i = zones[i].rrNext;
+    }
+    index = instrument->residentMap[midiNote];
+    if (index == NO_KEY_SAMPLE) {
+        zoneStats.dropped++;
+        return nullptr;
+    }
+    zoneStats.standIns++;
+    return &zones[index];
+}
+
+void prefetchZones(Instrument* instrument, uint8_t midiNote, uint8_t velocity) {
+    if (!instrument || !instrument->isLoaded || velocity > 127) return;
+    // Melodies move by small steps: have the zones either side ready at this dynamic
+    uint8_t layer = instrument->velocityLayer[velocity];
+    const int offsets[2] = { -ZONE_PREFETCH_SEMITONES, ZONE_PREFETCH_SEMITONES };
+    for (int i = 0; i < 2; i++) {
+        int note = midiNote + offsets[i];
+        if (note < 0 || note > 127) continue;
+        uint8_t head = instrument->zoneGrid[note][layer];
+        if (head == NO_KEY_SAMPLE) continue;
+        // The whole ring, so repeated notes don't fall back while the rest loads
+        uint8_t index = head;
+        for (int steps = 0; steps < instrument->numKeySamples; steps++) {
+            if (instrument->keySamples[index].loadFailed) break;
+            requestZoneLoad(instrument, index);
+            index = instrument->keySamples[index].rrNext;
+            if (index == head) break;
+        }
+    }
+}
+
+static bool sameRanges(const KeySample* a, const KeySample* b) {
+    return a->minNote == b->minNote && a->maxNote == b->maxNote &&
+           a->minVelocity == b->minVelocity && a->maxVelocity == b->maxVelocity;
+}
+
+// Zone covering the note (and velocity) directly, otherwise the one with the closest root
+static int searchKeySample(const Instrument* instrument, uint8_t midiNote, int velocity, bool residentOnly) {
     for (int i = 0; i < instrument->numKeySamples; i++) {
-        KeySample* ks = &instrument->keySamples[i];
-        if (ks->isLoaded && midiNote >= ks->minNote && midiNote <= ks->maxNote) {
-            return ks;
+        const KeySample* ks = &instrument->keySamples[i];
+        if (residentOnly && !ks->isLoaded) continue;
+        if (!ks->loadFailed && midiNote >= ks->minNote && midiNote <= ks->maxNote &&
+            (velocity < 0 || (velocity >= ks->minVelocity && velocity <= ks->maxVelocity))) {
+            return i;
         }
     }
     
-    // If no direct match, find the closest key sample
-    KeySample* closest = nullptr;
-    int smallestDistance = 128;
-    
+    int closest = NO_KEY_SAMPLE;
+    int smallestDistance = 256;
     for (int i = 0; i < instrument->numKeySamples; i++) {
-        KeySample* ks = &instrument->keySamples[i];
-        if (ks->isLoaded) {
-            int distance = abs((int)midiNote - (int)ks->rootNote);
-            if (distance < smallestDistance) {
-                smallestDistance = distance;
-                closest = ks;
+        const KeySample* ks = &instrument->keySamples[i];
+        if ((residentOnly && !ks->isLoaded) || ks->loadFailed) continue;
+        int distance = abs((int)midiNote - (int)ks->rootNote);
+        // Out of the velocity range costs more than any pitch distance
+        if (velocity >= 0 && (velocity < ks->minVelocity || velocity > ks->maxVelocity)) distance += 128;
+        if (distance < smallestDistance) {
+            smallestDistance = distance;
+            closest = i;
+        }
+    }
+    return closest;
+}
+
+void buildNoteMap(Instrument* instrument) {
+    KeySample* zones = instrument->keySamples;
+    int count = instrument->numKeySamples;
+    
+    // Zones with identical key and velocity ranges alternate on repeated notes
+    for (int i = 0; i < count; i++) {
+        if (zones[i].loadFailed) {
+            // A note on racing the rebuild may still start here: lead it back into the live ring
+            int live = i;
+            for (int j = 0; j < count; j++) {
+                if (j != i && !zones[j].loadFailed && sameRanges(&zones[j], &zones[i])) { live = j; break; }
             }
+            zones[i].rrNext = live;
+            zones[i].rrCursor = live;
+            continue;
+        }
+        int head = i;
+        for (int j = 0; j < i; j++) {
+            if (!zones[j].loadFailed && sameRanges(&zones[j], &zones[i])) { head = j; break; }
         }
+        int next = head;
+        for (int j = i + 1; j < count; j++) {
+            if (!zones[j].loadFailed && sameRanges(&zones[j], &zones[i])) { next = j; break; }
+        }
+        zones[i].rrNext = next;
+        if (head == i && zones[zones[i].rrCursor].loadFailed) zones[i].rrCursor = i;
     }
     
-    return closest;
+    // Layer boundaries wherever a velocity range starts or ends
+    bool boundary[129] = { false };
+    for (int i = 0; i < count; i++) {
+        if (zones[i].loadFailed) continue;
+        boundary[zones[i].minVelocity] = true;
+        boundary[zones[i].maxVelocity + 1] = true;
+    }
+    int layer = 0;
+    int wanted = 1;
+    uint8_t layerVelocity[MAX_VELOCITY_LAYERS] = { 0 };
+    for (int v = 0; v < 128; v++) {
+        if (boundary[v] && v > 0) {
+            wanted++;
+            if (layer < MAX_VELOCITY_LAYERS - 1) layerVelocity[++layer] = v;
+        }
+        instrument->velocityLayer[v] = layer;
+    }
+    if (wanted > MAX_VELOCITY_LAYERS && instrument->numVelocityLayers < MAX_VELOCITY_LAYERS) {
+        DEBUGF("%s: %d velocity layers, the top ones are merged into layer %d\n",
+               instrument->name.c_str(), wanted, MAX_VELOCITY_LAYERS);
+    }
+    instrument->numVelocityLayers = layer + 1;
+    
+    // Entries are single bytes, so a note on racing the rebuild sees the old or new zone
+    for (int note = 0; note < 128; note++) {
+        for (int l = 0; l < MAX_VELOCITY_LAYERS; l++) {
+            instrument->zoneGrid[note][l] = l <= layer ? searchKeySample(instrument, note, layerVelocity[l], false)
+                                                       : NO_KEY_SAMPLE;
+        }
+        instrument->residentMap[note] = searchKeySample(instrument, note, -1, true);
+    }
 }
 
-bool loadKeySample(int instrumentIndex, const char* filename, uint8_t rootNote, uint8_t minNote, uint8_t maxNote) {
-    if (instrumentIndex >= MAX_INSTRUMENTS || !instruments[instrumentIndex].isLoaded) {
+size_t getInstrumentMemoryUsage(const Instrument* instrument) {
+    size_t bytes = 0;
+    for (int i = 0; i < instrument->numKeySamples; i++) {
+        const KeySample* ks = &instrument->keySamples[i];
+        if (ks->isLoaded) bytes += getSampleMemoryUsage(ks->sample);
+    }
+    return bytes;
+}
+
+int addInstrumentZone(int instrumentIndex, const char* filename, uint8_t rootNote, uint8_t minNote, uint8_t maxNote,
+                      uint8_t minVelocity, uint8_t maxVelocity) {
+    if (instrumentIndex < 0 || instrumentIndex >= MAX_INSTRUMENTS || !instruments[instrumentIndex].isLoaded) {
         DEBUG("Invalid instrument index");
-        return false;
+        return -1;
     }
     
     Instrument* instrument = &instruments[instrumentIndex];
     
-    if (instrument->numKeySamples >= MAX_SAMPLES) {
-        DEBUGF("Instrument %s is full (max %d samples)\n", instrument->name.c_str(), MAX_SAMPLES);
-        return false;
+    if (instrument->numKeySamples >= MAX_ZONES) {
+        DEBUGF("Instrument %s is full (max %d zones)\n", instrument->name.c_str(), MAX_ZONES);
+        return -1;
     }
     
-    // Load the sample using the existing sample loader
-    if (!loadSampleFromSD(filename, rootNote)) {
-        DEBUGF("Failed to load sample %s\n", filename);
-        return false;
-    }
+    if (zoneLoadMutex) xSemaphoreTake(zoneLoadMutex, portMAX_DELAY);
+    int zone = instrument->numKeySamples;
+    KeySample* ks = &instrument->keySamples[zone];
+    ks->sample = nullptr;
+    ks->filename = filename;
+    ks->rootNote = rootNote;
+    ks->minNote = minNote;
+    ks->maxNote = maxNote;
+    ks->minVelocity = minVelocity;
+    ks->maxVelocity = maxVelocity;
+    ks->isLoaded = false;
+    ks->loadQueued = false;
+    ks->loadFailed = false;
+    ks->rrNext = zone;
+    ks->rrCursor = zone;
+    ks->loop.start = 0;
+    ks->loop.end = 0;
+    ks->loop.crossfadeMs = 0.0f;
+    instrument->numKeySamples++;
+    if (zoneLoadMutex) xSemaphoreGive(zoneLoadMutex);
     
-    // Find the sample that was just loaded
-    Sample* sample = nullptr;
-    for (int i = 0; i < loadedSamples; i++) {
-        if (samples[i].midiNote == rootNote && samples[i].filename == filename) {
-            sample = &samples[i];
-            break;
-        }
+    return zone;
+}
+
+// Read a zone's PCM into the sample pool (zone loader task, or the caller for eager loads)
+static bool loadZone(int instrumentIndex, int zone) {
+    Instrument* instrument = &instruments[instrumentIndex];
+    KeySample* ks = &instrument->keySamples[zone];
+    
+    if (zoneLoadMutex) xSemaphoreTake(zoneLoadMutex, portMAX_DELAY);
+    if (ks->isLoaded || ks->loadFailed) {
+        if (zoneLoadMutex) xSemaphoreGive(zoneLoadMutex);
+        return ks->isLoaded;
     }
+    uint32_t started = millis();
+    
+    // Shared with any other zone that loaded the same file and loop
+    Sample* sample = loadSampleFromSD(ks->filename.c_str(), ks->rootNote, &ks->loop);
     
     if (!sample) {
-        DEBUG("Could not find loaded sample");
+        DEBUGF("Failed to load sample %s\n", ks->filename.c_str());
+        ks->loadFailed = true;
+        zoneStats.failures++;
+        buildNoteMap(instrument);
+        if (zoneLoadMutex) xSemaphoreGive(zoneLoadMutex);
         return false;
     }
     
-    // Add to instrument's key samples
-    KeySample* ks = &instrument->keySamples[instrument->numKeySamples];
+    // Highest notes in the range need half-rate copies to avoid aliasing
+    int mipLevels = 0;
+    float maxRatio = calculatePitchRatio((int)ks->maxNote - (int)ks->rootNote);
+    while (maxRatio >= MIP_SWITCH_RATIO && mipLevels < SAMPLE_MIP_LEVELS) {
+        maxRatio *= 0.5f;
+        mipLevels++;
+    }
+    if (mipLevels > 0) {
+        buildSampleMipmaps(sample, mipLevels);
+    }
+    
     ks->sample = sample;
-    ks->rootNote = rootNote;
-    ks->minNote = minNote;
-    ks->maxNote = maxNote;
-    ks->isLoaded = true;
+    ks->isLoaded = true;        // Set after the sample so a note on never sees it half done
+    buildNoteMap(instrument);
     
-    instrument->numKeySamples++;
+    uint32_t elapsed = millis() - started;
+    trace(TRACE_SD_READ, TRACE_SRC_ZONE_LOAD, elapsed * 1000);
+    zoneStats.loads++;
+    zoneStats.loadMs += elapsed;
+    if (elapsed > zoneStats.maxLoadMs) zoneStats.maxLoadMs = elapsed;
+    if (zoneLoadMutex) xSemaphoreGive(zoneLoadMutex);
     
-    DEBUGF("Loaded key sample: %s -> root=%d, range=%d-%d\n", filename, rootNote, minNote, maxNote);
+    DEBUGF("Loaded key sample: %s -> root=%d, range=%d-%d (%lu ms)\n", ks->filename.c_str(),
+           ks->rootNote, ks->minNote, ks->maxNote, (unsigned long)elapsed);
     
     return true;
 }
 
+void finishInstrumentZones(int instrumentIndex) {
+    if (instrumentIndex < 0 || instrumentIndex >= loadedInstruments) return;
+    if (zoneLoadMutex) xSemaphoreTake(zoneLoadMutex, portMAX_DELAY);
+    buildNoteMap(&instruments[instrumentIndex]);
+    if (zoneLoadMutex) xSemaphoreGive(zoneLoadMutex);
+}
+
+bool loadKeySample(int instrumentIndex, const char* filename, uint8_t rootNote, uint8_t minNote, uint8_t maxNote) {
+    int zone = addInstrumentZone(instrumentIndex, filename, rootNote, minNote, maxNote);
+    if (zone < 0) return false;
+    finishInstrumentZones(instrumentIndex);
+    return loadZone(instrumentIndex, zone);
+}
+
+void preloadInstrument(int instrumentIndex) {
+    if (instrumentIndex < 0 || instrumentIndex >= loadedInstruments) return;
+    instruments[instrumentIndex].preload = true;
+    if (zoneLoaderTask) xTaskNotifyGive(zoneLoaderTask);
+}
+
+int loadAllZones() {
+    int failed = 0;
+    for (int i = 0; i < loadedInstruments; i++) {
+        for (int z = 0; z < instruments[i].numKeySamples; z++) {
+            if (!loadZone(i, z)) failed++;
+        }
+    }
+    return failed;
+}
+
+void resetRoundRobin() {
+    for (int i = 0; i < loadedInstruments; i++) {
+        for (int z = 0; z < instruments[i].numKeySamples; z++) {
+            instruments[i].keySamples[z].rrCursor = z;
+        }
+    }
+}
+
+// Next zone of a preloading instrument still to load, once requested zones are done
+static bool nextPreloadZone(ZoneRequest& request) {
+    for (int i = 0; i < loadedInstruments; i++) {
+        Instrument* instrument = &instruments[i];
+        if (!instrument->preload) continue;
+        for (int z = 0; z < instrument->numKeySamples; z++) {
+            KeySample* ks = &instrument->keySamples[z];
+            if (!ks->isLoaded && !ks->loadFailed) {
+                request.instrument = i;
+                request.zone = z;
+                return true;
+            }
+        }
+        instrument->preload = false;
+    }
+    return false;
+}
+
+bool initZoneLoader() {
+    memset(&zoneStats, 0, sizeof(zoneStats));
+    zoneLoadMutex = xSemaphoreCreateMutex();
+    if (!zoneLoadMutex) {
+        DEBUG("Failed to create zone loader mutex");
+        return false;
+    }
+
+    // Below the SD streaming tasks on core 1, zone loads are never urgent enough to starve them
+    BaseType_t result = xTaskCreatePinnedToCore(
+        zoneLoaderTaskCode,
+        "ZoneLoader",
+        4096,
+        NULL,
+        1,
+        &zoneLoaderTask,
+        1
+    );
+    if (result != pdPASS) {
+        DEBUGF("Failed to create zone loader task, error: %d\n", result);
+        return false;
+    }
+    return true;
+}
+
+void zoneLoaderTaskCode(void* parameter) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (true) {
+            // Notes waiting on a zone come before preloading
+            ZoneRequest request;
+            uint32_t tail = zoneQueueTail;
+            bool requested = tail != __atomic_load_n(&zoneQueueHead, __ATOMIC_ACQUIRE);
+            if (requested) {
+                request = zoneQueue[tail & (ZONE_LOAD_QUEUE - 1)];
+                __atomic_store_n(&zoneQueueTail, tail + 1, __ATOMIC_RELEASE);
+            }
+            if (!requested && !nextPreloadZone(request)) break;
+
+            loadZone(request.instrument, request.zone);
+            instruments[request.instrument].keySamples[request.zone].loadQueued = false;
+        }
+    }
+}
+
+// Parse a note range "lo-hi" or a single note
+static bool parseRange(const char* text, int& low, int& high) {
+    int parsed = sscanf(text, "%d-%d", &low, &high);
+    if (parsed == 1) high = low;
+    return parsed >= 1 && low >= 0 && high <= 127 && low <= high;
+}
+
+int loadInstrumentManifest(const char* path) {
+    File file = SD_MMC.open(path);
+    if (!file) {
+        DEBUGF("Failed to open manifest: %s\n", path);
+        return -1;
+    }
+    
+    // Named after the file until a "name" line says otherwise
+    String name = path;
+    name = name.substring(name.lastIndexOf('/') + 1);
+    if (name.lastIndexOf('.') > 0) name = name.substring(0, name.lastIndexOf('.'));
+    int index = createInstrument(name.c_str());
+    if (index < 0) {
+        file.close();
+        return -1;
+    }
+    Instrument* instrument = &instruments[index];
+    bool preload = false;
+    int channel = 0;
+    float crossfadeMs = 0.0f;
+    int lineNumber = 0;
+    
+    while (file.available()) {
+        String line = file.readStringUntil('\n');
+        lineNumber++;
+        int comment = line.indexOf('#');
+        if (comment >= 0) line = line.substring(0, comment);
+        line.trim();
+        if (line.length() == 0) continue;
+        
+        int space = line.indexOf(' ');
+        String key = space < 0 ? line : line.substring(0, space);
+        String value = space < 0 ? String("") : line.substring(space + 1);
+        value.trim();
+        bool valid = true;
+        
+        if (key == "name") {
+            instrument->name = value;
+        } else if (key == "envelope") {
+            // envelope <attack ms> <decay ms> <sustain 0-1> <release ms> [lin|exp]
+            EnvelopeSettings env = instrument->envelope;
+            char curve[8] = "";
+            valid = sscanf(value.c_str(), "%f %f %f %f %7s",
+                           &env.attackMs, &env.decayMs, &env.sustainLevel, &env.releaseMs, curve) >= 4;
+            if (strcmp(curve, "exp") == 0) env.curve = ENV_CURVE_EXPONENTIAL;
+            else if (strcmp(curve, "lin") == 0) env.curve = ENV_CURVE_LINEAR;
+            if (valid) instrument->envelope = env;
+        } else if (key == "interp") {
+            InterpMode mode;
+            valid = parseInterpMode(value.c_str(), mode);
+            if (valid) instrument->interpMode = mode;
+        } else if (key == "channel") {
+            channel = value.toInt();
+            valid = channel >= 1 && channel <= MIDI_CHANNELS;
+        } else if (key == "preload") {
+            preload = true;
+        } else if (key == "zone") {
+            // zone <file> <root> [keys lo-hi] [velocity lo-hi] [loop=start-end] [xfade=ms]
+            // Zones repeating the same ranges are round robin alternatives
+            LoopSettings loop = { 0, 0, -1.0f };
+            int options = value.indexOf('=');
+            if (options >= 0) {
+                options = value.lastIndexOf(' ', options) + 1;
+                String rest = value.substring(options);
+                value = value.substring(0, options);
+                int loopAt = rest.indexOf("loop=");
+                int fadeAt = rest.indexOf("xfade=");
+                unsigned long loopStart, loopEnd;
+                if (loopAt >= 0) {
+                    valid = sscanf(rest.c_str() + loopAt + 5, "%lu-%lu", &loopStart, &loopEnd) == 2 &&
+                            loopEnd > loopStart;
+                    loop.start = loopStart;
+                    loop.end = loopEnd;
+                }
+                if (fadeAt >= 0) loop.crossfadeMs = rest.substring(fadeAt + 6).toFloat();
+            }
+            char filename[96];
+            char keys[16] = "";
+            char velocity[16] = "";
+            int root, minNote, maxNote, minVelocity = 0, maxVelocity = 127;
+            int parsed = sscanf(value.c_str(), "%95s %d %15s %15s", filename, &root, keys, velocity);
+            valid = valid && parsed >= 2 && root >= 0 && root <= 127;
+            if (parsed >= 3) valid = valid && parseRange(keys, minNote, maxNote);
+            else minNote = maxNote = root;
+            if (parsed >= 4) valid = valid && parseRange(velocity, minVelocity, maxVelocity);
+            if (valid) {
+                int zone = addInstrumentZone(index, filename, root, minNote, maxNote, minVelocity, maxVelocity);
+                if (zone >= 0) instrument->keySamples[zone].loop = loop;
+            }
+        } else if (key == "crossfade") {
+            // Loop crossfade for zones without their own xfade=
+            crossfadeMs = value.toFloat();
+            valid = crossfadeMs >= 0.0f;
+        } else {
+            valid = false;
+        }
+        
+        if (!valid) {
+            DEBUGF("%s:%d: ignored '%s'\n", path, lineNumber, line.c_str());
+        }
+    }
+    file.close();
+    
+    for (int i = 0; i < instrument->numKeySamples; i++) {
+        LoopSettings& loop = instrument->keySamples[i].loop;
+        if (loop.crossfadeMs < 0.0f) loop.crossfadeMs = crossfadeMs;
+    }
+    finishInstrumentZones(index);
+    if (channel > 0) channelInstruments[channel - 1] = index;
+    if (preload) preloadInstrument(index);
+    
+    DEBUGF("Instrument %s: %d zones in %d velocity layers from %s%s\n", instrument->name.c_str(),
+           instrument->numKeySamples, instrument->numVelocityLayers, path, preload ? ", preloading" : "");
+    return index;
+}
+
+int loadInstrumentManifests() {
+    File dir = SD_MMC.open(INSTRUMENT_DIR);
+    if (!dir || !dir.isDirectory()) {
+        DEBUGF("No instrument manifests (%s not found)\n", INSTRUMENT_DIR);
+        return 0;
+    }
+    
+    int count = 0;
+    File file = dir.openNextFile();
+    while (file) {
+        String path = String(INSTRUMENT_DIR) + "/" + file.name();
+        bool manifest = !file.isDirectory() && path.endsWith(".inst");
+        file.close();
+        if (manifest && loadInstrumentManifest(path.c_str()) >= 0) count++;
+        file = dir.openNextFile();
+    }
+    dir.close();
+    return count;
+}
+
+void printZoneStatus() {
+    for (int i = 0; i < loadedInstruments; i++) {
+        Instrument* instrument = &instruments[i];
+        int resident = 0;
+        int failed = 0;
+        for (int z = 0; z < instrument->numKeySamples; z++) {
+            if (instrument->keySamples[z].isLoaded) resident++;
+            if (instrument->keySamples[z].loadFailed) failed++;
+        }
+        size_t bytes = getInstrumentMemoryUsage(instrument);
+        DEBUGF("  %d: %s - %d/%d zones loaded%s, %d velocity layers, %.1f KB PSRAM\n", i,
+               instrument->name.c_str(), resident, instrument->numKeySamples, failed ? " (some failed)" : "",
+               instrument->numVelocityLayers, bytes / 1024.0f);
+    }
+    DEBUGF("Zone loads: %lu (avg %lu ms, max %lu ms), %lu failed, %d queued\n",
+           (unsigned long)zoneStats.loads,
+           (unsigned long)(zoneStats.loads ? zoneStats.loadMs / zoneStats.loads : 0),
+           (unsigned long)zoneStats.maxLoadMs, (unsigned long)zoneStats.failures, (int)(zoneQueueHead - zoneQueueTail));
+    DEBUGF("Notes while loading: %lu played by a nearby zone, %lu dropped\n",
+           (unsigned long)zoneStats.standIns, (unsigned long)zoneStats.dropped);
+}
+
 int createInstrument(const char* name) {
     if (loadedInstruments >= MAX_INSTRUMENTS) {
         DEBUG("Cannot create more instruments");
@@ -102,13 +577,22 @@ int createInstrument(const char* name) {
     Instrument* instrument = &instruments[loadedInstruments];
     instrument->name = name;
     instrument->numKeySamples = 0;
+    instrument->envelope = defaultEnvelope;
+    instrument->interpMode = INTERP_LINEAR;
     instrument->isLoaded = true;
+    instrument->preload = false;
     
     // Initialize key samples
-    for (int i = 0; i < MAX_SAMPLES; i++) {
+    for (int i = 0; i < MAX_ZONES; i++) {
         instrument->keySamples[i].isLoaded = false;
+        instrument->keySamples[i].loadQueued = false;
+        instrument->keySamples[i].loadFailed = false;
         instrument->keySamples[i].sample = nullptr;
     }
+    memset(instrument->velocityLayer, 0, sizeof(instrument->velocityLayer));
+    instrument->numVelocityLayers = 1;
+    memset(instrument->zoneGrid, NO_KEY_SAMPLE, sizeof(instrument->zoneGrid));
+    memset(instrument->residentMap, NO_KEY_SAMPLE, sizeof(instrument->residentMap));
     
     DEBUGF("Created instrument: %s (index %d)\n", name, loadedInstruments);
     
@@ -122,6 +606,30 @@ void selectInstrument(int instrumentIndex) {
     }
 }
 
+void setInstrumentEnvelope(int instrumentIndex, const EnvelopeSettings& envelope) {
+    if (instrumentIndex < 0 || instrumentIndex >= loadedInstruments) {
+        DEBUG("Invalid instrument index");
+        return;
+    }
+    
+    // Only affects notes started after this call
+    instruments[instrumentIndex].envelope = envelope;
+    DEBUGF("Envelope for %s: A=%.1fms D=%.1fms S=%.2f R=%.1fms (%s)\n",
+           instruments[instrumentIndex].name.c_str(), envelope.attackMs, envelope.decayMs,
+           envelope.sustainLevel, envelope.releaseMs,
+           envelope.curve == ENV_CURVE_EXPONENTIAL ? "exp" : "linear");
+}
+
+void setInstrumentInterpolation(int instrumentIndex, InterpMode mode) {
+    if (instrumentIndex < 0 || instrumentIndex >= loadedInstruments) {
+        DEBUG("Invalid instrument index");
+        return;
+    }
+    
+    instruments[instrumentIndex].interpMode = mode;
+    DEBUGF("Interpolation for %s: %s\n", instruments[instrumentIndex].name.c_str(), interpModeName(mode));
+}
+
 Instrument* getCurrentInstrument() {
     if (currentInstrument >= 0 && currentInstrument < loadedInstruments) {
         return &instruments[currentInstrument];
@@ -129,17 +637,51 @@ Instrument* getCurrentInstrument() {
     return nullptr;
 }
 
+void setChannelInstrument(uint8_t channel, int instrumentIndex) {
+    if (channel >= MIDI_CHANNELS || instrumentIndex < -1 || instrumentIndex >= loadedInstruments) {
+        DEBUG("Invalid channel or instrument index");
+        return;
+    }
+    channelInstruments[channel] = instrumentIndex;
+    if (instrumentIndex < 0) {
+        DEBUGF("Channel %d follows the selected instrument\n", channel + 1);
+    } else {
+        DEBUGF("Channel %d: %s\n", channel + 1, instruments[instrumentIndex].name.c_str());
+    }
+}
+
+Instrument* getChannelInstrument(uint8_t channel) {
+    int index = channel < MIDI_CHANNELS ? channelInstruments[channel] : -1;
+    return index >= 0 ? &instruments[index] : getCurrentInstrument();
+}
+
+void printChannelMap() {
+    for (int c = 0; c < MIDI_CHANNELS; c++) {
+        Instrument* instrument = getChannelInstrument(c);
+        DEBUGF("  Channel %2d: %s%s\n", c + 1, instrument ? instrument->name.c_str() : "None",
+               channelInstruments[c] < 0 ? " (selected)" : "");
+    }
+}
+
 void loadBasicPiano() {
     int pianoIndex = createInstrument("Basic Piano");
     if (pianoIndex == -1) return;
     
-    // Load key samples with appropriate ranges
+    // Slow decay towards a quiet sustain with a natural release
+    instruments[pianoIndex].envelope = { 2.0f, 3000.0f, 0.3f, 400.0f, ENV_CURVE_EXPONENTIAL };
+    
+    // Each key sample is stretched up to half an octave either way
+    instruments[pianoIndex].interpMode = INTERP_HERMITE;
+    
+    // Key samples with appropriate ranges, loaded in the background
     // Low range
-    loadKeySample(pianoIndex, "piano_C2.wav", 36, 24, 42);    // C2, covers C1-F#2
-    loadKeySample(pianoIndex, "piano_C3.wav", 48, 43, 54);    // C3, covers G2-F#3
-    loadKeySample(pianoIndex, "piano_C4.wav", 60, 55, 66);    // C4 (middle C), covers G3-F#4
-    loadKeySample(pianoIndex, "piano_C5.wav", 72, 67, 78);    // C5, covers G4-F#5
-    loadKeySample(pianoIndex, "piano_C6.wav", 84, 79, 96);    // C6, covers G5-C7
+    addInstrumentZone(pianoIndex, "piano_C2.wav", 36, 24, 42);    // C2, covers C1-F#2
+    addInstrumentZone(pianoIndex, "piano_C3.wav", 48, 43, 54);    // C3, covers G2-F#3
+    addInstrumentZone(pianoIndex, "piano_C4.wav", 60, 55, 66);    // C4 (middle C), covers G3-F#4
+    addInstrumentZone(pianoIndex, "piano_C5.wav", 72, 67, 78);    // C5, covers G4-F#5
+    addInstrumentZone(pianoIndex, "piano_C6.wav", 84, 79, 96);    // C6, covers G5-C7
+    finishInstrumentZones(pianoIndex);
+    preloadInstrument(pianoIndex);
     
     DEBUGF("Loaded Basic Piano instrument with %d key samples\n", instruments[pianoIndex].numKeySamples);
 }
@@ -148,13 +690,21 @@ void loadBasicDrumKit() {
     int drumIndex = createInstrument("Basic Drums");
     if (drumIndex == -1) return;
     
+    // Let hits ring out after a short MIDI note
+    instruments[drumIndex].envelope = { 0.5f, 0.0f, 1.0f, 800.0f, ENV_CURVE_EXPONENTIAL };
+    
     // Load drum samples to specific MIDI notes (GM drum map)
-    loadKeySample(drumIndex, "kick.wav", 36, 36, 36);        // Bass Drum 1
-    loadKeySample(drumIndex, "snare.wav", 38, 38, 38);       // Acoustic Snare
-    loadKeySample(drumIndex, "hihat_closed.wav", 42, 42, 42); // Closed Hi Hat
-    loadKeySample(drumIndex, "hihat_open.wav", 46, 46, 46);   // Open Hi Hat
-    loadKeySample(drumIndex, "crash.wav", 49, 49, 49);       // Crash Cymbal 1
-    loadKeySample(drumIndex, "ride.wav", 51, 51, 51);        // Ride Cymbal 1
+    addInstrumentZone(drumIndex, "kick.wav", 36, 36, 36);        // Bass Drum 1
+    addInstrumentZone(drumIndex, "snare.wav", 38, 38, 38);       // Acoustic Snare
+    addInstrumentZone(drumIndex, "hihat_closed.wav", 42, 42, 42); // Closed Hi Hat
+    addInstrumentZone(drumIndex, "hihat_open.wav", 46, 46, 46);   // Open Hi Hat
+    addInstrumentZone(drumIndex, "crash.wav", 49, 49, 49);       // Crash Cymbal 1
+    addInstrumentZone(drumIndex, "ride.wav", 51, 51, 51);        // Ride Cymbal 1
+    finishInstrumentZones(drumIndex);
+    preloadInstrument(drumIndex);
+    
+    // GM drums live on channel 10
+    channelInstruments[9] = drumIndex;
     
     DEBUGF("Loaded Basic Drums instrument with %d key samples\n", instruments[drumIndex].numKeySamples);
 }
\ No newline at end of file
@@ -8,8 +8,59 @@
 extern Instrument instruments[MAX_INSTRUMENTS];
 extern int currentInstrument;
 extern int loadedInstruments;
+extern int8_t channelInstruments[MIDI_CHANNELS];   // -1 follows the selected instrument
 
-// Load a key sample into an instrument
+// Background zone loading activity
+struct ZoneLoaderStats {
+    uint32_t loads;
+    uint32_t failures;
+    uint32_t loadMs;           // Total time spent loading
+    uint32_t maxLoadMs;
+    uint32_t standIns;         // Notes played by a nearby zone while theirs loaded
+    uint32_t dropped;          // Notes with no loaded zone to play
+};
+
+extern ZoneLoaderStats zoneStats;
+
+// Start the background loader (before any instrument is defined)
+bool initZoneLoader();
+
+// Read every manifest in INSTRUMENT_DIR, returns how many instruments were created.
+// Manifests are plain text, one setting per line, '#' starts a comment:
+//   name Grand Piano
+//   envelope 2 3000 0.3 400 exp      (attack ms, decay ms, sustain, release ms, lin|exp)
+//   interp hermite
+//   channel 1                        (MIDI channel that plays it)
+//   preload                          (load every zone in the background)
+//   crossfade 20                     (loop crossfade in ms for zones without xfade=)
+//   zone piano_C4.wav 60 55-66 0-127 (file, root, key range, velocity range)
+//   zone pad_C4.wav 60 55-66 loop=8820-52920 xfade=30   (loop frames override the smpl chunk)
+// Zones with the same key and velocity ranges take turns (round robin).
+int loadInstrumentManifests();
+int loadInstrumentManifest(const char* path);
+
+// Define a zone without loading it; returns the zone index or -1.
+// Call finishInstrumentZones() once the instrument's zones are all added.
+int addInstrumentZone(int instrumentIndex, const char* filename, uint8_t rootNote, uint8_t minNote, uint8_t maxNote,
+                      uint8_t minVelocity = 0, uint8_t maxVelocity = 127);
+void finishInstrumentZones(int instrumentIndex);
+
+// Queue the zones around a note that was just played
+void prefetchZones(Instrument* instrument, uint8_t midiNote, uint8_t velocity);
+
+// Load every zone of an instrument in the background
+void preloadInstrument(int instrumentIndex);
+
+// Load every zone of every instrument now, returns how many failed (render tests)
+int loadAllZones();
+
+// Every round robin ring back to its first recording (render tests)
+void resetRoundRobin();
+
+void printZoneStatus();
+void zoneLoaderTaskCode(void* parameter);
+
+// Define a zone and load it now
 bool loadKeySample(int instrumentIndex, const char* filename, uint8_t rootNote, uint8_t minNote, uint8_t maxNote);
 
 // Create a new instrument
@@ -18,9 +69,20 @@ int createInstrument(const char* name);
 // Select current instrument
 void selectInstrument(int instrumentIndex);
 
+// Set attack/decay/sustain/release for an instrument
+void setInstrumentEnvelope(int instrumentIndex, const EnvelopeSettings& envelope);
+
+// Set the interpolation quality used for an instrument
+void setInstrumentInterpolation(int instrumentIndex, InterpMode mode);
+
 // Get the current instrument
 Instrument* getCurrentInstrument();
 
+// Map a MIDI channel (0-15) to an instrument, or -1 to follow the selected one
+void setChannelInstrument(uint8_t channel, int instrumentIndex);
+Instrument* getChannelInstrument(uint8_t channel);
+void printChannelMap();
+
 // Load a basic piano instrument (example)
 void loadBasicPiano();
 
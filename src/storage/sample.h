@@ -1,15 +1,54 @@
 #pragma once
 
 #include <Arduino.h>
+#include "../config.h"
+
+// Silent guard frames stored before and after every sample so interpolation
+// kernels can read their neighbour taps without bounds checks
+#define SAMPLE_PAD_FRAMES 4
+
+// Level 0 is the original recording, each further level is band-limited to half the rate
+#define MAX_MIP_LEVELS (SAMPLE_MIP_LEVELS + 1)
+
+// Loop points given by a manifest, overriding the WAV's smpl chunk
+struct LoopSettings {
+    uint32_t start;
+    uint32_t end;           // Exclusive, 0 = use the smpl chunk if there is one
+    float crossfadeMs;      // Blended into the end of the loop at load time, 0 = none
+};
 
 struct Sample {
-    int16_t* data;          // Sample data in RAM
+    int16_t* data;          // Sample data in RAM (first real frame, guard frames either side)
     uint32_t length;        // Length in samples (not bytes)
     uint8_t midiNote;       // MIDI note that triggers this sample
     bool isLoaded;          // Whether sample is loaded in RAM
     String filename;        // Original filename
     uint16_t sampleRate;    // Original sample rate
-    uint8_t channels;       // 1 = mono, 2 = stereo
+    uint8_t channels;       // Interleaved in memory: 1 = mono, 2 = stereo (streamed samples are always stereo)
+    
+    // Pre-filtered octave copies for pitching up, mipData[0] == data
+    int16_t* mipData[MAX_MIP_LEVELS];
+    uint32_t mipLength[MAX_MIP_LEVELS];
+    uint8_t numMipLevels;
+
+    // Sustain loop: looped samples end at loopEnd and play loopStart..loopEnd until the
+    // envelope finishes. The guard frames after the end repeat the loop start.
+    bool looped;
+    uint32_t loopStart;     // Level 0 frames, level n starts at loopStart >> n
+    uint32_t loopEnd;       // Exclusive, == length when looped
+
+    // Disk streaming: only the head is resident, the rest is read from the file as voices play
+    bool streamed;
+    uint32_t headLength;    // Resident frames at `data` (== length when not streamed)
+    uint32_t dataOffset;    // File offset of the first frame
+    uint8_t fileChannels;   // Channels on disk
+
+    // Sharing: a later load of the same file, unchanged and with the same loop, gets this copy
+    uint32_t sourceHash;    // Path, size, date and loop settings
+    uint32_t sourceSize;
+    uint32_t sourceModified;
+    LoopSettings sourceLoop;
+    uint16_t refCount;      // Loads that returned this sample
 };
 
 // WAV header structure
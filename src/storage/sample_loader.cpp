@@ -1,17 +1,94 @@
 #include "sample_loader.h"
 #include "../config.h"
+#include "../audio/sample_streamer.h"
 #include "../debug.h"
 #include "FS.h"
 #include "SD_MMC.h"
+#include <math.h>
 
 Sample samples[MAX_SAMPLES];
 
-bool loadSampleFromSD(const char* filename, uint8_t midiNote) {
-    if (loadedSamples >= MAX_SAMPLES) {
-        DEBUGF("Cannot load more samples (max %d)\n", MAX_SAMPLES);
-        return false;
+// Half-band lowpass used to build each mip level (cutoff at a quarter of the source rate)
+#define HALFBAND_TAPS 31
+static float halfbandTaps[HALFBAND_TAPS];
+static bool halfbandReady = false;
+static size_t mipmapBytes = 0;
+
+// Shortest loop kept, so a voice never wraps more than once per frame
+#define MIN_LOOP_FRAMES 16
+
+// Loaded samples by source, open addressing with linear probing. Entries are
+// samples[] index + 1, 0 is empty. Only loads change it, and those are serialised
+// by the zone loader's lock.
+#define SAMPLE_INDEX_SLOTS (MAX_SAMPLES * 2)
+static_assert((SAMPLE_INDEX_SLOTS & (SAMPLE_INDEX_SLOTS - 1)) == 0, "SAMPLE_INDEX_SLOTS must be a power of two");
+static uint16_t sampleIndex[SAMPLE_INDEX_SLOTS];
+
+static uint32_t hashBytes(uint32_t hash, const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// FNV-1a over everything that decides the PCM a load produces
+static uint32_t hashSampleSource(const String& path, uint32_t size, uint32_t modified, const LoopSettings& loop) {
+    uint32_t hash = hashBytes(2166136261u, path.c_str(), path.length());
+    hash = hashBytes(hash, &size, sizeof(size));
+    hash = hashBytes(hash, &modified, sizeof(modified));
+    hash = hashBytes(hash, &loop.start, sizeof(loop.start));
+    hash = hashBytes(hash, &loop.end, sizeof(loop.end));
+    return hashBytes(hash, &loop.crossfadeMs, sizeof(loop.crossfadeMs));
+}
+
+static Sample* findLoadedSample(uint32_t hash, const String& path, uint32_t size, uint32_t modified,
+                                const LoopSettings& loop) {
+    for (uint32_t slot = hash & (SAMPLE_INDEX_SLOTS - 1); sampleIndex[slot]; slot = (slot + 1) & (SAMPLE_INDEX_SLOTS - 1)) {
+        Sample& sample = samples[sampleIndex[slot] - 1];
+        if (sample.sourceHash == hash && sample.sourceSize == size && sample.sourceModified == modified &&
+            sample.sourceLoop.start == loop.start && sample.sourceLoop.end == loop.end &&
+            sample.sourceLoop.crossfadeMs == loop.crossfadeMs && sample.filename == path) {
+            return &sample;
+        }
+    }
+    return nullptr;
+}
+
+static void indexSample(int index) {
+    uint32_t slot = samples[index].sourceHash & (SAMPLE_INDEX_SLOTS - 1);
+    while (sampleIndex[slot]) slot = (slot + 1) & (SAMPLE_INDEX_SLOTS - 1);
+    sampleIndex[slot] = index + 1;
+}
+
+// Blend the end of the loop towards the frames leading into its start, so the
+// wrap lands on a continuation of what was just played (equal power)
+static void bakeLoopCrossfade(int16_t* data, uint8_t channels, uint32_t loopStart, uint32_t loopEnd, uint32_t frames) {
+    frames = min(frames, min(loopStart, (loopEnd - loopStart) / 2));
+    for (uint32_t i = 0; i < frames; i++) {
+        float t = (float)(i + 1) / frames;
+        float fadeOut = cosf(t * PI * 0.5f);
+        float fadeIn = sinf(t * PI * 0.5f);
+        int16_t* dst = data + (loopEnd - frames + i) * channels;
+        const int16_t* src = data + (loopStart - frames + i) * channels;
+        for (int c = 0; c < channels; c++) {
+            dst[c] = (int16_t)constrain(dst[c] * fadeOut + src[c] * fadeIn, -32768.0f, 32767.0f);
+        }
     }
+}
 
+// Guard frames after a looped level carry on from the loop start for the interpolation taps
+static void fillLoopGuard(int16_t* data, uint8_t channels, uint32_t loopStart, uint32_t loopEnd) {
+    for (uint32_t i = 0; i < SAMPLE_PAD_FRAMES; i++) {
+        uint32_t src = loopStart + i % (loopEnd - loopStart);
+        for (int c = 0; c < channels; c++) {
+            data[(loopEnd + i) * channels + c] = data[src * channels + c];
+        }
+    }
+}
+
+Sample* loadSampleFromSD(const char* filename, uint8_t midiNote, const LoopSettings* loop) {
     String filepath = String(filename);
     if (!filepath.startsWith("/")) {
         filepath = "/" + filepath;
@@ -20,7 +97,26 @@ bool loadSampleFromSD(const char* filename, uint8_t midiNote) {
     File file = SD_MMC.open(filepath.c_str());
     if (!file) {
         DEBUGF("Failed to open file: %s\n", filepath.c_str());
-        return false;
+        return nullptr;
+    }
+
+    // Another instrument (or a reload of this one) may already hold this exact PCM
+    LoopSettings sourceLoop = loop ? *loop : LoopSettings{ 0, 0, 0.0f };
+    uint32_t sourceSize = file.size();
+    uint32_t sourceModified = (uint32_t)file.getLastWrite();
+    uint32_t sourceHash = hashSampleSource(filepath, sourceSize, sourceModified, sourceLoop);
+    Sample* shared = findLoadedSample(sourceHash, filepath, sourceSize, sourceModified, sourceLoop);
+    if (shared) {
+        file.close();
+        shared->refCount++;
+        DEBUGF("Sharing loaded sample: %s (%d users)\n", filepath.c_str(), shared->refCount);
+        return shared;
+    }
+
+    if (loadedSamples >= MAX_SAMPLES) {
+        DEBUGF("Cannot load more samples (max %d)\n", MAX_SAMPLES);
+        file.close();
+        return nullptr;
     }
 
     // Read WAV header
@@ -28,80 +124,276 @@ bool loadSampleFromSD(const char* filename, uint8_t midiNote) {
     if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) {
         DEBUG("Failed to read WAV header");
         file.close();
-        return false;
+        return nullptr;
     }
 
     // Verify WAV format
     if (strncmp(header.riff, "RIFF", 4) != 0 || strncmp(header.wave, "WAVE", 4) != 0) {
         DEBUG("Invalid WAV file format");
         file.close();
-        return false;
+        return nullptr;
     }
 
-    // Find data chunk
+    // Walk every chunk: the data, and the smpl loop that editors often write after it
     char chunkId[4];
     uint32_t chunkSize;
+    uint32_t dataOffset = 0;
+    uint32_t dataSize = 0;
     bool dataFound = false;
+    uint32_t fileLoopStart = 0;
+    uint32_t fileLoopEnd = 0;
+    file.seek(20 + header.fmtSize + (header.fmtSize & 1));
     
-    while (file.available() && !dataFound) {
+    while (file.available() >= 8) {
         file.read((uint8_t*)chunkId, 4);
         file.read((uint8_t*)&chunkSize, 4);
+        uint32_t chunkStart = file.position();
         
         if (strncmp(chunkId, "data", 4) == 0) {
             dataFound = true;
-        } else {
-            file.seek(file.position() + chunkSize);
+            dataOffset = chunkStart;
+            dataSize = min(chunkSize, (uint32_t)file.size() - chunkStart);
+        } else if (strncmp(chunkId, "smpl", 4) == 0 && chunkSize >= 60) {
+            // 9 header words, then the first loop: cue id, type, start, end (inclusive), fraction, count
+            uint32_t smpl[15];
+            file.read((uint8_t*)smpl, sizeof(smpl));
+            if (smpl[7] > 0 && smpl[10] == 0 && smpl[12] > smpl[11]) {
+                fileLoopStart = smpl[11];
+                fileLoopEnd = smpl[12] + 1;
+            }
         }
+        file.seek(chunkStart + chunkSize + (chunkSize & 1));
     }
 
     if (!dataFound) {
         DEBUG("Data chunk not found");
         file.close();
-        return false;
+        return nullptr;
     }
 
     // Calculate sample count
     uint32_t bytesPerSample = header.bitsPerSample / 8 * header.numChannels;
-    uint32_t sampleCount = chunkSize / bytesPerSample;
+    uint32_t sampleCount = dataSize / bytesPerSample;
+
+    // A manifest loop wins over the file's own
+    uint32_t loopStart = fileLoopStart;
+    uint32_t loopEnd = fileLoopEnd;
+    if (loop && loop->end > 0) {
+        loopStart = loop->start;
+        loopEnd = loop->end;
+    }
+    bool looped = loopEnd > 0;
+    if (looped && (loopEnd > sampleCount || loopEnd - loopStart < MIN_LOOP_FRAMES || loopStart >= loopEnd)) {
+        DEBUGF("Ignoring loop %lu-%lu in %s (%lu frames)\n", (unsigned long)loopStart,
+               (unsigned long)loopEnd, filename, (unsigned long)sampleCount);
+        looped = false;
+    }
+    if (looped) {
+        // Nothing after the loop is ever played
+        sampleCount = loopEnd;
+    }
+
+    // Long samples keep only a head resident and stream the rest from SD. Looped
+    // samples always load whole: the loop is what keeps them short.
+    uint32_t headFrames = sampleCount;
+    bool streamed = !looped && sampleStreamTask && SAMPLE_STREAM_MIN_KB > 0 &&
+                    (uint64_t)sampleCount * 4 > (uint64_t)SAMPLE_STREAM_MIN_KB * 1024;
+    if (streamed) {
+        headFrames = min(sampleCount, (uint32_t)((uint64_t)header.sampleRate * SAMPLE_HEAD_MS / 1000));
+        streamed = headFrames < sampleCount && headFrames > STREAM_HEAD_OVERLAP;
+        if (!streamed) headFrames = sampleCount;
+    }
+    file.seek(dataOffset);
 
-    // Allocate memory (prefer PSRAM)
-    int16_t* sampleData = (int16_t*)ps_malloc(sampleCount * 2 * sizeof(int16_t)); // Always allocate for stereo
-    if (!sampleData) {
+    // Resident mono stays mono (half the PSRAM, and the kernels interpolate one
+    // channel). A streamed head matches the stereo ring it hands over to.
+    uint8_t channels = (header.numChannels == 1 && !streamed) ? 1 : 2;
+
+    // Allocate memory (prefer PSRAM) plus zeroed guard frames
+    size_t allocFrames = headFrames + 2 * SAMPLE_PAD_FRAMES;
+    int16_t* allocation = (int16_t*)ps_calloc(allocFrames * channels, sizeof(int16_t));
+    if (!allocation) {
         DEBUGF("Failed to allocate memory for sample: %s\n", filename);
         file.close();
-        return false;
+        return nullptr;
     }
+    int16_t* sampleData = allocation + SAMPLE_PAD_FRAMES * channels;
 
     // Read and convert sample data
-    if (header.numChannels == 1) {
-        // Mono - read and duplicate to stereo
+    if (header.numChannels == channels) {
+        file.read((uint8_t*)sampleData, headFrames * channels * sizeof(int16_t));
+    } else {
+        // Streamed mono - read and duplicate to stereo
         int16_t monoSample;
-        for (uint32_t i = 0; i < sampleCount; i++) {
+        for (uint32_t i = 0; i < headFrames; i++) {
             file.read((uint8_t*)&monoSample, sizeof(int16_t));
             sampleData[i * 2] = monoSample;       // Left
             sampleData[i * 2 + 1] = monoSample;   // Right
         }
-    } else {
-        // Stereo - read directly
-        file.read((uint8_t*)sampleData, sampleCount * 2 * sizeof(int16_t));
     }
 
     file.close();
 
+    if (looped) {
+        float crossfadeMs = loop ? loop->crossfadeMs : 0.0f;
+        if (crossfadeMs > 0.0f) {
+            bakeLoopCrossfade(sampleData, channels, loopStart, loopEnd, (uint32_t)(crossfadeMs * header.sampleRate / 1000.0f));
+        }
+        fillLoopGuard(sampleData, channels, loopStart, loopEnd);
+    }
+
     // Store sample info
     Sample& sample = samples[loadedSamples];
     sample.data = sampleData;
     sample.length = sampleCount;
     sample.midiNote = midiNote;
     sample.isLoaded = true;
-    sample.filename = filename;
+    sample.filename = filepath;
     sample.sampleRate = header.sampleRate;
-    sample.channels = 2; // Always stereo after conversion
+    sample.channels = channels;
+    sample.mipData[0] = sampleData;
+    sample.mipLength[0] = headFrames;
+    sample.numMipLevels = 1;
+    sample.looped = looped;
+    sample.loopStart = looped ? loopStart : 0;
+    sample.loopEnd = looped ? loopEnd : 0;
+    sample.streamed = streamed;
+    sample.headLength = headFrames;
+    sample.dataOffset = dataOffset;
+    sample.fileChannels = header.numChannels;
+    sample.sourceHash = sourceHash;
+    sample.sourceSize = sourceSize;
+    sample.sourceModified = sourceModified;
+    sample.sourceLoop = sourceLoop;
+    sample.refCount = 1;
+    indexSample(loadedSamples);
 
     loadedSamples++;
 
-    DEBUGF("Loaded sample: %s -> MIDI note %d (%d samples, %d Hz)\n", 
-           filename, midiNote, sampleCount, header.sampleRate);
+    if (streamed) {
+        DEBUGF("Loaded sample: %s -> MIDI note %d (%d samples, %d Hz, streamed with %d resident)\n",
+               filename, midiNote, sampleCount, header.sampleRate, headFrames);
+    } else if (looped) {
+        DEBUGF("Loaded sample: %s -> MIDI note %d (%d samples, %d Hz, loop %d-%d)\n",
+               filename, midiNote, sampleCount, header.sampleRate, loopStart, loopEnd);
+    } else {
+        DEBUGF("Loaded sample: %s -> MIDI note %d (%d samples, %d Hz)\n", 
+               filename, midiNote, sampleCount, header.sampleRate);
+    }
+
+    return &sample;
+}
+
+static void initHalfband() {
+    const int center = HALFBAND_TAPS / 2;
+    float sum = 0.0f;
+    for (int i = 0; i < HALFBAND_TAPS; i++) {
+        int n = i - center;
+        float sinc = (n == 0) ? 1.0f : sinf(PI * 0.5f * n) / (PI * 0.5f * n);
+        float w = 0.42f - 0.5f * cosf(2.0f * PI * i / (HALFBAND_TAPS - 1))
+                        + 0.08f * cosf(4.0f * PI * i / (HALFBAND_TAPS - 1));
+        halfbandTaps[i] = sinc * w;
+        sum += halfbandTaps[i];
+    }
+    for (int i = 0; i < HALFBAND_TAPS; i++) {
+        halfbandTaps[i] /= sum;
+    }
+    halfbandReady = true;
+}
+
+bool buildSampleMipmaps(Sample* sample, int levels) {
+    if (!sample || !sample->isLoaded) return false;
+    if (sample->streamed) {
+        // Mip levels need the whole sample resident; streamed voices read level 0
+        DEBUGF("Skipping mip levels for streamed sample %s\n", sample->filename.c_str());
+        return false;
+    }
+    if (!halfbandReady) initHalfband();
+
+    levels = min(levels, MAX_MIP_LEVELS - 1);
+    const int center = HALFBAND_TAPS / 2;
+    const uint8_t channels = sample->channels;
 
+    for (int level = sample->numMipLevels; level <= levels; level++) {
+        const int16_t* src = sample->mipData[level - 1];
+        int32_t srcLength = sample->mipLength[level - 1];
+        uint32_t length = (srcLength + 1) / 2;
+        if (length < 2) break;
+
+        // A loop has to land on whole frames at this level, and the filter reads round it
+        int32_t srcLoopLength = 0;
+        if (sample->looped) {
+            uint32_t mask = (1u << level) - 1;
+            if ((sample->loopStart & mask) || (sample->loopEnd & mask) ||
+                ((sample->loopEnd - sample->loopStart) >> level) < MIN_LOOP_FRAMES) {
+                DEBUGF("Loop in %s stops mip levels at %d\n", sample->filename.c_str(), level - 1);
+                break;
+            }
+            srcLoopLength = (sample->loopEnd - sample->loopStart) >> (level - 1);
+        }
+
+        size_t allocFrames = length + 2 * SAMPLE_PAD_FRAMES;
+        int16_t* allocation = (int16_t*)ps_calloc(allocFrames * channels, sizeof(int16_t));
+        if (!allocation) {
+            DEBUGF("Failed to allocate mip level %d for %s\n", level, sample->filename.c_str());
+            return false;
+        }
+        int16_t* dst = allocation + SAMPLE_PAD_FRAMES * channels;
+
+        // Filter and keep every second frame; even half-band taps are zero apart from the centre
+        for (uint32_t j = 0; j < length; j++) {
+            int32_t srcPos = (int32_t)j * 2;
+            float acc[2] = { 0.0f, 0.0f };
+            for (int k = 0; k < HALFBAND_TAPS; k++) {
+                int n = k - center;
+                if (n != 0 && (n & 1) == 0) continue;
+                int32_t idx = srcPos + k - center;
+                if (idx >= srcLength && srcLoopLength) idx -= srcLoopLength;
+                if (idx < 0 || idx >= srcLength) continue;
+                for (int c = 0; c < channels; c++) {
+                    acc[c] += halfbandTaps[k] * src[idx * channels + c];
+                }
+            }
+            for (int c = 0; c < channels; c++) {
+                dst[j * channels + c] = (int16_t)constrain(acc[c], -32768.0f, 32767.0f);
+            }
+        }
+
+        if (sample->looped) {
+            fillLoopGuard(dst, channels, sample->loopStart >> level, length);
+        }
+
+        sample->mipData[level] = dst;
+        sample->mipLength[level] = length;
+        sample->numMipLevels = level + 1;
+        mipmapBytes += allocFrames * channels * sizeof(int16_t);
+    }
+
+    DEBUGF("Built %d mip levels for %s\n", sample->numMipLevels - 1, sample->filename.c_str());
     return true;
+}
+
+size_t getMipmapMemoryUsage() {
+    return mipmapBytes;
+}
+
+size_t getSampleMemoryUsage(const Sample* sample) {
+    if (!sample || !sample->isLoaded) return 0;
+    size_t bytes = 0;
+    for (int level = 0; level < sample->numMipLevels; level++) {
+        bytes += (sample->mipLength[level] + 2 * SAMPLE_PAD_FRAMES) * sample->channels * sizeof(int16_t);
+    }
+    return bytes;
+}
+
+size_t getSharedSampleSavings(int& sharedLoads) {
+    size_t bytes = 0;
+    sharedLoads = 0;
+    for (int i = 0; i < loadedSamples; i++) {
+        if (samples[i].refCount > 1) {
+            sharedLoads += samples[i].refCount - 1;
+            bytes += (samples[i].refCount - 1) * getSampleMemoryUsage(&samples[i]);
+        }
+    }
+    return bytes;
 }
\ No newline at end of file
@@ -5,4 +5,16 @@
 
 extern Sample samples[];
 
-bool loadSampleFromSD(const char* filename, uint8_t midiNote);
\ No newline at end of file
+// Loads a WAV into PSRAM, or returns the copy already loaded from the same file
+// (same size, date and loop settings) with its reference count raised. NULL on failure.
+Sample* loadSampleFromSD(const char* filename, uint8_t midiNote, const LoopSettings* loop = nullptr);
+
+// Generate band-limited half-rate copies so high notes read near unity stride
+bool buildSampleMipmaps(Sample* sample, int levels);
+size_t getMipmapMemoryUsage();
+
+// PSRAM held by a sample and its mip levels
+size_t getSampleMemoryUsage(const Sample* sample);
+
+// PSRAM that shared loads didn't allocate, and how many loads were shared
+size_t getSharedSampleSavings(int& sharedLoads);
\ No newline at end of file
@@ -26,7 +26,8 @@ void initSD() {
     
     // Initialize SD_MMC
     // Parameters: mountpoint, mode1bit (false = 4-bit), format_if_mount_failed, max_files, frequency_khz
-    if (SD_MMC.begin("/sdcard", true, false, 20000, 5)) {
+    // Open files: MP3 stems, the PCM cache fill and the streamed sample files
+    if (SD_MMC.begin("/sdcard", true, false, 20000, 12)) {
         DEBUG("SD card initialized successfully (SDMMC 4-bit)");
         
         uint8_t cardType = SD_MMC.cardType();
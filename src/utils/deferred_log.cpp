@@ -0,0 +1,148 @@
+#include "deferred_log.h"
+#include "../debug.h"
+
+static_assert((DEBUG_LOG_QUEUE & (DEBUG_LOG_QUEUE - 1)) == 0, "DEBUG_LOG_QUEUE must be a power of two");
+
+// Bounded queue with a sequence number per slot: producers on either core
+// claim a position with a compare-and-swap, the log task is the only reader
+static LogRecord logQueue[DEBUG_LOG_QUEUE];
+static uint32_t logHead = 0;        // Next position to claim
+static uint32_t logTail = 0;        // Next position to print (log task only)
+static TaskHandle_t logTask = NULL;
+DeferredLogStats deferredLogStats = {};
+
+LogRecord* claimLogRecord(const char* format) {
+    uint32_t pos = __atomic_load_n(&logHead, __ATOMIC_RELAXED);
+    for (;;) {
+        LogRecord& record = logQueue[pos & (DEBUG_LOG_QUEUE - 1)];
+        int32_t ahead = (int32_t)(__atomic_load_n(&record.seq, __ATOMIC_ACQUIRE) - pos);
+        if (ahead == 0) {
+            if (__atomic_compare_exchange_n(&logHead, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                record.format = format;
+                record.count = 0;
+                record.textUsed = 0;
+                return &record;
+            }
+        } else if (ahead < 0) {
+            // Still holds a message from a lap ago: the log task is behind
+            __atomic_fetch_add(&deferredLogStats.dropped, 1, __ATOMIC_RELAXED);
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&logHead, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void publishLogRecord(LogRecord* record) {
+    __atomic_store_n(&record->seq, record->seq + 1, __ATOMIC_RELEASE);
+}
+
+// Formats one conversion at a time, each with the argument type its
+// specifier expects, so the stored 32-bit values are passed on correctly
+static void formatRecord(const LogRecord& record, char* out, size_t size) {
+    const char* f = record.format;
+    size_t used = 0;
+    int next = 0;
+    while (*f && used + 1 < size) {
+        if (*f != '%') {
+            out[used++] = *f++;
+            continue;
+        }
+        const char* start = f++;
+        if (*f == '%') {
+            out[used++] = *f++;
+            continue;
+        }
+        while (*f && !strchr("diuxXocfFeEgGsp", *f)) f++;
+        if (!*f) break;
+        char spec[16];
+        size_t length = min((size_t)(f - start + 1), sizeof(spec) - 1);
+        memcpy(spec, start, length);
+        spec[length] = '\0';
+        char conversion = *f++;
+        bool isLong = memchr(start, 'l', f - start) != NULL;
+
+        if (next >= record.count) break;
+        uint8_t kind = record.kinds[next];
+        int32_t asInt = kind == LOG_FLOAT ? (int32_t)record.args[next].f : record.args[next].i;
+        double asFloat = kind == LOG_FLOAT ? record.args[next].f
+                       : kind == LOG_UINT ? (double)record.args[next].u : (double)record.args[next].i;
+        const char* text = kind == LOG_TEXT ? record.text + record.args[next].u : "?";
+        next++;
+
+        int n;
+        switch (conversion) {
+            case 's': n = snprintf(out + used, size - used, spec, text); break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+                n = snprintf(out + used, size - used, spec, asFloat); break;
+            case 'p': n = snprintf(out + used, size - used, spec, (void*)(uintptr_t)(uint32_t)asInt); break;
+            case 'd': case 'i': case 'c':
+                n = isLong ? snprintf(out + used, size - used, spec, (long)asInt)
+                           : snprintf(out + used, size - used, spec, (int)asInt);
+                break;
+            default:
+                n = isLong ? snprintf(out + used, size - used, spec, (unsigned long)(uint32_t)asInt)
+                           : snprintf(out + used, size - used, spec, (unsigned)asInt);
+                break;
+        }
+        if (n > 0) used = min(used + n, size - 1);
+    }
+    out[used] = '\0';
+}
+
+static void logTaskCode(void* parameter) {
+    static char line[192];
+    uint32_t reportedDrops = 0;
+    for (;;) {
+        LogRecord& record = logQueue[logTail & (DEBUG_LOG_QUEUE - 1)];
+        if (__atomic_load_n(&record.seq, __ATOMIC_ACQUIRE) != logTail + 1) {
+            uint32_t dropped = __atomic_load_n(&deferredLogStats.dropped, __ATOMIC_RELAXED);
+            if (dropped != reportedDrops) {
+                Serial.printf("(%lu log messages dropped)\n", (unsigned long)(dropped - reportedDrops));
+                reportedDrops = dropped;
+            }
+            vTaskDelay(pdMS_TO_TICKS(5));
+            continue;
+        }
+        uint32_t depth = __atomic_load_n(&logHead, __ATOMIC_RELAXED) - logTail;
+        if (depth > deferredLogStats.peakDepth) deferredLogStats.peakDepth = depth;
+
+        formatRecord(record, line, sizeof(line));
+        // Free the slot before the slow part so producers never wait on Serial
+        __atomic_store_n(&record.seq, logTail + DEBUG_LOG_QUEUE, __ATOMIC_RELEASE);
+        logTail++;
+        deferredLogStats.printed++;
+        Serial.print(line);
+    }
+}
+
+bool initDeferredLog() {
+#ifndef DEBUG_ON
+    return true;
+#endif
+    if (logTask) return true;
+    for (uint32_t i = 0; i < DEBUG_LOG_QUEUE; i++) logQueue[i].seq = i;
+
+    // Just above idle, on the control core: printing waits for everything else
+    BaseType_t result = xTaskCreatePinnedToCore(
+        logTaskCode,
+        "DebugLog",
+        4096,
+        NULL,
+        1,
+        &logTask,
+        1
+    );
+    if (result != pdPASS) {
+        Serial.printf("Failed to create debug log task, error: %d\n", result);
+        logTask = NULL;
+        return false;
+    }
+    return true;
+}
+
+void printDeferredLogStats() {
+    DEBUGF("Deferred log: %lu printed, %lu dropped, deepest queue %lu of %d\n",
+           (unsigned long)deferredLogStats.printed, (unsigned long)deferredLogStats.dropped,
+           (unsigned long)deferredLogStats.peakDepth, DEBUG_LOG_QUEUE);
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../config.h"
+
+// Deferred debug output for the real-time paths (note on/off, the stream and
+// decode tasks). The caller only copies its arguments into a lock-free queue;
+// a low-priority task formats and prints them. Use through DEBUGQ/DEBUGQF.
+
+#define DEBUG_LOG_ARGS  6           // Arguments per message
+#define DEBUG_LOG_TEXT  48          // Bytes for copies of %s arguments, shared by the message
+
+enum LogArgKind : uint8_t { LOG_INT, LOG_UINT, LOG_FLOAT, LOG_TEXT };
+
+struct LogRecord {
+    uint32_t seq;                   // Queue position it is free for, + 1 once published
+    const char* format;             // Must be a string literal
+    uint8_t count;
+    uint8_t textUsed;
+    uint8_t kinds[DEBUG_LOG_ARGS];
+    union {
+        int32_t i;
+        uint32_t u;
+        float f;                    // Plenty for debug output, and half the size of a double
+    } args[DEBUG_LOG_ARGS];
+    char text[DEBUG_LOG_TEXT];
+};
+
+struct DeferredLogStats {
+    uint32_t printed;
+    uint32_t dropped;               // Queue was full
+    uint32_t peakDepth;
+};
+extern DeferredLogStats deferredLogStats;
+
+bool initDeferredLog();             // Starts the printing task
+LogRecord* claimLogRecord(const char* format);  // NULL when the queue is full
+void publishLogRecord(LogRecord* record);
+void printDeferredLogStats();
+
+inline void packLogArg(LogRecord& r, int value) { r.kinds[r.count] = LOG_INT; r.args[r.count++].i = value; }
+inline void packLogArg(LogRecord& r, long value) { r.kinds[r.count] = LOG_INT; r.args[r.count++].i = value; }
+inline void packLogArg(LogRecord& r, unsigned value) { r.kinds[r.count] = LOG_UINT; r.args[r.count++].u = value; }
+inline void packLogArg(LogRecord& r, unsigned long value) { r.kinds[r.count] = LOG_UINT; r.args[r.count++].u = value; }
+inline void packLogArg(LogRecord& r, double value) { r.kinds[r.count] = LOG_FLOAT; r.args[r.count++].f = value; }
+
+// Strings are copied: the caller's String may be gone by the time it prints
+inline void packLogArg(LogRecord& r, const char* value) {
+    size_t room = DEBUG_LOG_TEXT - r.textUsed;
+    size_t length = value ? strnlen(value, room - 1) : 0;
+    if (length) memcpy(r.text + r.textUsed, value, length);
+    r.text[r.textUsed + length] = '\0';
+    r.kinds[r.count] = LOG_TEXT;
+    r.args[r.count++].u = r.textUsed;
+    r.textUsed += length + (r.textUsed + length + 1 < DEBUG_LOG_TEXT ? 1 : 0);
+}
+
+inline void packLogArgs(LogRecord& r) {}
+
+template<typename T, typename... Rest>
+inline void packLogArgs(LogRecord& r, T value, Rest... rest) {
+    static_assert(sizeof...(Rest) < DEBUG_LOG_ARGS, "Too many arguments for a deferred log message");
+    packLogArg(r, value);
+    packLogArgs(r, rest...);
+}
+
+template<typename... Args>
+inline void deferredLog(const char* format, Args... args) {
+    LogRecord* record = claimLogRecord(format);
+    if (!record) return;
+    packLogArgs(*record, args...);
+    publishLogRecord(record);
+}
\ No newline at end of file
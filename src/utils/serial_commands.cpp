@@ -3,8 +3,20 @@
 #include "../debug.h"
 #include "../audio/audio_engine.h"
 #include "../storage/instrument_manager.h"
+#include "../storage/sample_loader.h"
 #include "../audio/mp3_test.h"
 #include "../audio/mp3_streamer.h"
+#include "../audio/mp3_index.h"
+#include "../audio/pcm_cache.h"
+#include "../audio/sample_streamer.h"
+#include "../audio/audio_bench.h"
+#include "../audio/render_test.h"
+#include "../audio/perf_stats.h"
+#include "../audio/voice_governor.h"
+#include "../audio/controllers.h"
+#include "trace.h"
+#include "deferred_log.h"
+#include "../midi/sequencer.h"
 #include "FS.h"
 #include "SD_MMC.h"
 
@@ -18,21 +30,203 @@ void handleSerialCommands() {
             filename.trim();
             startMP3Stream(filename.c_str());
         }
+        else if (command.startsWith("stop mp3")) {
+            stopMP3Stream();
+        }
+        else if (command.startsWith("play stems ")) {
+            // play stems <file> <file> ... - start together, sample-aligned
+            stopMP3Stream();
+            String files = command.substring(11);
+            files.trim();
+            while (files.length() > 0) {
+                int space = files.indexOf(' ');
+                String file = space > 0 ? files.substring(0, space) : files;
+                files = space > 0 ? files.substring(space + 1) : "";
+                files.trim();
+                if (startMP3Stem(file.c_str()) < 0) break;
+            }
+        }
         else if (command.startsWith("play ")) {
-            int note = command.substring(5).toInt();
-            if (note >= 0 && note <= 127) {
-                noteOn(note, 127);
-                DEBUGF("Playing MIDI note %d\n", note);
+            // play <note> [channel 1-16]
+            int note, channel = 1;
+            if (sscanf(command.substring(5).c_str(), "%d %d", &note, &channel) >= 1 &&
+                note >= 0 && note <= 127 && channel >= 1 && channel <= MIDI_CHANNELS) {
+                noteOn(channel - 1, note, 127);
+                DEBUGF("Playing MIDI note %d on channel %d\n", note, channel);
             }
         }
-        else if (command.startsWith("stop mp3")) {
-            stopMP3Stream();
+        else if (command.startsWith("stem add ")) {
+            String filename = command.substring(9);
+            filename.trim();
+            startMP3Stem(filename.c_str());
+        }
+        else if (command.startsWith("stem stop ")) {
+            stopMP3Stem(command.substring(10).toInt());
+        }
+        else if (command.startsWith("stem gain ")) {
+            int stem;
+            float gain;
+            if (sscanf(command.substring(10).c_str(), "%d %f", &stem, &gain) == 2) {
+                setMP3StemGain(stem, gain);
+            } else {
+                DEBUG("Usage: stem gain <n> <0-2>");
+            }
+        }
+        else if (command.startsWith("stem mute ")) {
+            setMP3StemMute(command.substring(10).toInt(), true);
+        }
+        else if (command.startsWith("stem unmute ")) {
+            setMP3StemMute(command.substring(12).toInt(), false);
+        }
+        else if (command == "stems") {
+            printMP3Stems();
+        }
+        else if (command.startsWith("mp3 volume ")) {
+            setMP3Volume(command.substring(11).toFloat());
+        }
+        else if (command.startsWith("mp3 seek ")) {
+            seekMP3(command.substring(9).toFloat());
+        }
+        else if (command == "mp3 loop on") {
+            setMP3LoopEnabled(true);
+        }
+        else if (command == "mp3 loop off") {
+            setMP3LoopEnabled(false);
+        }
+        else if (command.startsWith("mp3 loop ")) {
+            // mp3 loop <start s> <end s>
+            float start, end;
+            if (sscanf(command.substring(9).c_str(), "%f %f", &start, &end) == 2) {
+                setMP3Loop(start, end);
+            } else {
+                DEBUG("Usage: mp3 loop <start s> <end s> | on | off");
+            }
+        }
+        else if (command.startsWith("mp3 info ")) {
+            String filepath = command.substring(9);
+            filepath.trim();
+            if (!filepath.startsWith("/")) filepath = "/" + filepath;
+            File file = SD_MMC.open(filepath.c_str());
+            MP3StreamInfo info;
+            uint32_t started = micros();
+            if (!file) {
+                DEBUGF("Failed to open %s\n", filepath.c_str());
+            } else if (!readMP3StreamInfo(file, info)) {
+                DEBUG("No MP3 frame found after the tags");
+            } else {
+                DEBUGF("Read in %lu us: ID3v2 %lu bytes, audio at %lu (%lu bytes), %lu Hz, %d ch\n",
+                       (unsigned long)(micros() - started), (unsigned long)info.tagBytes,
+                       (unsigned long)info.firstFrame, (unsigned long)info.audioBytes,
+                       (unsigned long)info.sampleRate, info.channels);
+                if (info.numFrames > 0) {
+                    MP3FrameIndex timing;
+                    copyMP3StreamInfo(info, timing);
+                    DEBUGF("%s header: %lu frames, %.2f s, delay %d, padding %d, %s\n",
+                           info.header == 'V' ? "VBRI" : "Xing/Info", (unsigned long)info.numFrames,
+                           (float)(getMP3EndSample(timing) - getMP3FirstSample(timing)) / info.sampleRate,
+                           info.encoderDelay, info.encoderPadding, info.hasToc ? "TOC" : "no TOC");
+                } else {
+                    DEBUG("No Xing/VBRI header: length needs a full index scan");
+                }
+            }
+            if (file) file.close();
+        }
+        else if (command.startsWith("mp3 index ")) {
+            String filepath = command.substring(10);
+            filepath.trim();
+            if (!filepath.startsWith("/")) filepath = "/" + filepath;
+            File file = SD_MMC.open(filepath.c_str());
+            MP3FrameIndex index;
+            if (!file) {
+                DEBUGF("Failed to open %s\n", filepath.c_str());
+            } else if (buildMP3Index(filepath.c_str(), file, index)) {
+                DEBUGF("%lu frames, %lu Hz, %d ch, encoder delay %d, padding %d, %.2f s\n",
+                       (unsigned long)index.numFrames, (unsigned long)index.sampleRate, index.channels,
+                       index.encoderDelay, index.encoderPadding,
+                       (float)(getMP3EndSample(index) - getMP3FirstSample(index)) / index.sampleRate);
+                freeMP3Index(index);
+            }
+            if (file) file.close();
+        }
+        else if (command == "stream status") {
+            printSampleStreamStats();
+        }
+        else if (command == "stream reset") {
+            resetSampleStreamStats();
+            DEBUG("Sample streaming stats cleared");
+        }
+        else if (command == "cache") {
+            printPCMCacheStatus();
+        }
+        else if (command.startsWith("cache add ")) {
+            String filepath = command.substring(10);
+            filepath.trim();
+            if (!filepath.startsWith("/")) filepath = "/" + filepath;
+            if (queuePCMCacheFill(filepath.c_str())) {
+                DEBUGF("Queued %s for the PCM cache\n", filepath.c_str());
+            }
+        }
+        else if (command == "cache auto on") {
+            pcmCacheAuto = true;
+            DEBUG("PCM cache: tracks are cached the first time they play");
+        }
+        else if (command == "cache auto off") {
+            pcmCacheAuto = false;
+            DEBUG("PCM cache: only 'cache add' fills the cache");
+        }
+        else if (command == "cache clear") {
+            clearPCMCache();
         }
         else if (command.startsWith("stop ")) {
-            int note = command.substring(5).toInt();
-            if (note >= 0 && note <= 127) {
-                noteOff(note);
-                DEBUGF("Stopping MIDI note %d\n", note);
+            int note, channel = 1;
+            if (sscanf(command.substring(5).c_str(), "%d %d", &note, &channel) >= 1 &&
+                note >= 0 && note <= 127 && channel >= 1 && channel <= MIDI_CHANNELS) {
+                noteOff(channel - 1, note);
+                DEBUGF("Stopping MIDI note %d on channel %d\n", note, channel);
+            }
+        }
+        else if (command.startsWith("sustain ")) {
+            // sustain <on|off> [channel 1-16]
+            char state[8];
+            int channel = 1;
+            if (sscanf(command.substring(8).c_str(), "%7s %d", state, &channel) >= 1 &&
+                (!strcmp(state, "on") || !strcmp(state, "off")) && channel >= 1 && channel <= MIDI_CHANNELS) {
+                setSustain(channel - 1, !strcmp(state, "on"));
+                DEBUGF("Sustain %s on channel %d\n", state, channel);
+            } else {
+                DEBUG("Usage: sustain <on|off> [ch]");
+            }
+        }
+        else if (command.startsWith("bend ")) {
+            // bend <-8192..8191> [channel 1-16]
+            int value, channel = 1;
+            if (sscanf(command.substring(5).c_str(), "%d %d", &value, &channel) >= 1 &&
+                channel >= 1 && channel <= MIDI_CHANNELS) {
+                setPitchBend(channel - 1, value);
+                DEBUGF("Pitch bend %d on channel %d\n", value, channel);
+            }
+        }
+        else if (command.startsWith("mod ")) {
+            // mod <0-127> [channel 1-16]
+            int value, channel = 1;
+            if (sscanf(command.substring(4).c_str(), "%d %d", &value, &channel) >= 1 &&
+                value >= 0 && value <= 127 && channel >= 1 && channel <= MIDI_CHANNELS) {
+                setModWheel(channel - 1, value);
+                DEBUGF("Mod wheel %d on channel %d\n", value, channel);
+            }
+        }
+        else if (command == "channels") {
+            printChannelMap();
+        }
+        else if (command.startsWith("channel ")) {
+            // channel <1-16> <instrument|off>
+            int channel = command.substring(8).toInt();
+            String target = command.substring(command.indexOf(' ', 8) + 1);
+            target.trim();
+            if (command.indexOf(' ', 8) < 0 || channel < 1 || channel > MIDI_CHANNELS) {
+                DEBUG("Usage: channel <1-16> <instrument|off>");
+            } else {
+                setChannelInstrument(channel - 1, target == "off" ? -1 : target.toInt());
             }
         }
         else if (command.startsWith("volume ")) {
@@ -43,12 +237,139 @@ void handleSerialCommands() {
             int inst = command.substring(11).toInt();
             selectInstrument(inst);
         }
+        else if (command.startsWith("envelope ")) {
+            // envelope <attack ms> <decay ms> <sustain 0-1> <release ms> [lin|exp]
+            Instrument* current = getCurrentInstrument();
+            if (current) {
+                EnvelopeSettings env = current->envelope;
+                char curve[8] = "";
+                int parsed = sscanf(command.substring(9).c_str(), "%f %f %f %f %7s",
+                                    &env.attackMs, &env.decayMs, &env.sustainLevel, &env.releaseMs, curve);
+                if (parsed >= 4) {
+                    if (strcmp(curve, "exp") == 0) env.curve = ENV_CURVE_EXPONENTIAL;
+                    else if (strcmp(curve, "lin") == 0) env.curve = ENV_CURVE_LINEAR;
+                    setInstrumentEnvelope(currentInstrument, env);
+                } else {
+                    DEBUG("Usage: envelope <attack ms> <decay ms> <sustain 0-1> <release ms> [lin|exp]");
+                }
+            }
+        }
+        else if (command.startsWith("interp global ")) {
+            String mode = command.substring(14);
+            mode.trim();
+            InterpMode parsed;
+            if (mode == "off") {
+                interpOverride = INTERP_MODE_COUNT;
+                DEBUG("Interpolation: per instrument");
+            } else if (parseInterpMode(mode.c_str(), parsed)) {
+                interpOverride = parsed;
+                DEBUGF("Interpolation: %s for all instruments\n", interpModeName(parsed));
+            } else {
+                DEBUG("Usage: interp global <none|linear|hermite|sinc|off>");
+            }
+        }
+        else if (command.startsWith("interp ")) {
+            String mode = command.substring(7);
+            mode.trim();
+            InterpMode parsed;
+            if (parseInterpMode(mode.c_str(), parsed)) {
+                setInstrumentInterpolation(currentInstrument, parsed);
+            } else {
+                DEBUG("Usage: interp <none|linear|hermite|sinc>");
+            }
+        }
+        else if (command.startsWith("powersave ")) {
+            String mode = command.substring(10);
+            mode.trim();
+            if (mode == "on" || mode == "off") {
+                idleThrottle = mode == "on" && IDLE_CPU_MHZ > 0;
+                DEBUGF("Idle CPU throttle: %s\n", idleThrottle ? "on" : "off");
+            } else {
+                DEBUG("Usage: powersave <on|off>");
+            }
+        }
+        else if (command == "bench interp") {
+            benchInterpolation();
+        }
+        else if (command == "bench mipmap") {
+            benchMipmaps();
+        }
+        else if (command == "bench loops") {
+            benchLoops();
+        }
+        else if (command == "bench limiter") {
+            benchLimiter();
+        }
+        else if (command == "bench voices") {
+            benchVoices();
+        }
+        else if (command == "bench kernels") {
+            benchKernels();
+        }
+        else if (command.startsWith("test render") || command.startsWith("test record")) {
+            // test render|record [name] - one MIDI file from RENDER_TEST_DIR, or all of them
+            String name = command.substring(11);
+            name.trim();
+            runRenderTests(name.length() > 0 ? name.c_str() : NULL, command.startsWith("test record"));
+        }
+        else if (command.startsWith("seq play ")) {
+            String file = command.substring(9);
+            file.trim();
+            startSequencer(file.c_str());
+        }
+        else if (command == "seq stop") {
+            stopSequencer();
+        }
+        else if (command == "seq status") {
+            printSequencerStatus();
+        }
+        else if (command == "trace dump") {
+            dumpTrace();
+        }
+        else if (command == "trace clear") {
+            clearTrace();
+            DEBUG("Trace cleared");
+        }
+        else if (command == "trace on" || command == "trace off") {
+            traceEnabled = command == "trace on" && traceRing;
+            DEBUGF("Tracing %s\n", traceEnabled ? "on" : "off");
+        }
+        else if (command == "perf") {
+            printPerfStats();
+            printDeferredLogStats();
+        }
+        else if (command == "perf reset") {
+            resetPerfStats();
+            DEBUG("Performance stats reset");
+        }
         else if (command == "load piano") {
             loadBasicPiano();
         }
         else if (command == "load drums") {
             loadBasicDrumKit();
         }
+        else if (command.startsWith("load ")) {
+            // load <manifest path>
+            String path = command.substring(5);
+            path.trim();
+            if (!path.startsWith("/")) path = String(INSTRUMENT_DIR) + "/" + path;
+            loadInstrumentManifest(path.c_str());
+        }
+        else if (command == "zones") {
+            printZoneStatus();
+        }
+        else if (command.startsWith("test convert ")) {
+            // test convert <file> [expected seconds]
+            String args = command.substring(13);
+            args.trim();
+            int space = args.indexOf(' ');
+            float expected = 0.0f;
+            if (space > 0) {
+                expected = args.substring(space + 1).toFloat();
+                args = args.substring(0, space);
+            }
+            testMP3Conversion(args.c_str(), expected);
+        }
         else if (command.startsWith("test mp3 ")) {
             String filename = command.substring(9);
             filename.trim();
@@ -76,40 +397,114 @@ void handleSerialCommands() {
                    getCurrentInstrument() ? getCurrentInstrument()->name.c_str() : "None");
             DEBUGF("Total samples: %d\n", loadedSamples);
             
-            int activeVoices = 0;
-            for (int i = 0; i < MAX_POLYPHONY; i++) {
-                if (voices[i].isActive) activeVoices++;
-            }
-            DEBUGF("Active voices: %d\n", activeVoices);
+            DEBUGF("Active voices: %d of %d allowed, pool %d (%lu stolen, %lu shed)\n", countActiveVoices(),
+                   voiceGovernor.budget, MAX_POLYPHONY, (unsigned long)voiceSteals, (unsigned long)voiceGovernor.shed);
+            printVoiceUsage();
             DEBUGF("Sample volume: %.1f\n", sampleVolume);
+            DEBUGF("CPU: %lu MHz, idle throttle %s\n", (unsigned long)ESP.getCpuFreqMHz(), idleThrottle ? "on" : "off");
+            
+            if (mp3Streaming) {
+                int stems = 0;
+                for (int i = 0; i < MP3_MAX_STREAMS; i++) {
+                    if (mp3Players[i].active) stems++;
+                }
+                DEBUGF("MP3 stems: %d (decode load %.1f%%)\n", stems, getMP3DecodeLoad() * 100.0f);
+                float loopStart, loopEnd;
+                bool looping = getMP3LoopRegion(loopStart, loopEnd);
+                float position = getMP3PositionSeconds();
+                float duration = getMP3DurationSeconds();
+                if (duration <= 0.0f) {
+                    DEBUG("MP3: length unknown (no Xing/VBRI header or index)");
+                } else if (looping) {
+                    DEBUGF("MP3: %.1f / %.1f s, looping %.2f - %.2f s\n", position, duration, loopStart, loopEnd);
+                } else {
+                    DEBUGF("MP3: %.1f / %.1f s, %.1f s remaining\n", position, duration, max(duration - position, 0.0f));
+                }
+            }
+            printPCMCacheStatus();
             
             // Show current instrument details
             Instrument* current = getCurrentInstrument();
             if (current) {
                 DEBUGF("Current instrument '%s' has %d key samples:\n", 
                        current->name.c_str(), current->numKeySamples);
+                DEBUGF("  Envelope: A=%.1fms D=%.1fms S=%.2f R=%.1fms (%s)\n",
+                       current->envelope.attackMs, current->envelope.decayMs,
+                       current->envelope.sustainLevel, current->envelope.releaseMs,
+                       current->envelope.curve == ENV_CURVE_EXPONENTIAL ? "exp" : "linear");
+                DEBUGF("  Interpolation: %s (global: %s)\n",
+                       interpModeName(current->interpMode), interpModeName(interpOverride));
                 for (int i = 0; i < current->numKeySamples; i++) {
                     KeySample* ks = &current->keySamples[i];
-                    if (ks->isLoaded) {
-                        DEBUGF("  %s: root=%d, range=%d-%d\n", 
-                               ks->sample->filename.c_str(), ks->rootNote, ks->minNote, ks->maxNote);
+                    DEBUGF("  %s: root=%d, range=%d-%d, velocity %d-%d%s\n", 
+                           ks->filename.c_str(), ks->rootNote, ks->minNote, ks->maxNote,
+                           ks->minVelocity, ks->maxVelocity,
+                           ks->isLoaded ? "" : ks->loadFailed ? " (failed)" : " (not loaded)");
+                    if (ks->isLoaded && ks->sample->looped) {
+                        DEBUGF("    loop %lu-%lu (%.2f s resident)\n", (unsigned long)ks->sample->loopStart,
+                               (unsigned long)ks->sample->loopEnd, (float)ks->sample->length / ks->sample->sampleRate);
                     }
                 }
             }
         }
         else if (command == "help") {
             DEBUG("Available commands:");
-            DEBUG("  play <note>        - Play note (0-127)");
-            DEBUG("  stop <note>        - Stop note");
+            DEBUG("  play <note> [ch]   - Play note (0-127) on a MIDI channel (default 1)");
+            DEBUG("  stop <note> [ch]   - Stop note");
+            DEBUG("  sustain <on|off> [ch] - Sustain pedal (CC64)");
+            DEBUG("  bend <value> [ch]  - Pitch bend, -8192 to 8191");
+            DEBUG("  mod <0-127> [ch]   - Mod wheel (vibrato depth)");
+            DEBUG("  channel <ch> <n|off> - Play instrument n on a channel, or follow the selection");
+            DEBUG("  channels           - Show the instrument on each MIDI channel");
             DEBUG("  volume <0-2>       - Set volume");
             DEBUG("  instrument <0-3>   - Select instrument");
+            DEBUG("  envelope <a> <d> <s> <r> [lin|exp] - Set envelope (ms, sustain 0-1)");
+            DEBUG("  interp <mode>      - Set interpolation (none|linear|hermite|sinc)");
+            DEBUG("  interp global <mode|off> - Force interpolation for all instruments");
+            DEBUG("  bench interp       - Measure interpolation cost and aliasing");
+            DEBUG("  bench mipmap       - Compare aliasing with and without mipmaps");
+            DEBUG("  bench loops        - Compare a looped tone with the same tone unlooped");
+            DEBUG("  bench limiter      - Check limiter ceiling and measure its cost");
+            DEBUG("  bench voices       - Mixer cost by polyphony, flag scan vs active bitmask");
+            DEBUG("  bench kernels      - Specialised voice kernels vs per-frame branching");
+            DEBUG("  test render [name] - Play the MIDI files in " RENDER_TEST_DIR " offline, compare with goldens");
+            DEBUG("  test record [name] - Write new golden WAVs and perf baselines");
+            DEBUG("  powersave <on|off> - Lower the CPU clock during long silences");
+            DEBUG("  trace dump         - Print the event trace for tools/trace_decode.py");
+            DEBUG("  trace clear        - Empty the event trace");
+            DEBUG("  trace on|off       - Start or pause event tracing");
+            DEBUG("  perf               - Show audio render timing");
+            DEBUG("  perf reset         - Clear audio render timing");
             DEBUG("  load piano         - Load basic piano");
             DEBUG("  load drums         - Load basic drums");
+            DEBUG("  load <manifest>    - Load an instrument manifest (relative to " INSTRUMENT_DIR ")");
+            DEBUG("  zones              - Show zone loading per instrument");
             DEBUG("  test mp3 <file>    - Test MP3 decode (e.g., 'test mp3 song.mp3')");
             DEBUG("  stream mp3 <file>  - Test MP3 streaming decode");
+            DEBUG("  test convert <file> [secs] - Decode a whole MP3 and check converted duration");
             DEBUG("  play mp3 <file>    - Start MP3 backing track");
             DEBUG("  stop mp3           - Stop MP3 backing track");
+            DEBUG("  play stems <f1> <f2> ... - Start several MP3 stems in sync");
+            DEBUG("  stem add <file>    - Add a stem at the current position");
+            DEBUG("  stem stop <n>      - Stop one stem");
+            DEBUG("  stem gain <n> <g>  - Set a stem's gain (0-2)");
+            DEBUG("  stem mute|unmute <n> - Mute or unmute a stem");
+            DEBUG("  stems              - List stems with buffer fill and decode load");
             DEBUG("  mp3 volume <0-1>   - Set MP3 backing track volume");
+            DEBUG("  mp3 seek <secs>    - Jump to a position in the backing track");
+            DEBUG("  mp3 loop <a> <b>   - Loop the backing track between two times (secs)");
+            DEBUG("  mp3 loop on|off    - Loop the A/B region, or the whole track");
+            DEBUG("  seq play <file>    - Play a MIDI file, in time with the backing track if one is playing");
+            DEBUG("  seq stop           - Stop the MIDI file");
+            DEBUG("  seq status         - Show MIDI file position and late events");
+            DEBUG("  mp3 info <file>    - Show tag size and Xing/VBRI header of an MP3");
+            DEBUG("  mp3 index <file>   - Rebuild the frame index cache for an MP3");
+            DEBUG("  cache              - Show PCM cache usage and fill progress");
+            DEBUG("  cache add <file>   - Decode an MP3 into the PCM cache in the background");
+            DEBUG("  cache auto on|off  - Cache backing tracks the first time they play");
+            DEBUG("  cache clear        - Remove every cached track");
+            DEBUG("  stream status      - Show disk streaming of long samples");
+            DEBUG("  stream reset       - Clear disk streaming stats");
             DEBUG("  list files         - Show all files on SD card");
             DEBUG("  file info <file>   - Show detailed file information");
             DEBUG("  memory             - Show memory usage");
@@ -236,6 +631,17 @@ void showMemoryInfo() {
     // Audio-specific memory usage
     DEBUGF("Loaded samples: %d/%d\n", loadedSamples, MAX_SAMPLES);
     DEBUGF("Loaded instruments: %d/%d\n", loadedInstruments, MAX_INSTRUMENTS);
+    for (int i = 0; i < loadedInstruments; i++) {
+        size_t bytes = getInstrumentMemoryUsage(&instruments[i]);
+        DEBUGF("  %s: %d bytes (%.1f KB) PSRAM, %d zones, %d velocity layers\n", instruments[i].name.c_str(),
+               bytes, bytes / 1024.0, instruments[i].numKeySamples, instruments[i].numVelocityLayers);
+    }
+    DEBUGF("Mipmap PSRAM: %d bytes (%.1f KB)\n",
+           getMipmapMemoryUsage(), getMipmapMemoryUsage() / 1024.0);
+    int sharedLoads;
+    size_t saved = getSharedSampleSavings(sharedLoads);
+    DEBUGF("Shared samples: %d loads reused a resident copy, %d bytes (%.1f KB) PSRAM saved\n",
+           sharedLoads, saved, saved / 1024.0);
     
     DEBUG("=== End Memory Info ===");
 }
\ No newline at end of file
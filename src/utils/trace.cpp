@@ -0,0 +1,70 @@
+#include "trace.h"
+#include "../debug.h"
+#include "../audio/perf_stats.h"
+
+TraceEvent* traceRing = NULL;
+uint32_t traceHead = 0;
+volatile bool traceEnabled = false;
+
+bool initTrace() {
+#if TRACE_EVENTS > 0
+    traceRing = (TraceEvent*)ps_calloc(TRACE_EVENTS, sizeof(TraceEvent));
+    if (!traceRing) {
+        DEBUG("Failed to allocate trace ring");
+        return false;
+    }
+    traceEnabled = true;
+    DEBUGF("Trace ring: %d events (%d KB PSRAM)\n", TRACE_EVENTS, (int)(TRACE_EVENTS * sizeof(TraceEvent) / 1024));
+    return true;
+#else
+    return false;
+#endif
+}
+
+void clearTrace() {
+    if (!traceRing) return;
+    bool enabled = traceEnabled;
+    traceEnabled = false;
+    memset(traceRing, 0, TRACE_EVENTS * sizeof(TraceEvent));
+    __atomic_store_n(&traceHead, 0, __ATOMIC_RELEASE);
+    traceEnabled = enabled;
+}
+
+// Written straight to Serial rather than through DEBUG: the dump is the
+// command's output and has to arrive whole, in release builds too
+void dumpTrace() {
+    if (!traceRing) {
+        Serial.println("Tracing not available");
+        return;
+    }
+
+    // Paused while printing so the audio task doesn't lap the reader
+    bool enabled = traceEnabled;
+    traceEnabled = false;
+    uint32_t head = __atomic_load_n(&traceHead, __ATOMIC_ACQUIRE);
+    uint32_t first = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+    // Render cycles are counted at the full clock, even when the dump is taken while idle-throttled
+    Serial.printf("#TRACE BEGIN v1 events=%lu cpu=%lu\n", (unsigned long)(head - first),
+                  (unsigned long)renderCpuMhz());
+
+    uint32_t skipped = 0;
+    char line[40];
+    for (uint32_t seq = first; seq < head; seq++) {
+        const TraceEvent& slot = traceRing[seq & (TRACE_EVENTS - 1)];
+        uint32_t before = __atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE);
+        TraceEvent event = slot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (before != seq + 1 || __atomic_load_n(&slot.seq, __ATOMIC_RELAXED) != before) {
+            // Still being written, or already overwritten by a newer event
+            skipped++;
+            continue;
+        }
+        const uint8_t* bytes = (const uint8_t*)&event;
+        for (int i = 0; i < (int)sizeof(event); i++) {
+            snprintf(line + i * 2, 3, "%02x", bytes[i]);
+        }
+        Serial.println(line);
+    }
+    Serial.printf("#TRACE END skipped=%lu\n", (unsigned long)skipped);
+    traceEnabled = enabled;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../config.h"
+
+// Event types. The numbers are part of the dump format, tools/trace_decode.py
+// has the same table: append new types, never renumber.
+enum TraceType : uint8_t {
+    TRACE_NOTE_ON = 1,      // arg16 = channel << 8 | note, arg = voice << 8 | velocity
+    TRACE_NOTE_OFF,         // arg16 = channel << 8 | note, arg = 1 when held by the pedal
+    TRACE_VOICE_STEAL,      // arg16 = channel << 8 | note of the new note, arg = voice
+    TRACE_VOICE_SHED,       // arg16 = voice, arg = 1 when cut to make the deadline
+    TRACE_BLOCK_START,      // arg = active voice mask
+    TRACE_BLOCK_END,        // arg16 = voice blocks mixed, arg = render cycles
+    TRACE_CPU_CLOCK,        // arg = new CPU clock in MHz
+    TRACE_MP3_FILL,         // arg16 = stems, arg = frames buffered by the emptiest stem
+    TRACE_STREAM_FILL,      // arg16 = voice, arg = frames buffered ahead of the voice
+    TRACE_SD_READ,          // arg16 = source (TraceSource), arg = microseconds
+    TRACE_UNDERRUN,         // arg16 = source (TraceSource), arg = voice or stem
+    TRACE_CONTROL,          // arg16 = channel << 8 | controller (128 = pitch bend), arg = value
+};
+
+enum TraceSource : uint16_t {
+    TRACE_SRC_SAMPLE_STREAM,
+    TRACE_SRC_MP3,
+    TRACE_SRC_ZONE_LOAD,
+};
+
+// One record. `seq` is written last: a slot whose seq doesn't match its
+// position was being overwritten while the dump read it and is skipped.
+struct TraceEvent {
+    uint32_t seq;           // Event number + 1, 0 while being written
+    uint32_t time;          // micros()
+    uint32_t arg;
+    uint16_t arg16;
+    uint8_t type;
+    uint8_t core;
+};
+
+static_assert(sizeof(TraceEvent) == 16, "The dump format expects 16-byte records");
+static_assert((TRACE_EVENTS & (TRACE_EVENTS - 1)) == 0, "TRACE_EVENTS must be a power of two");
+
+extern TraceEvent* traceRing;
+extern uint32_t traceHead;         // Events ever claimed
+extern volatile bool traceEnabled;
+
+bool initTrace();
+void clearTrace();
+void dumpTrace();                  // Hex records between #TRACE BEGIN and #TRACE END lines
+
+// Lock-free from any task or core: claim a slot, fill it, publish its sequence number
+inline void trace(TraceType type, uint16_t arg16, uint32_t arg) {
+#if TRACE_EVENTS > 0
+    if (!traceEnabled) return;
+    uint32_t seq = __atomic_fetch_add(&traceHead, 1, __ATOMIC_RELAXED);
+    TraceEvent& event = traceRing[seq & (TRACE_EVENTS - 1)];
+    __atomic_store_n(&event.seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    event.time = micros();
+    event.arg = arg;
+    event.arg16 = arg16;
+    event.type = type;
+    event.core = xPortGetCoreID();
+    __atomic_store_n(&event.seq, seq + 1, __ATOMIC_RELEASE);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""Decode a `trace dump` captured from the sampler's serial port.
+
+    pio device monitor | tee capture.log     # then type: trace dump
+    python3 tools/trace_decode.py capture.log
+    python3 tools/trace_decode.py capture.log --chrome trace.json
+
+The text timeline goes to stdout. --chrome writes Chrome trace event JSON that
+opens in Perfetto (ui.perfetto.dev) or chrome://tracing.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+# Same numbering as enum TraceType in src/utils/trace.h
+TYPES = {
+    1: "NOTE_ON",
+    2: "NOTE_OFF",
+    3: "VOICE_STEAL",
+    4: "VOICE_SHED",
+    5: "BLOCK_START",
+    6: "BLOCK_END",
+    7: "CPU_CLOCK",
+    8: "MP3_FILL",
+    9: "STREAM_FILL",
+    10: "SD_READ",
+    11: "UNDERRUN",
+    12: "CONTROL",
+}
+
+SOURCES = {0: "sample stream", 1: "mp3", 2: "zone load"}
+
+RECORD = struct.Struct("<IIIHBB")  # seq, time, arg, arg16, type, core
+
+
+def parse(lines):
+    """Records from the last complete dump in the log, oldest first."""
+    dumps, records, header, inside = [], [], {}, False
+    for line in lines:
+        line = line.strip()
+        if line.startswith("#TRACE BEGIN"):
+            header = dict(f.split("=", 1) for f in line.split()[3:] if "=" in f)
+            records, inside = [], True
+        elif line.startswith("#TRACE END"):
+            if inside:
+                header.update(f.split("=", 1) for f in line.split()[2:] if "=" in f)
+                dumps.append((header, records))
+            inside = False
+        elif inside and len(line) == RECORD.size * 2:
+            try:
+                records.append(RECORD.unpack(bytes.fromhex(line)))
+            except ValueError:
+                pass  # Debug output interleaved with the dump
+    if not dumps:
+        sys.exit("No complete #TRACE BEGIN ... #TRACE END block found")
+    header, records = dumps[-1]
+    records.sort(key=lambda r: r[0])
+    return header, unwrap(records)
+
+
+def unwrap(records):
+    """micros() wraps every ~71 minutes: make the timestamps monotonic."""
+    events, offset, last = [], 0, None
+    for seq, time, arg, arg16, kind, core in records:
+        if last is not None and time < last and last - time > 1 << 31:
+            offset += 1 << 32
+        last = time
+        events.append({"seq": seq - 1, "us": time + offset, "arg": arg, "arg16": arg16,
+                       "type": TYPES.get(kind, "TYPE_%d" % kind), "core": core})
+    return events
+
+
+def signed(value):
+    return value - (1 << 32) if value & (1 << 31) else value
+
+
+def describe(e, cpu_mhz):
+    arg, arg16, kind = e["arg"], e["arg16"], e["type"]
+    if kind in ("NOTE_ON", "NOTE_OFF", "VOICE_STEAL"):
+        where = "ch %d note %d" % ((arg16 >> 8) + 1, arg16 & 0xFF)
+        if kind == "NOTE_ON":
+            return "%s voice %d vel %d" % (where, arg >> 8, arg & 0xFF)
+        if kind == "NOTE_OFF":
+            return where + (" (sustained)" if arg else "")
+        return "%s takes voice %d" % (where, arg)
+    if kind == "VOICE_SHED":
+        return "voice %d%s" % (arg16, " (deadline)" if arg else " (released)")
+    if kind == "BLOCK_START":
+        return "%d voices mask %08x" % (bin(arg).count("1"), arg)
+    if kind == "BLOCK_END":
+        return "%d voice blocks, %.1f us" % (arg16, arg / cpu_mhz)
+    if kind == "CPU_CLOCK":
+        return "%d MHz" % arg
+    if kind == "MP3_FILL":
+        return "%d stems, lowest %d frames" % (arg16, arg)
+    if kind == "STREAM_FILL":
+        return "voice %d, %d frames ahead" % (arg16, signed(arg))
+    if kind == "SD_READ":
+        return "%s %d us" % (SOURCES.get(arg16, arg16), arg)
+    if kind == "UNDERRUN":
+        return "%s %d" % (SOURCES.get(arg16, arg16), arg)
+    if kind == "CONTROL":
+        channel, number = (arg16 >> 8) + 1, arg16 & 0xFF
+        if number == 128:
+            return "ch %d pitch bend %d" % (channel, signed(arg))
+        return "ch %d CC%d = %d" % (channel, number, arg)
+    return "arg16 %d arg %d" % (arg16, arg)
+
+
+def print_timeline(header, events, cpu_mhz):
+    print("%d events, %s skipped" % (len(events), header.get("skipped", "?")))
+    if not events:
+        return
+    start = events[0]["us"]
+    for e in events:
+        print("%12.3f ms  core %d  %-12s %s" % ((e["us"] - start) / 1000.0, e["core"], e["type"],
+                                                describe(e, cpu_mhz)))
+
+
+def chrome_trace(events, cpu_mhz):
+    """Blocks as duration slices, SD reads as complete events ending at their
+    timestamp, fills and the clock as counters, everything else as instants."""
+    out = []
+    for e in events:
+        kind, ts = e["type"], e["us"]
+        base = {"pid": 0, "tid": e["core"], "ts": ts}
+        if kind == "BLOCK_START":
+            out.append(dict(base, name="render", ph="B", args={"voices": bin(e["arg"]).count("1")}))
+        elif kind == "BLOCK_END":
+            out.append(dict(base, name="render", ph="E",
+                            args={"voice_blocks": e["arg16"], "render_us": e["arg"] / cpu_mhz}))
+        elif kind == "SD_READ":
+            source = SOURCES.get(e["arg16"], str(e["arg16"]))
+            out.append(dict(base, name="SD read " + source, ph="X", ts=ts - e["arg"], dur=e["arg"]))
+        elif kind == "MP3_FILL":
+            out.append(dict(base, name="mp3 fill", ph="C", args={"frames": e["arg"]}))
+        elif kind == "STREAM_FILL":
+            out.append(dict(base, name="stream fill", ph="C",
+                            args={"voice %d" % e["arg16"]: signed(e["arg"])}))
+        elif kind == "CPU_CLOCK":
+            out.append(dict(base, name="cpu MHz", ph="C", args={"MHz": e["arg"]}))
+        else:
+            out.append(dict(base, name=kind, ph="i", s="t", args={"info": describe(e, cpu_mhz)}))
+    names = [{"pid": 0, "tid": core, "ph": "M", "name": "thread_name", "args": {"name": "core %d" % core}}
+             for core in sorted({e["core"] for e in events})]
+    return {"traceEvents": names + out, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", help="serial capture containing a trace dump ('-' for stdin)")
+    parser.add_argument("--chrome", metavar="OUT.json", help="write Chrome trace event JSON")
+    parser.add_argument("--quiet", action="store_true", help="skip the text timeline")
+    args = parser.parse_args()
+
+    source = sys.stdin if args.log == "-" else open(args.log, errors="replace")
+    with source:
+        header, events = parse(source)
+    cpu_mhz = float(header.get("cpu", 240)) or 240.0
+
+    if not args.quiet:
+        print_timeline(header, events, cpu_mhz)
+    if args.chrome:
+        with open(args.chrome, "w") as f:
+            json.dump(chrome_trace(events, cpu_mhz), f)
+        print("Wrote %d events to %s" % (len(events), args.chrome), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()